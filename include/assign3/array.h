@@ -29,7 +29,7 @@ namespace assign3
     {
     public:
         explicit array_t(blt::size_t dimensions, blt::size_t width, blt::size_t height, shape_t shape):
-            width(static_cast<blt::i64>(width)), height(static_cast<blt::i64>(height))
+            width(static_cast<blt::i64>(width)), height(static_cast<blt::i64>(height)), shape(shape)
         {
             switch (shape)
             {
@@ -54,6 +54,12 @@ namespace assign3
         array_t(array_t&&) = default;
         array_t& operator=(array_t&&) = default;
 
+        /**
+         * Creates a larger (or smaller) lattice of the same shape whose codebook is interpolated from this one.
+         * Positions are compared in lattice space so honey comb rows keep their half cell offset, and wrapped shapes interpolate across the edge.
+         */
+        [[nodiscard]] array_t resized(blt::size_t new_width, blt::size_t new_height) const;
+
         [[nodiscard]] blt::vec2ul from_index(blt::size_t index) const
         {
             return {index % width, index / width};
@@ -79,6 +85,11 @@ namespace assign3
             return height;
         }
 
+        [[nodiscard]] shape_t get_shape() const
+        {
+            return shape;
+        }
+
         [[nodiscard]] std::vector<neuron_t>& get_map()
         {
             return map;
@@ -90,12 +101,26 @@ namespace assign3
         }
 
     private:
+        // linearly interpolated codebook at lattice space x along row y
+        void sample_row(blt::i64 y, Scalar x, Scalar weight, std::vector<Scalar>& out) const;
+
+        [[nodiscard]] bool is_wrapped() const
+        {
+            return shape == shape_t::GRID_WRAP || shape == shape_t::GRID_OFFSET_WRAP;
+        }
+
+        [[nodiscard]] bool is_offset() const
+        {
+            return shape == shape_t::GRID_OFFSET || shape == shape_t::GRID_OFFSET_WRAP;
+        }
+
         [[nodiscard]] blt::i64 wrap_width(blt::i64 x) const;
 
         [[nodiscard]] blt::i64 wrap_height(blt::i64 y) const;
 
     private:
         blt::i64 width, height;
+        shape_t shape;
         std::vector<neuron_t> map;
     };
 }
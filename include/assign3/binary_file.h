@@ -0,0 +1,165 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_BINARY_FILE_H
+#define COSC_4P80_ASSIGNMENT_3_BINARY_FILE_H
+
+#include <assign3/file.h>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace assign3
+{
+    // extension of binary data files, loaded in place of a .out file with the same name
+    inline constexpr std::string_view binary_data_extension = ".outb";
+
+    inline constexpr blt::size_t binary_header_size = 64;
+
+    // where everything lives in a binary data file, taken from its header
+    struct binary_layout_t
+    {
+        blt::size_t samples = 0;
+        blt::size_t bins = 0;
+        blt::size_t precision = 0;
+        blt::size_t row_stride = 0;
+        bool weighted = false;
+        blt::size_t labels_offset = 0;
+        blt::size_t weights_offset = 0;
+        blt::size_t matrix_offset = 0;
+    };
+
+    /**
+     * checks the binary_header_size bytes at the start of a binary data file which is file_size bytes long.
+     * Nothing (with a warning naming path) if it isn't a binary data file or its sections don't fit
+     */
+    std::optional<binary_layout_t> read_binary_layout(const char* header, blt::size_t file_size, const std::string& path);
+
+    /**
+     * Binary counterpart of the .out format which is mapped into memory rather than parsed. Layout (little endian):
+     *  - 64 byte header: magic, version, sample count, bin count, precision (bytes per bin value, 4 or 8), row stride and the offsets below
+     *  - labels: one is_bad bit per sample, packed into 64 bit words
+     *  - weights: one float per sample, only present for weighted (coreset) files
+     *  - bins: row major, one row per sample. The matrix and every row start on a 64 byte boundary
+     * Rows can be read straight out of the mapping with row(), to_data_file() copies them into a data_file_t.
+     */
+    class mapped_data_file_t
+    {
+        public:
+            // nothing (with a warning) if the file can't be opened or isn't a valid binary data file
+            static std::optional<mapped_data_file_t> open(const std::string& path);
+
+            // precision is the number of bytes used per bin value, either sizeof(float) or sizeof(double)
+            static bool write(const std::string& path, const data_file_t& file, blt::size_t precision = sizeof(Scalar));
+
+            mapped_data_file_t(const mapped_data_file_t&) = delete;
+            mapped_data_file_t& operator=(const mapped_data_file_t&) = delete;
+            mapped_data_file_t(mapped_data_file_t&& move) noexcept;
+            mapped_data_file_t& operator=(mapped_data_file_t&& move) noexcept;
+
+            ~mapped_data_file_t();
+
+            [[nodiscard]] data_file_t to_data_file() const;
+
+            [[nodiscard]] blt::size_t get_samples() const
+            {
+                return samples;
+            }
+
+            [[nodiscard]] blt::size_t get_bins() const
+            {
+                return bins;
+            }
+
+            [[nodiscard]] blt::size_t get_precision() const
+            {
+                return precision;
+            }
+
+            [[nodiscard]] bool is_bad(const blt::size_t sample) const
+            {
+                return (labels[sample / 64] >> (sample % 64)) & 1;
+            }
+
+            // weight of the sample, 1 for unweighted files
+            [[nodiscard]] Scalar weight(const blt::size_t sample) const
+            {
+                return weights == nullptr ? 1 : weights[sample];
+            }
+
+            // bins of sample without copying them, only valid when the file was written with sizeof(Scalar) precision
+            [[nodiscard]] const Scalar* row(const blt::size_t sample) const
+            {
+                return reinterpret_cast<const Scalar*>(matrix + sample * row_stride);
+            }
+
+        private:
+            mapped_data_file_t() = default;
+
+            void release();
+
+            // the whole file, either mapped or (where mmap isn't available) read into owned memory
+            const char* memory = nullptr;
+            blt::size_t memory_size = 0;
+            bool mapped = false;
+
+            blt::size_t samples = 0;
+            blt::size_t bins = 0;
+            blt::size_t precision = 0;
+            blt::size_t row_stride = 0;
+            const blt::u64* labels = nullptr;
+            const float* weights = nullptr;
+            const char* matrix = nullptr;
+    };
+
+    /**
+     * Writes a binary data file a block of samples at a time, for files too large to build as one data_file_t first. The labels (and
+     * weights) are stored in front of the bins so they have to be known up front. A writer which failed to open warns and ignores
+     * everything written to it
+     */
+    class binary_data_writer_t
+    {
+        public:
+            /**
+             * @param labels one is_bad bit per sample, packed into 64 bit words
+             * @param weights empty for an unweighted file, otherwise one per sample
+             * @param precision bytes used per bin value, either sizeof(float) or sizeof(double)
+             */
+            binary_data_writer_t(const std::string& path, blt::size_t samples, blt::size_t bins, const std::vector<blt::u64>& labels,
+                                 const std::vector<Scalar>& weights = {}, blt::size_t precision = sizeof(Scalar));
+
+            // appends the bins of every sample of block, in order
+            bool write(const data_file_t& block);
+
+            // closes the file, true if every sample the header promised was written without errors
+            bool finish();
+
+        private:
+            std::ofstream out;
+            std::string path;
+            blt::size_t samples;
+            blt::size_t bins;
+            blt::size_t precision;
+            blt::size_t written_samples = 0;
+            std::vector<char> row;
+            bool good = false;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_BINARY_FILE_H
@@ -0,0 +1,96 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_CONVERGENCE_H
+#define COSC_4P80_ASSIGNMENT_3_CONVERGENCE_H
+
+#include <assign3/fwdecl.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace assign3
+{
+    class som_t;
+
+    struct convergence_monitor_t
+    {
+        /**
+         * called by the SOM after every epoch once the errors for that epoch have been recorded
+         * @return the reason training should stop, or nothing to keep going
+         */
+        [[nodiscard]] virtual std::optional<std::string> should_stop(const som_t& som) const = 0;
+
+        virtual ~convergence_monitor_t() = default;
+    };
+
+    /**
+     * stops once the mean of neither error curve has changed by more than tolerance between the two halves of the last window evaluations
+     * (epochs, unless the SOM uses a sparser evaluation schedule).
+     * quantization error is a count of samples so it is compared as a fraction of the dataset size.
+     */
+    struct plateau_monitor_t final : public convergence_monitor_t
+    {
+        public:
+            plateau_monitor_t(blt::size_t window, Scalar tolerance): window(window), tolerance(tolerance)
+            {}
+
+            [[nodiscard]] std::optional<std::string> should_stop(const som_t& som) const final;
+
+        private:
+            blt::size_t window;
+            Scalar tolerance;
+    };
+
+    /**
+     * stops once the RMS movement of the codebook has stayed below threshold for patience consecutive epochs
+     */
+    struct codebook_movement_monitor_t final : public convergence_monitor_t
+    {
+        public:
+            codebook_movement_monitor_t(blt::size_t patience, Scalar threshold): patience(patience), threshold(threshold)
+            {}
+
+            [[nodiscard]] std::optional<std::string> should_stop(const som_t& som) const final;
+
+        private:
+            blt::size_t patience;
+            Scalar threshold;
+    };
+
+    /**
+     * stops as soon as any of the contained monitors wants to
+     */
+    struct any_convergence_monitor_t final : public convergence_monitor_t
+    {
+        public:
+            any_convergence_monitor_t& with(std::unique_ptr<convergence_monitor_t> monitor)
+            {
+                monitors.push_back(std::move(monitor));
+                return *this;
+            }
+
+            [[nodiscard]] std::optional<std::string> should_stop(const som_t& som) const final;
+
+        private:
+            std::vector<std::unique_ptr<convergence_monitor_t>> monitors;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_CONVERGENCE_H
@@ -0,0 +1,36 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_CORESET_H
+#define COSC_4P80_ASSIGNMENT_3_CORESET_H
+
+#include <assign3/file.h>
+
+namespace assign3
+{
+    /**
+     * Compresses a dataset down to (at most) size weighted samples. Good and bad samples are handled separately, each class gets a share
+     * of size proportional to how many samples it has (at least one when size is at least 2). Within a class representatives are picked
+     * with k-means++ seeding, every sample is assigned to its closest representative, and the representative is replaced by the mean of
+     * its group with the group size as its weight. The weights of the result sum to the (weighted) size of every class it represents,
+     * which is all of the input unless a size of 1 had to leave the smaller class out.
+     */
+    data_file_t build_coreset(const data_file_t& file, blt::size_t size, blt::size_t seed);
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_CORESET_H
@@ -0,0 +1,322 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_EVALUATOR_H
+#define COSC_4P80_ASSIGNMENT_3_EVALUATOR_H
+
+#include <assign3/array.h>
+#include <assign3/file.h>
+#include <assign3/functions.h>
+#include <assign3/stream.h>
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace assign3
+{
+    enum class activation_mode_t
+    {
+        // every neuron against every sample through the topology function
+        EXACT,
+        // signed hits of each sample on its BMU, spread over the lattice with the topology function
+        LATTICE
+    };
+
+    struct error_interval_t
+    {
+        Scalar lower = 0;
+        Scalar upper = 0;
+    };
+
+    struct evaluation_t
+    {
+        // normalized to [-1, 1], one per neuron in lattice order
+        std::vector<Scalar> activations;
+        Scalar scale_average = 0;
+        Scalar topological_error = 0;
+        Scalar quantization_error = 0;
+        // confidence intervals of the errors, zero width when every sample was evaluated
+        error_interval_t topological_interval;
+        error_interval_t quantization_interval;
+        // best and second best matching unit of every sample, only filled in when the evaluator keeps matches
+        std::vector<blt::size_t> first_bmus;
+        std::vector<blt::size_t> second_bmus;
+        // error rate of the good (0) and bad (1) samples, only filled in by estimates
+        std::array<Scalar, 2> topological_rates{};
+        std::array<Scalar, 2> quantization_rates{};
+        // samples of each class the rates come from, only filled in by estimates
+        std::array<blt::size_t, 2> drawn{};
+    };
+
+    /**
+     * stratified subsample of a file. Sample weights are scaled so each class still carries the total weight it has in the full file
+     */
+    struct sample_plan_t
+    {
+        data_file_t sample;
+        // indexed by is_bad
+        std::array<blt::size_t, 2> population{};
+        std::array<blt::size_t, 2> drawn{};
+        std::array<Scalar, 2> population_weight{};
+    };
+
+    /**
+     * Sizes and draws the subsamples used to estimate the errors. The sample size is picked so the confidence interval of both errors
+     * should come out at interval_width (as a fraction of the dataset) given the error rates seen at the previous estimate, and is split
+     * between good and bad samples in proportion to how many of each there are (at least min_per_class of each when available)
+     */
+    class error_sampler_t
+    {
+        public:
+            explicit error_sampler_t(Scalar interval_width, Scalar confidence = 0.95, blt::size_t min_per_class = 16);
+
+            [[nodiscard]] sample_plan_t draw(const data_file_t& file, blt::size_t seed) const;
+
+            // remembers the per class error rates of an estimate for sizing the next sample
+            void update(const evaluation_t& evaluation);
+
+            [[nodiscard]] Scalar get_confidence() const
+            {
+                return confidence;
+            }
+
+        private:
+            Scalar interval_width;
+            Scalar confidence;
+            blt::size_t min_per_class;
+            // start from the worst case variance
+            std::array<Scalar, 2> topological_rates{0.5, 0.5};
+            std::array<Scalar, 2> quantization_rates{0.5, 0.5};
+            std::array<blt::size_t, 2> drawn{};
+    };
+
+    /**
+     * which epochs get their errors (and activations) computed. The final epoch is always evaluated.
+     */
+    class evaluation_schedule_t
+    {
+        public:
+            // the default, every epoch is evaluated
+            evaluation_schedule_t() = default;
+
+            static evaluation_schedule_t every(blt::size_t epochs);
+
+            // evaluates epochs 1, 2, ... with the gap between evaluations growing by ratio each time, dense early on where the errors move
+            static evaluation_schedule_t geometric(Scalar ratio);
+
+            static evaluation_schedule_t final_only();
+
+            /**
+             * parses "every:k", "geometric:ratio" or "final". A bare number is treated as every:number
+             */
+            static evaluation_schedule_t parse(const std::string& str);
+
+            [[nodiscard]] bool should_evaluate(blt::size_t epoch, blt::size_t max_epochs) const;
+
+        private:
+            enum class type_t
+            {
+                EVERY, GEOMETRIC, FINAL
+            };
+
+            type_t type = type_t::EVERY;
+            blt::size_t interval = 1;
+            Scalar ratio = 2;
+    };
+
+    /**
+     * Evaluates a codebook against a dataset in a single pass. The sample to neuron distance block is computed once and the two best
+     * matching units of every sample are pulled from it, the activations and both errors are then derived from that block rather than each
+     * rescanning the map. Lattice neighbourhood is precomputed per lattice: two neurons are neighbours when their lattice distance is the
+     * smallest lattice distance from the first one to any other neuron.
+     *
+     * Codebooks are flat (neuron major) snapshots so the map itself can keep changing while a snapshot is being evaluated.
+     * The distance block, best matching units and activations are filled in parallel on the shared thread pool, every value is written by
+     * exactly one chunk and all sums are taken in order afterwards so the results are identical to a single threaded run.
+     */
+    class evaluator_t
+    {
+        public:
+            // must be called again whenever the lattice size, shape or distance function changes
+            void set_lattice(const array_t& array, distance_function_t* dist_func);
+
+            [[nodiscard]] static std::vector<Scalar> snapshot(const array_t& array);
+
+            // copy the BMUs of every sample into the results of evaluate / estimate
+            void set_keep_matches(bool keep)
+            {
+                keep_matches = keep;
+            }
+
+            /**
+             * LATTICE activations only look at each sample's BMU: the sample adds its (signed, weighted) topology function response to
+             * its BMU's hit count and the hit map is then spread over the lattice with the same function, using lattice distances. Grids
+             * with a gaussian topology are spread separably along rows and columns (wrapping on the torus), other shapes use the full
+             * lattice distance table. Costs O(N + M * (W + H)) on top of the match instead of O(M * N) function evaluations
+             */
+            void set_activation_mode(const activation_mode_t mode)
+            {
+                activation_mode = mode;
+            }
+
+            [[nodiscard]] activation_mode_t get_activation_mode() const
+            {
+                return activation_mode;
+            }
+
+            // fraction of neurons which classify (good, bad or neutral at quantization_distance) the same way under both activations
+            [[nodiscard]] static Scalar classification_agreement(const std::vector<Scalar>& a, const std::vector<Scalar>& b,
+                                                                 Scalar quantization_distance);
+
+            /**
+             * matches over data (which has to outlive the evaluator or be replaced here first) only recompute the distances and activation
+             * of neurons whose codebook vector moved further than drift_tolerance since they were last computed, everything else is reused
+             * from the previous match. Distances of a skipped neuron are off by at most drift_tolerance, so the BMUs and errors are
+             * approximate and the cost drops with the fraction of the map that has settled. Matches over other data always start fresh.
+             * A tolerance of 0 (or nullptr) turns this off
+             */
+            void set_incremental(const data_file_t* data, Scalar drift_tolerance);
+
+            // number of neurons whose distances were recomputed by the last match
+            [[nodiscard]] blt::size_t get_recomputed_neurons() const
+            {
+                return recomputed_neurons;
+            }
+
+            /**
+             * activations of the codebook over file followed by both errors of file using those activations
+             * @param distance divides the distance to the nearest lattice neighbour to get the half distance given to the topology function
+             * @param activation strength the topology function should have at that half distance
+             */
+            [[nodiscard]] evaluation_t evaluate(const std::vector<Scalar>& codebook, const data_file_t& file, const topology_function_t& topology_function,
+                                                Scalar user_scale, Scalar distance, Scalar activation, Scalar quantization_distance);
+
+            /**
+             * evaluate over every sample of stream, one chunk at a time so the dataset never has to be in memory. The activations add up
+             * chunk by chunk and the quantization error only needs to know how much weight of each class every neuron is the BMU of, so
+             * this takes a single pass and gives the same result as evaluating the whole file at once. Matches aren't kept and
+             * incremental matching doesn't apply
+             */
+            [[nodiscard]] evaluation_t evaluate(const std::vector<Scalar>& codebook, data_stream_t& stream, const topology_function_t& topology_function,
+                                                Scalar user_scale, Scalar distance, Scalar activation, Scalar quantization_distance);
+
+            // the streamed evaluate over a padded dataset, padding out a block of samples at a time rather than the whole dataset
+            [[nodiscard]] evaluation_t evaluate(const std::vector<Scalar>& codebook, const padded_dataset_t& data,
+                                                const topology_function_t& topology_function, Scalar user_scale, Scalar distance,
+                                                Scalar activation, Scalar quantization_distance);
+
+            /**
+             * evaluate over a subsample of the training file. Activations come from the (reweighted) subsample, the errors are stratified
+             * estimates of the full file with intervals at the given confidence
+             */
+            [[nodiscard]] evaluation_t estimate(const std::vector<Scalar>& codebook, const sample_plan_t& plan,
+                                                const topology_function_t& topology_function, Scalar user_scale, Scalar distance,
+                                                Scalar activation, Scalar quantization_distance, Scalar confidence);
+
+            // only the activations part of evaluate, returns the average scale
+            Scalar compute_activations(const std::vector<Scalar>& codebook, const data_file_t& file, const topology_function_t& topology_function,
+                                       Scalar user_scale, Scalar distance, Scalar activation, std::vector<Scalar>& activations);
+
+            // weighted fraction of samples whose two best matching units are not lattice neighbours
+            [[nodiscard]] Scalar topological_error(const std::vector<Scalar>& codebook, const data_file_t& data);
+
+            // weighted count of samples whose best matching unit has a neutral or opposite activation
+            [[nodiscard]] Scalar quantization_error(const std::vector<Scalar>& codebook, const data_file_t& data, const std::vector<Scalar>& activations,
+                                                    Scalar quantization_distance);
+
+            // mean codebook distance from every neuron to its lattice neighbours
+            [[nodiscard]] std::vector<Scalar> u_matrix(const std::vector<Scalar>& codebook) const;
+
+            [[nodiscard]] Scalar get_neighbour_distance(blt::size_t neuron) const
+            {
+                return neighbour_distances[neuron];
+            }
+
+            [[nodiscard]] bool are_neighbours(blt::size_t a, blt::size_t b) const;
+
+        private:
+            // fills the distance block and the two best matching units of every sample in data
+            void match(const std::vector<Scalar>& codebook, const data_file_t& data);
+
+            // single pass evaluation over the blocks next hands out until it returns nullptr, see the streamed evaluate
+            [[nodiscard]] evaluation_t evaluate_blocks(const std::vector<Scalar>& codebook, const std::function<const data_file_t*()>& next,
+                                                       const topology_function_t& topology_function, Scalar user_scale, Scalar distance,
+                                                       Scalar activation, Scalar quantization_distance);
+
+            // per neuron topology function scale for the given activation settings
+            void compute_scales(const topology_function_t& topology_function, Scalar user_scale, Scalar distance, Scalar activation);
+
+            // signed, weighted response of every sample of file at neuron, using the current match of file and the scales already filled in
+            [[nodiscard]] Scalar activation_of(blt::size_t neuron, const data_file_t& file, const topology_function_t& topology_function) const;
+
+            // lattice mode, adds the signed response of every sample of file at its BMU to hits, using the current match of file
+            void accumulate_hits(const data_file_t& file, const topology_function_t& topology_function, std::vector<Scalar>& hits) const;
+
+            // lattice mode, spreads the BMU hits over the lattice with the topology function
+            void spread_hits(const std::vector<Scalar>& hits, const topology_function_t& topology_function, std::vector<Scalar>& activations);
+
+            // normalizes raw activations to [-1, 1] and returns the average scale
+            Scalar normalize_activations(std::vector<Scalar>& activations) const;
+
+            [[nodiscard]] bool is_topological_error(blt::size_t sample) const
+            {
+                return !are_neighbours(first_bmu[sample], second_bmu[sample]);
+            }
+
+            [[nodiscard]] bool is_quantization_error(blt::size_t sample, const data_view_t& point, const std::vector<Scalar>& activations,
+                                                     Scalar quantization_distance) const;
+
+            [[nodiscard]] Scalar topological_error_of_match(const data_file_t& data) const;
+
+            [[nodiscard]] Scalar quantization_error_of_match(const data_file_t& data, const std::vector<Scalar>& activations,
+                                                             Scalar quantization_distance) const;
+
+            blt::size_t neurons = 0;
+            blt::size_t lattice_width = 0;
+            blt::size_t lattice_height = 0;
+            shape_t lattice_shape = shape_t::GRID;
+            bool keep_matches = false;
+            activation_mode_t activation_mode = activation_mode_t::EXACT;
+            std::vector<Scalar> lattice_distances;
+            std::vector<Scalar> neighbour_distances;
+
+            // neuron major, distances[neuron * samples + sample]
+            std::vector<Scalar> distances;
+            // incremental matching, see set_incremental
+            const data_file_t* incremental_data = nullptr;
+            Scalar drift_tolerance = 0;
+            // codebook each row of distances was computed from, empty when the rows don't belong to incremental_data
+            std::vector<Scalar> matched_codebook;
+            // set for the rows the last match recomputed
+            std::vector<blt::u8> changed_rows;
+            bool reused_rows = false;
+            blt::size_t recomputed_neurons = 0;
+            // unnormalized activations of the last compute_activations and what they were computed with
+            std::vector<Scalar> raw_activations;
+            // set for neurons whose rows changed after their activation was computed
+            std::vector<blt::u8> stale_activations;
+            const topology_function_t* activation_function = nullptr;
+            std::array<Scalar, 3> activation_parameters{};
+            std::vector<blt::size_t> first_bmu;
+            std::vector<blt::size_t> second_bmu;
+            std::vector<Scalar> scales;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_EVALUATOR_H
@@ -0,0 +1,164 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_FEATURES_H
+#define COSC_4P80_ASSIGNMENT_3_FEATURES_H
+
+#include <assign3/file.h>
+#include <complex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace assign3
+{
+    inline constexpr std::string_view signal_extension = ".sig";
+
+    // one raw vibration capture, time domain samples at whatever rate the capture was made at
+    struct signal_t
+    {
+        bool is_bad = false;
+        std::vector<Scalar> values;
+    };
+
+    /**
+     * Raw signal files have one capture per line, its label (1 for bad) followed by its samples. Unlike .out files captures don't
+     * have to be the same length and there is no header. Lines which aren't numbers are skipped.
+     */
+    std::vector<signal_t> parse_signals(std::string_view contents);
+
+    // nothing (with a warning) if the file can't be read
+    std::optional<std::vector<signal_t>> load_signal_file(const std::string& path);
+
+    /**
+     * Forward discrete fourier transform of a fixed size. The size is split into its prime factors and transformed with mixed radix
+     * Cooley-Tukey, radix 2 stages get their own butterfly. Any size works, sizes with large prime factors are just slower
+     * (a prime size is a plain O(n^2) DFT).
+     */
+    class fft_t
+    {
+        public:
+            using complex_t = std::complex<double>;
+
+            explicit fft_t(blt::size_t size);
+
+            // in is read size() times with the given stride, out receives the size() coefficients
+            void transform(const complex_t* in, complex_t* out, blt::size_t stride = 1) const;
+
+            [[nodiscard]] blt::size_t size() const
+            {
+                return n;
+            }
+
+        private:
+            void transform(const complex_t* in, complex_t* out, blt::size_t size, blt::size_t stride, blt::size_t factor) const;
+
+            blt::size_t n;
+            std::vector<blt::size_t> factors;
+            // e^(-2 pi i k / n)
+            std::vector<complex_t> twiddles;
+            blt::size_t max_factor = 1;
+    };
+
+    /**
+     * Turns raw captures into spectra of a chosen number of bins. A capture is cut into half overlapping windows of 2 * bins samples,
+     * every window has its mean removed and is Hann windowed, and the power of frequencies 1 to bins (up to nyquist) is averaged over the
+     * windows (Welch's method). A bin holds the RMS amplitude of its frequency, so a sine of amplitude a shows up as a in its bin whatever
+     * the bin count is. Captures shorter than a window are zero padded.
+     */
+    class feature_extractor_t
+    {
+        public:
+            explicit feature_extractor_t(blt::size_t bins);
+
+            // out must hold get_bins() values
+            void extract(blt::span<const Scalar> signal, blt::span<Scalar> out) const;
+
+            // every capture as a sample, captures are processed in parallel
+            [[nodiscard]] data_file_t extract(const std::vector<signal_t>& signals) const;
+
+            [[nodiscard]] blt::size_t get_bins() const
+            {
+                return bins;
+            }
+
+        private:
+            blt::size_t bins;
+            fft_t fft;
+            std::vector<double> window;
+            double window_sum = 0;
+    };
+
+    /**
+     * Spectrum of the last 2 * bins samples of a live signal, kept up to date with a sliding DFT instead of transforming every window from
+     * scratch. Each sample updates the bins in O(bins). The Hann window is applied in the frequency domain and DC is dropped, which is the
+     * same as removing the mean of the window, so a frame is what feature_extractor_t gives for that single window. Frames are L2
+     * normalised like data_file_t::normalize, ready to be looked up in a SOM trained on normalised data.
+     * The running coefficients are recomputed with an FFT once per window so rounding errors can't build up.
+     */
+    class sliding_spectrum_t
+    {
+        public:
+            // a frame every hop samples once the first window is full, hop 0 means half a window (bins samples)
+            explicit sliding_spectrum_t(blt::size_t bins, blt::size_t hop = 0);
+
+            // feeds samples in, appending every frame which becomes due to frames. Returns how many frames were appended
+            blt::size_t push(blt::span<const Scalar> samples, data_file_t& frames);
+
+            // normalised spectrum of the current window into out, which must hold get_bins() values
+            void frame(blt::span<Scalar> out) const;
+
+            // forgets the signal seen so far
+            void reset();
+
+            [[nodiscard]] bool ready() const
+            {
+                return seen >= fft.size();
+            }
+
+            [[nodiscard]] blt::size_t get_bins() const
+            {
+                return bins;
+            }
+
+            [[nodiscard]] blt::size_t get_hop() const
+            {
+                return hop;
+            }
+
+        private:
+            void refresh();
+
+            blt::size_t bins;
+            blt::size_t hop;
+            fft_t fft;
+            // the window, oldest sample at position
+            std::vector<double> ring;
+            blt::size_t position = 0;
+            blt::size_t seen = 0;
+            blt::size_t since_refresh = 0;
+            // unwindowed DFT of the window for frequencies 0 to bins + 1, the outer two are needed by the Hann window
+            std::vector<fft_t::complex_t> coefficients;
+            // e^(2 pi i k / n), shifts a coefficient along by one sample
+            std::vector<fft_t::complex_t> rotations;
+            std::vector<Scalar> scratch;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_FEATURES_H
@@ -20,6 +20,10 @@
 #define COSC_4P80_ASSIGNMENT_3_FILE_H
 
 #include <blt/std/types.h>
+#include <blt/std/ranges.h>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <string>
 #include <string_view>
@@ -39,24 +43,343 @@ namespace assign3
         [[nodiscard]] data_t with_padding(blt::size_t desired_size, Scalar padding_value = 0) const;
     };
     
+    // a sample stored in a data_storage_t. bins points into the storage, so it is only valid until the storage is next modified
+    struct data_view_t
+    {
+        bool is_bad = false;
+        blt::span<const Scalar> bins;
+    };
+    
+    // a sample of a padded_dataset_t, size bins long of which only the first bins.size() are stored and the rest read as padding
+    struct padded_view_t
+    {
+        bool is_bad = false;
+        blt::span<const Scalar> bins;
+        blt::size_t size = 0;
+        Scalar padding = 0;
+        
+        [[nodiscard]] Scalar operator[](const blt::size_t i) const
+        {
+            return i < bins.size() ? bins[i] : padding;
+        }
+    };
+    
+    /**
+     * Samples of a data file, stored by column block instead of one vector per sample. Samples live in chunks, each chunk is one contiguous
+     * row major matrix of bins plus a bitset of labels. Chunks are shared between copies and only cloned once a copy writes to one, so
+     * copying or concatenating files only copies chunk pointers and preprocessing a large capture doesn't double the peak memory.
+     * Every sample has the same number of bins.
+     */
+    class data_storage_t
+    {
+        public:
+            class const_iterator
+            {
+                public:
+                    using iterator_category = std::random_access_iterator_tag;
+                    using value_type = data_view_t;
+                    using difference_type = std::ptrdiff_t;
+                    using reference = data_view_t;
+                    
+                    struct pointer
+                    {
+                        data_view_t view;
+                        
+                        const data_view_t* operator->() const
+                        {
+                            return &view;
+                        }
+                    };
+                    
+                    const_iterator() = default;
+                    
+                    const_iterator(const data_storage_t* storage, const blt::size_t index): storage(storage), index(index)
+                    {}
+                    
+                    reference operator*() const
+                    {
+                        return (*storage)[index];
+                    }
+                    
+                    pointer operator->() const
+                    {
+                        return {**this};
+                    }
+                    
+                    reference operator[](const difference_type n) const
+                    {
+                        return (*storage)[index + n];
+                    }
+                    
+                    const_iterator& operator++()
+                    {
+                        ++index;
+                        return *this;
+                    }
+                    
+                    const_iterator& operator--()
+                    {
+                        --index;
+                        return *this;
+                    }
+                    
+                    const_iterator operator++(int)
+                    {
+                        auto copy = *this;
+                        ++index;
+                        return copy;
+                    }
+                    
+                    const_iterator operator--(int)
+                    {
+                        auto copy = *this;
+                        --index;
+                        return copy;
+                    }
+                    
+                    const_iterator& operator+=(const difference_type n)
+                    {
+                        index += n;
+                        return *this;
+                    }
+                    
+                    const_iterator& operator-=(const difference_type n)
+                    {
+                        index -= n;
+                        return *this;
+                    }
+                    
+                    friend const_iterator operator+(const_iterator it, const difference_type n)
+                    {
+                        return it += n;
+                    }
+                    
+                    friend const_iterator operator+(const difference_type n, const_iterator it)
+                    {
+                        return it += n;
+                    }
+                    
+                    friend const_iterator operator-(const_iterator it, const difference_type n)
+                    {
+                        return it -= n;
+                    }
+                    
+                    friend difference_type operator-(const const_iterator& a, const const_iterator& b)
+                    {
+                        return static_cast<difference_type>(a.index) - static_cast<difference_type>(b.index);
+                    }
+                    
+                    friend bool operator==(const const_iterator& a, const const_iterator& b)
+                    {
+                        return a.index == b.index;
+                    }
+                    
+                    friend bool operator!=(const const_iterator& a, const const_iterator& b)
+                    {
+                        return a.index != b.index;
+                    }
+                    
+                    friend bool operator<(const const_iterator& a, const const_iterator& b)
+                    {
+                        return a.index < b.index;
+                    }
+                    
+                    friend bool operator>(const const_iterator& a, const const_iterator& b)
+                    {
+                        return a.index > b.index;
+                    }
+                    
+                    friend bool operator<=(const const_iterator& a, const const_iterator& b)
+                    {
+                        return a.index <= b.index;
+                    }
+                    
+                    friend bool operator>=(const const_iterator& a, const const_iterator& b)
+                    {
+                        return a.index >= b.index;
+                    }
+                
+                private:
+                    const data_storage_t* storage = nullptr;
+                    blt::size_t index = 0;
+            };
+            
+            using iterator = const_iterator;
+            
+            [[nodiscard]] data_view_t operator[](blt::size_t index) const;
+            
+            [[nodiscard]] data_view_t front() const
+            {
+                return (*this)[0];
+            }
+            
+            [[nodiscard]] data_view_t back() const
+            {
+                return (*this)[count - 1];
+            }
+            
+            [[nodiscard]] const_iterator begin() const
+            {
+                return {this, 0};
+            }
+            
+            [[nodiscard]] const_iterator end() const
+            {
+                return {this, count};
+            }
+            
+            [[nodiscard]] blt::size_t size() const
+            {
+                return count;
+            }
+            
+            [[nodiscard]] bool empty() const
+            {
+                return count == 0;
+            }
+            
+            // bins of every sample, 0 while the storage is empty
+            [[nodiscard]] blt::size_t bin_count() const
+            {
+                return bins;
+            }
+            
+            [[nodiscard]] blt::size_t chunk_count() const
+            {
+                return chunks.size();
+            }
+            
+            // makes room for that many more samples in the last chunk. Sets the bin count of an empty storage
+            void reserve(blt::size_t samples, blt::size_t bin_count);
+            
+            // appends a zeroed sample, the span is valid until the storage is next modified
+            blt::span<Scalar> emplace_back(blt::size_t bin_count, bool is_bad = false);
+            
+            void push_back(bool is_bad, blt::span<const Scalar> values);
+            
+            void push_back(const data_view_t& point)
+            {
+                push_back(point.is_bad, point.bins);
+            }
+            
+            void push_back(const data_t& point)
+            {
+                push_back(point.is_bad, point.bins);
+            }
+            
+            void pop_back();
+            
+            // shares the chunks of o instead of copying its samples
+            void append(const data_storage_t& o);
+            
+            void clear();
+            
+            // copy on write access to the bins of a sample, clones its chunk first if it is shared
+            blt::span<Scalar> mutable_bins(blt::size_t index);
+            
+            void set_bad(blt::size_t index, bool is_bad);
+            
+            /**
+             * calls func(values, samples) with the row major matrix of every chunk, which is cloned first if it is shared.
+             * The rows of a chunk are bin_count() apart
+             */
+            template <typename Func>
+            void for_each_chunk(Func&& func)
+            {
+                for (blt::size_t i = 0; i < chunks.size(); i++)
+                {
+                    auto& chunk = writable(i);
+                    func(chunk.values.data(), chunk.samples);
+                }
+            }
+            
+            /**
+             * changes the number of bins of every sample, filling new bins with padding_value. Rows are moved in place from the back so
+             * unshared chunks are only reallocated if their capacity is too small
+             */
+            void resize_bins(blt::size_t bin_count, Scalar padding_value = 0);
+        
+        private:
+            struct chunk_t
+            {
+                blt::size_t samples = 0;
+                std::vector<Scalar> values;
+                std::vector<blt::u64> labels;
+            };
+            
+            // chunk holding a sample and the index of the sample within it
+            [[nodiscard]] std::pair<blt::size_t, blt::size_t> locate(blt::size_t index) const;
+            
+            chunk_t& writable(blt::size_t chunk);
+            
+            // the last chunk, a fresh one if there are none or the last is shared
+            chunk_t& tail();
+            
+            std::vector<std::shared_ptr<chunk_t>> chunks;
+            // index of the first sample of every chunk
+            std::vector<blt::size_t> starts;
+            blt::size_t count = 0;
+            blt::size_t bins = 0;
+    };
+    
     struct data_file_t
     {
         public:
-            std::vector<data_t> data_points;
+            data_storage_t data_points;
+            // per sample weights, used by coresets where each sample stands in for many. empty means every sample has a weight of 1
+            std::vector<Scalar> weights;
+            
+            [[nodiscard]] Scalar weight(blt::size_t index) const
+            {
+                return weights.empty() ? 1 : weights[index];
+            }
+            
+            [[nodiscard]] Scalar total_weight() const;
             
             [[nodiscard]] data_file_t normalize() const;
             
             [[nodiscard]] data_file_t with_padding(blt::size_t desired_size, Scalar padding_value = 0) const;
             
+            // scales every sample to unit length, only the chunks shared with another file are copied
+            data_file_t& normalize_in_place();
+            
+            // grows every sample to desired_size bins. Samples which already have at least that many are left alone
+            data_file_t& pad_in_place(blt::size_t desired_size, Scalar padding_value = 0);
+            
+            // appends every sample as a line of a .out file, label then bins. A negative decimals writes the shortest text which reads back
+            // as exactly the same value, otherwise that many decimal places (the bundled files use 2)
+            void format_samples(std::string& out, int decimals = -1) const;
+            
+            // writes the samples as a .out text file, weights aren't part of the format and are dropped
+            bool write(const std::string& path, int decimals = -1) const;
+            
+            // the samples at indices (in that order) copied into a file of their own, along with their weights if this file has any
+            [[nodiscard]] data_file_t gather(const std::vector<blt::size_t>& indices) const;
+            
             data_file_t& operator+=(const data_file_t& o);
             
             data_file_t friend operator+(const data_file_t& a, const data_file_t& b);
             
+            /**
+             * loads every .out file under path, in parallel on the shared thread pool. Files which can't be read or parsed are skipped
+             * with a warning
+             */
             static std::vector<data_file_t> load_data_files_from_path(std::string_view path);
+            
+            /**
+             * parses the contents of a .out file: a header line holding the sample and bin counts followed by one line per sample, its
+             * label (1 is bad) then its bins. Lines which don't hold exactly that many values are skipped.
+             * Nothing if the header can't be read
+             */
+            static std::optional<data_file_t> parse(std::string_view contents);
+            
+            // a single text or binary data file, nothing if it can't be read or parsed
+            static std::optional<data_file_t> load(const std::string& path);
+            
+            // paths of every data file under path
+            static std::vector<std::string> get_data_file_list(std::string_view path);
         
         private:
-            static std::vector<std::string> get_data_file_list(std::string_view path);
-            
             static std::vector<data_file_t> load_data_files(const std::vector<std::string>& files);
     };
     
@@ -64,7 +387,7 @@ namespace assign3
     {
         public:
             explicit partitioned_dataset_t(std::vector<data_file_t> groups):
-                    groups(std::move(groups)), bins(this->groups.begin()->data_points.begin()->bins.size())
+                    groups(std::move(groups)), bins(this->groups.begin()->data_points.bin_count())
             {}
             
             [[nodiscard]] const std::vector<data_file_t>& getGroups() const
@@ -76,12 +399,19 @@ namespace assign3
             {
                 return bins;
             }
+            
+            // every group except group, sharing the storage of the groups rather than copying it
+            [[nodiscard]] data_file_t without(blt::size_t group) const;
         
         private:
             std::vector<data_file_t> groups;
             blt::size_t bins;
     };
     
+    /**
+     * Stratified split of one or more files into groups. The files are concatenated by sharing their storage and groups are lists of
+     * indices into the result, so nothing is copied until the groups are gathered by partition.
+     */
     struct dataset_partitioner
     {
         public:
@@ -90,17 +420,95 @@ namespace assign3
                 with(file);
             }
             
-            dataset_partitioner& with(const data_file_t& data)
+            dataset_partitioner& with(const data_file_t& file)
             {
-                BLT_ASSERT(data.data_points.begin()->bins.size() == files.begin()->data_points.begin()->bins.size());
-                files.push_back(data);
+                BLT_ASSERT(data.data_points.empty() || file.data_points.bin_count() == data.data_points.bin_count());
+                data += file;
                 return *this;
             }
             
+            // indices into get_data() of every group. Good and bad samples are dealt out in turn so every group gets its share of both
+            [[nodiscard]] std::vector<std::vector<blt::size_t>> partition_indices(blt::size_t groups, blt::size_t seed) const;
+            
+            // every group gathered into a file of its own. This is the one copy of the data partitioning makes, every sample is copied into
+            // exactly one group however many groups there are. Storage is shared a whole chunk at a time, so a group can't be a view of
+            // scattered samples; callers that only need the split should use partition_indices
+            [[nodiscard]] partitioned_dataset_t partition(blt::size_t groups, blt::size_t seed) const;
+            
             [[nodiscard]] partitioned_dataset_t partition(blt::size_t groups) const;
+            
+            [[nodiscard]] const data_file_t& get_data() const
+            {
+                return data;
+            }
         
         private:
+            data_file_t data;
+    };
+    
+    /**
+     * Files of different bin counts seen as one dataset of the largest bin count, with the bins a sample doesn't have reading as the padding
+     * value. This is what with_padding gives, but the files share their storage instead of every sample being copied out to full length.
+     */
+    class padded_dataset_t
+    {
+        public:
+            explicit padded_dataset_t(Scalar padding_value = 0): padding(padding_value)
+            {}
+            
+            padded_dataset_t& with(const data_file_t& file);
+            
+            [[nodiscard]] padded_view_t operator[](blt::size_t index) const;
+            
+            [[nodiscard]] Scalar weight(blt::size_t index) const;
+            
+            [[nodiscard]] Scalar total_weight() const;
+            
+            // samples first to first + count padded out into a file of their own
+            [[nodiscard]] data_file_t materialize(blt::size_t first, blt::size_t count) const;
+            
+            // the samples at indices padded out into a file of their own
+            [[nodiscard]] data_file_t materialize(const std::vector<blt::size_t>& indices) const;
+            
+            // count random samples padded out (drawn with replacement), or all of them if there aren't more than count
+            [[nodiscard]] data_file_t sample(blt::size_t count, blt::size_t seed) const;
+            
+            [[nodiscard]] blt::size_t size() const
+            {
+                return count;
+            }
+            
+            [[nodiscard]] blt::size_t bin_count() const
+            {
+                return bins;
+            }
+            
+            [[nodiscard]] Scalar get_padding() const
+            {
+                return padding;
+            }
+            
+            // every distinct stored bin count in ascending order, the last one always being bin_count()
+            [[nodiscard]] const std::vector<blt::size_t>& get_cuts() const
+            {
+                return cuts;
+            }
+            
+            [[nodiscard]] const std::vector<data_file_t>& get_files() const
+            {
+                return files;
+            }
+        
+        private:
+            [[nodiscard]] std::pair<blt::size_t, blt::size_t> locate(blt::size_t index) const;
+            
             std::vector<data_file_t> files;
+            // index of the first sample of each file
+            std::vector<blt::size_t> starts;
+            std::vector<blt::size_t> cuts;
+            blt::size_t count = 0;
+            blt::size_t bins = 0;
+            Scalar padding;
     };
     
     void save_as_csv(const std::string& file, const std::vector<std::pair<std::string, std::vector<Scalar>>>& data);
@@ -48,12 +48,16 @@ namespace assign3
     enum class debug_t
     {
         DATA_POINT,
-        DISTANCE
+        DISTANCE,
+        U_MATRIX,
+        COMPONENT_PLANE
     };
     
-    inline std::array<std::string, 2> debug_names{
+    inline std::array<std::string, 4> debug_names{
             "Distance to Datapoint",
-            "Distance to Neighbours"
+            "Distance to Neighbours",
+            "U-Matrix",
+            "Component Plane"
     };
     
     enum class init_t
@@ -74,6 +78,19 @@ namespace assign3
             "Find min and max of each data element, then initialize weights between that range",
             "Initialize weights based on the input data"
     };
+    
+    enum class projection_type_t
+    {
+        NONE,
+        SPARSE_RANDOM,
+        RANDOMIZED_PCA
+    };
+    
+    inline std::array<std::string, 3> projection_names{
+            "None",
+            "Sparse Random",
+            "Randomized PCA"
+    };
 }
 
 #endif //COSC_4P80_ASSIGNMENT_3_FWDECL_H
@@ -0,0 +1,79 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_GENERATOR_H
+#define COSC_4P80_ASSIGNMENT_3_GENERATOR_H
+
+#include <assign3/file.h>
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace assign3
+{
+    /**
+     * Synthetic motor spectra with the statistics of a real data file, for measuring how things scale past the size of the bundled data.
+     * The real spectra of each class are resampled to the requested number of bins. Every generated sample mixes two random spectra
+     * of its class, scales the mix by a random gain and multiplies each bin by log-normal noise sized by how much that bin varies within
+     * the class, so the shapes (and the correlations between bins) stay those of real captures.
+     * Sample i only depends on the seed and i, so the output is the same however many threads generate it.
+     */
+    class spectrum_generator_t
+    {
+        public:
+            // nothing (with a warning) unless source has at least one good and one bad sample
+            static std::optional<spectrum_generator_t> from_file(const data_file_t& source, blt::size_t bins, Scalar bad_ratio, blt::size_t seed);
+
+            [[nodiscard]] bool is_bad(blt::size_t sample) const;
+
+            // samples first to first + count
+            [[nodiscard]] data_file_t generate(blt::size_t first, blt::size_t count) const;
+
+            // writes samples generated samples as a .out text file, generating and formatting blocks in parallel
+            bool write_text(const std::string& path, blt::size_t samples) const;
+
+            // writes samples generated samples as a binary data file, see mapped_data_file_t
+            bool write_binary(const std::string& path, blt::size_t samples, blt::size_t precision = sizeof(Scalar)) const;
+
+            [[nodiscard]] blt::size_t get_bins() const
+            {
+                return bins;
+            }
+
+        private:
+            spectrum_generator_t() = default;
+
+            /**
+             * turns blocks of samples into something writable with make(first, count) in parallel, a batch at a time, and hands the
+             * results to write in order
+             */
+            template <typename Make, typename Write>
+            bool write_blocks(blt::size_t samples, Make&& make, Write&& write) const;
+
+            // resampled real spectra, indexed by is_bad
+            std::array<std::vector<std::vector<Scalar>>, 2> spectra;
+            // log-normal sigma of every bin, indexed by is_bad
+            std::array<std::vector<Scalar>, 2> sigmas;
+            blt::size_t bins = 0;
+            Scalar bad_ratio = 0;
+            blt::size_t seed = 0;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_GENERATOR_H
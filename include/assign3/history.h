@@ -0,0 +1,134 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_HISTORY_H
+#define COSC_4P80_ASSIGNMENT_3_HISTORY_H
+
+#include <assign3/fwdecl.h>
+#include <optional>
+#include <vector>
+
+namespace assign3
+{
+    /**
+     * Per epoch snapshots of the codebook and activations of a training run, for scrubbing back through it. Every keyframe_interval
+     * stored frames the full state is kept, the frames between store their difference from the last keyframe quantized to 8 bits with one
+     * scale per neuron (16 bits with one scale for the activations). Since every frame only depends on its keyframe the error never
+     * accumulates, it is at most half a quantization step, and any epoch is rebuilt from two frames.
+     * When a memory budget is set and the history grows past it every other frame is dropped and only every stride'th epoch is kept from
+     * then on, so a long run keeps an evenly spaced (if coarser) history instead of running out of memory.
+     */
+    class codebook_history_t
+    {
+        public:
+            // memory_budget in bytes, 0 keeps every epoch
+            explicit codebook_history_t(blt::size_t keyframe_interval = 50, blt::size_t memory_budget = 0);
+
+            // clears the history for a map of neurons vectors of dimensions values, called by som_t when the history is attached
+            void begin(blt::size_t neurons, blt::size_t dimensions);
+
+            void record(blt::size_t epoch, const std::vector<Scalar>& codebook, const std::vector<Scalar>& activations);
+
+            /**
+             * rebuilds the latest stored epoch at or before epoch into codebook (neuron major) and activations.
+             * @return the epoch that was rebuilt, nothing if there is no frame at or before epoch
+             */
+            std::optional<blt::size_t> reconstruct(blt::size_t epoch, std::vector<Scalar>& codebook, std::vector<Scalar>& activations) const;
+
+            [[nodiscard]] bool empty() const
+            {
+                return frames.empty();
+            }
+
+            [[nodiscard]] blt::size_t frame_count() const
+            {
+                return frames.size();
+            }
+
+            [[nodiscard]] blt::size_t epoch_of(const blt::size_t frame) const
+            {
+                return frames[frame].epoch;
+            }
+
+            [[nodiscard]] blt::size_t first_epoch() const
+            {
+                return frames.empty() ? 0 : frames.front().epoch;
+            }
+
+            [[nodiscard]] blt::size_t last_epoch() const
+            {
+                return frames.empty() ? 0 : frames.back().epoch;
+            }
+
+            // epochs between stored frames, grows as the memory budget forces the history to thin out
+            [[nodiscard]] blt::size_t get_stride() const
+            {
+                return stride;
+            }
+
+            [[nodiscard]] blt::size_t get_neurons() const
+            {
+                return neurons;
+            }
+
+            [[nodiscard]] blt::size_t get_dimensions() const
+            {
+                return dimensions;
+            }
+
+            // bytes used by the stored frames
+            [[nodiscard]] blt::size_t memory_usage() const
+            {
+                return memory;
+            }
+
+        private:
+            struct frame_t
+            {
+                blt::size_t epoch = 0;
+                // epoch of the keyframe this frame is relative to, its own epoch for keyframes
+                blt::size_t key_epoch = 0;
+                // keyframes only
+                std::vector<Scalar> codebook;
+                std::vector<Scalar> activations;
+                // everything else
+                std::vector<blt::i8> codebook_deltas;
+                std::vector<Scalar> codebook_scales;
+                std::vector<blt::i16> activation_deltas;
+                Scalar activation_scale = 0;
+
+                [[nodiscard]] blt::size_t bytes() const;
+            };
+
+            [[nodiscard]] const frame_t* find_keyframe(blt::size_t epoch) const;
+
+            void thin();
+
+            blt::size_t keyframe_interval;
+            blt::size_t memory_budget;
+
+            blt::size_t neurons = 0;
+            blt::size_t dimensions = 0;
+            blt::size_t stride = 1;
+            blt::size_t since_keyframe = 0;
+            blt::size_t memory = 0;
+            std::vector<frame_t> frames;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_HISTORY_H
@@ -24,7 +24,12 @@
 #include "blt/gfx/renderer/font_renderer.h"
 #include <assign3/file.h>
 #include <assign3/som.h>
+#include <assign3/projection.h>
+#include <atomic>
 #include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 namespace assign3
 {
@@ -49,10 +54,59 @@ namespace assign3
     class motor_data_t
     {
         public:
+            motor_data_t() = default;
+            
+            motor_data_t(const motor_data_t&) = delete;
+            motor_data_t& operator=(const motor_data_t&) = delete;
+            
+            ~motor_data_t();
+            
             std::vector<data_file_t> files;
             std::vector<std::string> map_files_names;
             
             void update();
+            
+            /**
+             * loads and normalises every data file under path on a thread of its own (which works through the files on the shared pool),
+             * so the window can open straight away. Every path has a slot in directory order, finished files wait in their slot until poll
+             * moves them into files. Files always arrive in directory order whichever finishes loading first
+             */
+            void load_async(const std::string& path);
+            
+            // abandons the files which haven't started loading yet and waits for the rest
+            void stop();
+            
+            // moves the finished files at the front of the slots into files, only call from the thread that reads files. True if any arrived
+            bool poll();
+            
+            // true until every file has been loaded (or skipped), some of them may still be waiting for poll after that
+            [[nodiscard]] bool is_loading() const
+            {
+                return loaded_files < total_files;
+            }
+            
+            [[nodiscard]] blt::size_t get_loaded_files() const
+            {
+                return loaded_files;
+            }
+            
+            [[nodiscard]] blt::size_t get_total_files() const
+            {
+                return total_files;
+            }
+        
+        private:
+            std::thread loader;
+            std::atomic<bool> stop_loading{false};
+            std::atomic<blt::size_t> loaded_files{0};
+            std::atomic<blt::size_t> total_files{0};
+            // guards slots, slot_done and next_slot
+            std::mutex finished_mutex;
+            // one per path, empty if the file couldn't be loaded
+            std::vector<std::optional<data_file_t>> slots;
+            std::vector<blt::u8> slot_done;
+            // first slot poll hasn't handed over yet
+            blt::size_t next_slot = 0;
     };
     
     struct render_data_t
@@ -85,17 +139,31 @@ namespace assign3
             void draw_som(neuron_render_info_t info, const std::function<blt::vec4(render_data_t)>& color_func);
             
             void draw_debug(const data_file_t& file);
+
+            // grey scale map of values (one per neuron) scaled to their range, with each value written on its neuron
+            void draw_values(const std::vector<Scalar>& values);
             
             void render();
+            
+            // shown in place of the controls until there is a network to control
+            void render_loading();
 
             void draw_calls();
             
-            void regenerate_network()
+            void regenerate_network();
+            
+            void set_projection(projection_type_t type, blt::i32 dimensions)
+            {
+                selected_projection = static_cast<int>(type);
+                projected_dimensions = dimensions;
+            }
+            
+            // the data the SOM is trained against, which is the selected file after projection (if any)
+            [[nodiscard]] const data_file_t& get_training_file() const
             {
-                distance_function = distance_function_t::from_shape(static_cast<shape_t>(selected_som_mode), som_width, som_height);
-                som = std::make_unique<som_t>(motor_data.files[currently_selected_network], som_width, som_height, max_epochs,
-                                              distance_function.get(), topology_function.get(), static_cast<shape_t>(selected_som_mode),
-                                              static_cast<init_t>(selected_init_type), normalize_init);
+                if (projection.empty())
+                    return motor_data.files[currently_selected_network];
+                return projected_file;
             }
 
             blt::gfx::batch_renderer_2d& get_renderer()
@@ -105,9 +173,14 @@ namespace assign3
         
         private:
             motor_data_t& motor_data;
+            // about 128 KB per epoch over 2000 epochs (a 12x12 map at 1000 bins) before it starts to thin out
+            codebook_history_t history{50, 256 * 1024 * 1024};
             std::unique_ptr<som_t> som;
             std::unique_ptr<topology_function_t> topology_function;
             std::unique_ptr<distance_function_t> distance_function;
+            projection_t projection;
+            data_file_t projected_file;
+            any_convergence_monitor_t convergence_monitor;
             
             blt::gfx::font_renderer_t fr2d{};
             blt::gfx::batch_renderer_2d br2d;
@@ -117,18 +190,32 @@ namespace assign3
             blt::i32 max_epochs = 2000;
             Scalar initial_learn_rate = 1;
             Scalar user_rbf_scale = 1;
+            Scalar drift_tolerance = 0;
             
             int currently_selected_network = 0;
             int selected_som_mode = 0;
             int selected_init_type = 0;
+            int selected_projection = 0;
+            blt::i32 projected_dimensions = 16;
             bool normalize_init = false;
+            bool early_stopping = false;
             bool debug_mode = false;
             bool draw_colors = true;
             bool draw_data_lines = false;
             bool running = false;
+            bool lattice_activations = false;
+            std::optional<Scalar> activation_agreement;
+            bool show_history = false;
+            int history_epoch = 0;
+            std::optional<blt::size_t> shown_epoch;
+            std::vector<Scalar> history_codebook;
+            std::vector<Scalar> history_activations;
             int debug_state = 0;
             int selected_data_point = 0;
             int selected_neuron = 0;
+            int selected_bin = 0;
+            // bumped whenever the network is regenerated, so per network caches know to recompute
+            blt::size_t network_generation = 0;
             
             float requested_activation = 0.5;
             float at_distance_measurement = 2;
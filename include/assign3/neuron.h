@@ -24,6 +24,7 @@
 #include "blt/std/types.h"
 #include <assign3/functions.h>
 #include <assign3/file.h>
+#include <assign3/sparse.h>
 
 namespace assign3
 {
@@ -43,11 +44,44 @@ namespace assign3
 
         neuron_t& randomize(blt::size_t seed, init_t init, bool normalize, const data_file_t& file);
 
-        neuron_t& update(const std::vector<Scalar>& new_data, Scalar dist, Scalar eta);
+        neuron_t& update(blt::span<const Scalar> new_data, Scalar dist, Scalar eta);
 
         static Scalar distance(distance_function_t* dist_func, const neuron_t& n1, const neuron_t& n2);
 
-        [[nodiscard]] Scalar dist(const std::vector<Scalar>& X) const;
+        [[nodiscard]] Scalar dist(blt::span<const Scalar> X) const;
+
+        /**
+         * padded training splits the codebook vector into segments at the cuts of a padded_dataset_t. The padded tail of a sample is one
+         * value over whole segments, so its share of the distance comes from each segment's sum and sum of squares, and moving a segment
+         * towards it is an affine map which is only applied to the bins once a sample with stored bins there updates the segment.
+         * A sample then costs its stored bins plus one step per segment rather than every bin. get_data is stale until end_padded
+         */
+        void begin_padded(const std::vector<blt::size_t>& cuts);
+
+        void end_padded();
+
+        neuron_t& update(const padded_view_t& new_data, Scalar dist, Scalar eta);
+
+        [[nodiscard]] Scalar dist(const padded_view_t& X) const;
+
+        /**
+         * sparse training keeps the codebook vector as data * scale along with its squared norm. The distance to a top-k sample only needs
+         * the dot product over the kept bins, and moving towards it scales the whole vector (by changing scale) before adding to k bins,
+         * so both cost O(k). The bins a sample dropped are treated as zero by the update. get_data is stale until end_sparse
+         */
+        void begin_sparse();
+
+        void end_sparse();
+
+        neuron_t& update(const sparse_view_t& new_data, Scalar dist, Scalar eta);
+
+        [[nodiscard]] Scalar dist(const sparse_view_t& X) const;
+
+        neuron_t& set_data(const std::vector<Scalar>& new_data)
+        {
+            data = new_data;
+            return *this;
+        }
 
         neuron_t& set_activation(Scalar act)
         {
@@ -81,9 +115,29 @@ namespace assign3
         }
 
     private:
+        // bins [begin, end) read as data * scale + offset
+        struct segment_t
+        {
+            blt::size_t begin = 0;
+            blt::size_t end = 0;
+            Scalar scale = 1;
+            Scalar offset = 0;
+            double sum = 0;
+            double squares = 0;
+        };
+
+        // applies the pending scale and offset of segment to its bins and recomputes its sums
+        void apply(segment_t& segment);
+
         Scalar x_pos, y_pos;
         Scalar activation = 0;
         std::vector<Scalar> data;
+        // only while training padded
+        std::vector<segment_t> segments;
+        // only while training sparse
+        bool sparse = false;
+        Scalar sparse_scale = 1;
+        double norm_squared = 0;
     };
 }
 
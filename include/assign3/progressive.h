@@ -0,0 +1,84 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_PROGRESSIVE_H
+#define COSC_4P80_ASSIGNMENT_3_PROGRESSIVE_H
+
+#include <assign3/som.h>
+#include <memory>
+
+namespace assign3
+{
+    struct progressive_stage_t
+    {
+        blt::size_t width, height;
+        // global epoch at which the map grows to the next stage
+        blt::size_t end_epoch;
+    };
+
+    /**
+     * Coarse to fine training. The map starts at a small lattice and is doubled (by interpolating the codebook) until it reaches the
+     * requested size. The learning rate and neighbourhood schedule run over the global epoch count, so the early epochs where the map is
+     * still ordering itself happen on the cheap small lattices and only the fine tuning is done at full size.
+     */
+    class progressive_trainer_t
+    {
+        public:
+            /**
+             * @param min_size smallest width / height the first stage is allowed to shrink to
+             * @param coarse_fraction fraction of max_epochs spent on the stages before the final size, split evenly between them
+             */
+            progressive_trainer_t(const data_file_t& file, blt::size_t width, blt::size_t height, blt::size_t max_epochs,
+                                  topology_function_t* topology_function, shape_t shape, init_t init, bool normalize, blt::size_t min_size = 3,
+                                  Scalar coarse_fraction = 0.5);
+
+            // trains one epoch then grows the map if the current stage has ended
+            Scalar train_epoch(Scalar initial_learn_rate, Scalar user_scale = 1);
+
+            [[nodiscard]] som_t& get_som()
+            {
+                return *som;
+            }
+
+            [[nodiscard]] const som_t& get_som() const
+            {
+                return *som;
+            }
+
+            [[nodiscard]] const std::vector<progressive_stage_t>& get_stages() const
+            {
+                return stages;
+            }
+
+            [[nodiscard]] blt::size_t get_current_stage() const
+            {
+                return current_stage;
+            }
+
+        private:
+            void apply_radius_scale();
+
+            std::vector<progressive_stage_t> stages;
+            blt::size_t current_stage = 0;
+            shape_t shape;
+            std::unique_ptr<distance_function_t> dist_func;
+            std::unique_ptr<som_t> som;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_PROGRESSIVE_H
@@ -0,0 +1,102 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_PROJECTION_H
+#define COSC_4P80_ASSIGNMENT_3_PROJECTION_H
+
+#include <assign3/fwdecl.h>
+#include <assign3/file.h>
+#include <assign3/array.h>
+#include <ostream>
+
+namespace assign3
+{
+    /**
+     * Linear map from the full bin space (d) down to a reduced space (k) which the SOM is then trained in.
+     * Both projections are stored as a dense k x d row major basis plus a mean which is removed before projecting.
+     */
+    class projection_t
+    {
+        public:
+            projection_t() = default;
+
+            /**
+             * Achlioptas / Li style sparse random projection. Each basis entry is +-sqrt(s / k) with probability 1 / 2s and zero otherwise,
+             * using s = sqrt(d). Distances are preserved in expectation, so no fitting against the data is required.
+             */
+            static projection_t sparse_random(blt::size_t input_dimensions, blt::size_t output_dimensions, blt::size_t seed);
+
+            /**
+             * Randomized PCA (subspace iteration on the sample covariance followed by a Rayleigh-Ritz step)
+             * the basis is orthonormal so reconstruction is exact for anything inside the retained subspace.
+             */
+            static projection_t randomized_pca(const data_file_t& file, blt::size_t output_dimensions, blt::size_t seed,
+                                               blt::size_t oversampling = 8, blt::size_t power_iterations = 3);
+
+            static projection_t make(projection_type_t type, const data_file_t& file, blt::size_t output_dimensions, blt::size_t seed);
+
+            // out must already hold get_output_dimensions() values
+            void project(blt::span<const Scalar> in, blt::span<Scalar> out) const;
+
+            [[nodiscard]] data_file_t project(const data_file_t& file) const;
+
+            /**
+             * maps a point in the reduced space back into the full bin space, using the minimum norm inverse of the projection.
+             * Anything outside the retained subspace is lost so this is only exact for PCA on data inside the top k components.
+             */
+            void reconstruct(const std::vector<Scalar>& in, std::vector<Scalar>& out) const;
+
+            /**
+             * writes the codebook of a SOM trained in the reduced space in full bin space, one neuron per row
+             */
+            void write_reconstructed_codebook(std::ostream& out, const array_t& array) const;
+
+            [[nodiscard]] blt::size_t get_input_dimensions() const
+            {
+                return input_dimensions;
+            }
+
+            [[nodiscard]] blt::size_t get_output_dimensions() const
+            {
+                return output_dimensions;
+            }
+
+            [[nodiscard]] bool empty() const
+            {
+                return basis.empty();
+            }
+
+        private:
+            void compute_reconstruction();
+
+            projection_t(blt::size_t input_dimensions, blt::size_t output_dimensions):
+                    input_dimensions(input_dimensions), output_dimensions(output_dimensions), basis(input_dimensions * output_dimensions),
+                    mean(input_dimensions)
+            {}
+
+            blt::size_t input_dimensions = 0;
+            blt::size_t output_dimensions = 0;
+            // row major, output_dimensions rows of input_dimensions
+            std::vector<Scalar> basis;
+            // row major, output_dimensions rows of input_dimensions. (R R^T)^-1 R
+            std::vector<Scalar> reconstruction;
+            std::vector<Scalar> mean;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_PROJECTION_H
@@ -22,6 +22,13 @@
 #include <assign3/array.h>
 #include <assign3/file.h>
 #include <assign3/functions.h>
+#include <assign3/convergence.h>
+#include <assign3/evaluator.h>
+#include <assign3/thread_pool.h>
+#include <assign3/trace.h>
+#include <assign3/history.h>
+#include <memory>
+#include <optional>
 
 namespace assign3
 {
@@ -31,40 +38,226 @@ namespace assign3
         som_t(const data_file_t& file, blt::size_t width, blt::size_t height, blt::size_t max_epochs, distance_function_t* dist_func,
               topology_function_t* topology_function, shape_t shape, init_t init, bool normalize);
 
+        /**
+         * warm start from a map trained on the same kind of data at a different number of bins. The lattice size, shape and positions are
+         * copied and every codebook vector is spectrally resampled to the bin count of file, so training can skip the ordering phase.
+         * dist_func must match the size of the trained map. schedule_start is passed to set_schedule_start
+         */
+        som_t(const data_file_t& file, const som_t& trained, blt::size_t max_epochs, distance_function_t* dist_func,
+              topology_function_t* topology_function, Scalar schedule_start = 0.5);
+
+        /**
+         * out of core training. Every epoch reads stream in shuffled chunks and every evaluation streams it once more, only
+         * resident_samples random samples (used to initialise the map, and by anything that takes the SOM's file) are kept in memory.
+         * Evaluations always cover the whole stream, so error estimation, async evaluation and the drift tolerance don't apply.
+         * stream is not owned and has to outlive the SOM
+         */
+        som_t(data_stream_t* stream, blt::size_t width, blt::size_t height, blt::size_t max_epochs, distance_function_t* dist_func,
+              topology_function_t* topology_function, shape_t shape, init_t init, bool normalize, blt::size_t resident_samples = 4096);
+
+        /**
+         * joint training over files of different bin counts, which don't have to be padded out to the same length first. The map has
+         * data->bin_count() bins and the neurons handle the padded tails analytically (see neuron_t::begin_padded). Evaluations go over
+         * the padded dataset a block at a time, only resident_samples padded samples (for initialising the map and anything that takes
+         * the SOM's file) are kept. Error estimation, async evaluation and the drift tolerance don't apply.
+         * data is not owned and has to outlive the SOM
+         */
+        som_t(const padded_dataset_t* data, blt::size_t width, blt::size_t height, blt::size_t max_epochs, distance_function_t* dist_func,
+              topology_function_t* topology_function, shape_t shape, init_t init, bool normalize, blt::size_t resident_samples = 4096);
+
         som_t(const som_t&) = delete;
         som_t& operator=(const som_t&) = delete;
-        som_t(som_t&&) = default;
-        som_t& operator=(som_t&&) = default;
+        // an evaluation running in the background refers back to this SOM, so it has to stay where it is
+        som_t(som_t&&) = delete;
+        som_t& operator=(som_t&&) = delete;
+
+        ~som_t();
+
+        blt::size_t get_closest_neuron(blt::span<const Scalar> data);
+
+        // the padded tail costs one step per segment while training padded, every bin otherwise
+        blt::size_t get_closest_neuron(const padded_view_t& data);
 
-        blt::size_t get_closest_neuron(const std::vector<Scalar>& data);
+        // O(k) per neuron while training sparse, O(bins) otherwise
+        blt::size_t get_closest_neuron(const sparse_view_t& data);
 
         Scalar find_closest_neighbour_distance(blt::size_t v0);
 
         Scalar train_epoch(Scalar initial_learn_rate, Scalar user_scale = 1);
 
-        blt::vec2 get_topological_position(const std::vector<Scalar>& data);
+        /**
+         * swaps the lattice for an interpolated one of a new size, keeping the epoch and error history.
+         * dist_func must match the new size for wrapped shapes and replaces the current one (still not owned)
+         */
+        void resize(blt::size_t width, blt::size_t height, distance_function_t* new_dist_func);
+
+        /**
+         * multiplies the neighbourhood falloff. Used to keep the neighbourhood radius the same fraction of the map while it is smaller than
+         * the final size, a value of (final_size / current_size)^2 keeps the radius proportional
+         */
+        void set_radius_scale(Scalar scale)
+        {
+            radius_scale = scale;
+        }
+
+        /**
+         * fraction of the learning rate / neighbourhood schedule that has already happened before the first epoch. The schedule then runs
+         * from this point to the end over max_epochs, an already ordered map can start with a smaller neighbourhood and learning rate
+         */
+        void set_schedule_start(Scalar fraction)
+        {
+            schedule_start = fraction;
+        }
+
+        /**
+         * which epochs compute errors and activations, defaults to every epoch. Errors are stored alongside the epoch they belong to,
+         * see get_error_epochs
+         */
+        void set_evaluation_schedule(const evaluation_schedule_t& new_schedule)
+        {
+            schedule = new_schedule;
+        }
+
+        /**
+         * when enabled scheduled evaluations run on a snapshot of the codebook in the shared thread pool while training continues.
+         * At most one evaluation is in flight, the next scheduled one waits for it. Results are recorded (and the activations updated) at
+         * the start of the first epoch after they finish, and all of them are in once training has finished. When no worker is idle (every
+         * worker already training a map) the evaluation runs synchronously instead
+         */
+        void set_async_evaluation(bool async)
+        {
+            async_evaluation = async;
+        }
+
+        /**
+         * estimate the errors from a stratified random subsample sized so the confidence interval is about interval_width wide (as a
+         * fraction of the dataset) instead of evaluating every sample. The activations come from the same subsample. A width of 0 goes back
+         * to exact evaluation
+         */
+        void set_error_estimation(Scalar interval_width, Scalar confidence = 0.95);
+
+        /**
+         * only recompute the distances and activation of neurons whose codebook vector has moved more than tolerance since they were last
+         * evaluated, the rest are reused. Late in training most of the map has settled so evaluations get much cheaper, at the cost of
+         * distances (and so BMUs and errors) being off by up to tolerance. Estimated evaluations always start fresh. 0 evaluates exactly
+         */
+        void set_drift_tolerance(Scalar tolerance);
+
+        // how activations are computed by every evaluation from now on, see activation_mode_t
+        void set_activation_mode(activation_mode_t mode);
+
+        // fraction of neurons classified the same by exact and lattice activations of the current codebook. Leaves the activations alone
+        Scalar activation_agreement(Scalar user_scale = 1);
+
+        /**
+         * trains on a top-k encoding of the file (see sparse_file_t) so finding the BMU and updating a neuron cost O(k) instead of O(bins).
+         * Evaluations still use the full file, so the errors include whatever the approximation costs. 0 (or k of at least the bin count,
+         * nothing would be dropped) trains dense.
+         * Only applies to SOMs training from their file
+         */
+        void set_sparse_training(blt::size_t k);
+
+        // the encoding sparse training uses, nothing while training dense
+        [[nodiscard]] const std::optional<sparse_file_t>& get_sparse_file() const
+        {
+            return sparse_file;
+        }
+
+        // (weighted) fraction of samples whose BMU from their top-k encoding is their BMU from the full sample, 1 while training dense
+        Scalar sparse_bmu_agreement();
+
+        /**
+         * records the BMUs of every exactly evaluated epoch (estimated ones are skipped) into trace, which is not owned and is reset for
+         * this run. Resizing the map ends the trace. Pass nullptr to stop recording
+         */
+        void set_trace(bmu_trace_t* trace);
+
+        /**
+         * stores the codebook and the current activations after every epoch (and the state when attached) into history, which is not
+         * owned and is reset for this map. With async evaluation the activations are those of the last recorded evaluation.
+         * Resizing the map ends the history. Pass nullptr to stop recording
+         */
+        void set_history(codebook_history_t* history);
+
+        // blocks until the evaluation in flight (if any) has been recorded
+        void finish_evaluations();
+
+        blt::vec2 get_topological_position(blt::span<const Scalar> data);
 
         Scalar topological_error();
 
+        // topological error (weighted fraction of samples whose two BMUs are not neighbours) of some other data against this map
+        Scalar topological_error(const data_file_t& data);
+
         Scalar quantization_error();
 
+        // (weighted) count of samples from some other data misclassified by the current activations of this map
+        Scalar quantization_error(const data_file_t& data);
+
         Scalar compute_errors(Scalar user_scale = 1);
 
         Scalar compute_neuron_activations(Scalar user_scale = 1, Scalar distance = 2, Scalar activation = 0.5);
 
+        /**
+         * mean codebook distance from each neuron to its lattice neighbours (wrapped / hex neighbours included depending on the shape).
+         * Cached until the codebook next changes
+         */
+        const std::vector<Scalar>& get_u_matrix();
+
+        // weight of bin in every neuron, cached until the codebook next changes. Empty if the map has no such bin
+        const std::vector<Scalar>& get_component_plane(blt::size_t bin);
+
+        // fills the cache for all of bins at once, in parallel
+        void compute_component_planes(const std::vector<blt::size_t>& bins);
+
         void write_activations(std::ostream& out);
 
+        void write_u_matrix(std::ostream& out);
+
+        // x, y and one column per bin
+        void write_component_planes(std::ostream& out, const std::vector<blt::size_t>& bins);
+
         void write_topology_errors(std::ostream& out);
 
         void write_quantization_errors(std::ostream& out);
 
         void write_all_errors(std::ostream& out);
 
+        /**
+         * monitor is checked after every epoch and is not owned by the SOM. Pass nullptr to always train until max_epochs
+         */
+        void set_convergence_monitor(convergence_monitor_t* monitor)
+        {
+            convergence_monitor = monitor;
+        }
+
+        // true once max_epochs has been reached or the convergence monitor has ended training early
+        [[nodiscard]] bool is_finished() const
+        {
+            return converged || current_epoch >= max_epochs;
+        }
+
+        [[nodiscard]] bool has_converged() const
+        {
+            return converged;
+        }
+
+        [[nodiscard]] const std::string& get_stop_reason() const
+        {
+            return stop_reason;
+        }
+
         [[nodiscard]] const array_t& get_array() const
         {
             return array;
         }
 
+        // activations within this distance of 0 count as neither good nor bad
+        [[nodiscard]] Scalar get_quantization_distance() const
+        {
+            return quantization_distance;
+        }
+
         [[nodiscard]] blt::size_t get_current_epoch() const
         {
             return current_epoch;
@@ -85,19 +278,134 @@ namespace assign3
             return quantization_errors;
         }
 
+        // confidence interval of each entry of get_topological_errors, zero width for exact evaluations
+        [[nodiscard]] const std::vector<error_interval_t>& get_topological_error_intervals() const
+        {
+            return topological_intervals;
+        }
+
+        [[nodiscard]] const std::vector<error_interval_t>& get_quantization_error_intervals() const
+        {
+            return quantization_intervals;
+        }
+
+        // epoch each entry of the error vectors was computed at
+        [[nodiscard]] const std::vector<blt::size_t>& get_error_epochs() const
+        {
+            return error_epochs;
+        }
+
+        // RMS distance the codebook moved during each epoch
+        [[nodiscard]] const std::vector<Scalar>& get_codebook_movements() const
+        {
+            return codebook_movements;
+        }
+
+        [[nodiscard]] const data_file_t& get_file() const
+        {
+            return file;
+        }
+
+        // (weighted) size of the data the quantization error counts over. The whole stream or padded dataset rather than the resident
+        // samples in get_file, and the weight a coreset stands for rather than its size
+        [[nodiscard]] Scalar evaluated_weight() const;
+
+        // neurons the last evaluation on this thread had to recompute, all of them unless a drift tolerance is set
+        [[nodiscard]] blt::size_t get_recomputed_neurons() const
+        {
+            return evaluator.get_recomputed_neurons();
+        }
+
+        // changes every time the codebook does
+        [[nodiscard]] blt::size_t get_codebook_version() const
+        {
+            return codebook_version;
+        }
+
+        // the stream the SOM trains from, nullptr when it trains from its file
+        [[nodiscard]] data_stream_t* get_stream() const
+        {
+            return stream;
+        }
+
+        // the padded dataset the SOM trains from, nullptr when it trains from its file
+        [[nodiscard]] const padded_dataset_t* get_padded() const
+        {
+            return padded;
+        }
+
+    private:
+        // moves the map towards one sample, either its bins or a padded_view_t
+        template <typename Sample>
+        void train_sample(const Sample& sample, Scalar eta, Scalar time_ratio);
+
+        template <typename Sample>
+        blt::size_t find_closest_neuron(const Sample& sample);
+
+        void apply_activations(const std::vector<Scalar>& activations);
+
+        // codebook is the snapshot that was evaluated
+        void record_evaluation(blt::size_t epoch, const evaluation_t& evaluation, const std::vector<Scalar>& codebook);
+
+        void submit_evaluation(Scalar user_scale);
+
+        // records the evaluation in flight if it has finished, without waiting for it
+        void collect_evaluations();
+
+        void check_convergence();
+
+        [[nodiscard]] std::vector<Scalar> get_activations() const;
+
+        // drops the analysis caches if the codebook has changed since they were filled
+        void validate_analysis();
+
     private:
         array_t array;
         data_file_t file;
+        data_stream_t* stream = nullptr;
+        const padded_dataset_t* padded = nullptr;
+        std::optional<sparse_file_t> sparse_file;
         blt::size_t current_epoch = 0;
         blt::size_t max_epochs;
         distance_function_t* dist_func;
         topology_function_t* topology_function;
+        convergence_monitor_t* convergence_monitor = nullptr;
+        bmu_trace_t* trace = nullptr;
+        codebook_history_t* history = nullptr;
+        Scalar radius_scale = 1;
+        Scalar schedule_start = 0;
+        bool converged = false;
+        std::string stop_reason;
 
         // normalized value for which below this will be considered neural
         float quantization_distance = 0.25;
 
         std::vector<Scalar> topological_errors;
         std::vector<Scalar> quantization_errors;
+        std::vector<blt::size_t> error_epochs;
+        std::vector<error_interval_t> topological_intervals;
+        std::vector<error_interval_t> quantization_intervals;
+        std::vector<Scalar> codebook_movements;
+        std::vector<Scalar> previous_codebook;
+        std::vector<blt::size_t> order;
+        evaluator_t evaluator;
+
+        evaluation_schedule_t schedule;
+        bool async_evaluation = false;
+        std::optional<error_sampler_t> sampler;
+        Scalar last_scale = 0;
+        // only used by the evaluation in flight
+        evaluator_t async_evaluator;
+        std::shared_ptr<pending_task_t> pending_task;
+        std::shared_ptr<evaluation_t> pending_result;
+        std::shared_ptr<const std::vector<Scalar>> pending_snapshot;
+        blt::size_t pending_epoch = 0;
+
+        blt::size_t codebook_version = 0;
+        blt::size_t analysis_version = 0;
+        std::vector<Scalar> u_matrix;
+        // indexed by bin, empty until that plane is asked for
+        std::vector<std::vector<Scalar>> component_planes;
     };
 }
 
@@ -0,0 +1,95 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_SPARSE_H
+#define COSC_4P80_ASSIGNMENT_3_SPARSE_H
+
+#include <assign3/file.h>
+#include <vector>
+
+namespace assign3
+{
+    // a sample of a sparse_file_t, the kept bins in ascending order plus the squared norm of the whole sample (kept and dropped bins)
+    struct sparse_view_t
+    {
+        bool is_bad = false;
+        blt::span<const blt::u32> indices;
+        blt::span<const Scalar> values;
+        Scalar norm_squared = 0;
+    };
+
+    /**
+     * Top-k encoding of a data file: every sample keeps its k largest magnitude bins and the norm of the bins it drops. Most of the energy
+     * of a normalised high resolution spectrum sits in a few bins, so distances and updates against a dense codebook can look at k bins
+     * instead of all of them (see neuron_t::begin_sparse). Samples are stored as flat k wide rows.
+     */
+    class sparse_file_t
+    {
+        public:
+            sparse_file_t() = default;
+
+            // keeps min(k, bins) bins of every sample
+            static sparse_file_t encode(const data_file_t& file, blt::size_t k);
+
+            [[nodiscard]] sparse_view_t operator[](blt::size_t index) const;
+
+            // the sample with its dropped bins as zeros
+            [[nodiscard]] data_t decode(blt::size_t index) const;
+
+            // fraction of the sample's energy (squared norm) dropped by the encoding
+            [[nodiscard]] Scalar residual_ratio(blt::size_t index) const;
+
+            // (weighted) mean of residual_ratio over the file
+            [[nodiscard]] Scalar mean_residual_ratio() const;
+
+            [[nodiscard]] Scalar max_residual_ratio() const;
+
+            [[nodiscard]] Scalar weight(blt::size_t index) const
+            {
+                return weights.empty() ? 1 : weights[index];
+            }
+
+            [[nodiscard]] blt::size_t size() const
+            {
+                return labels.size();
+            }
+
+            [[nodiscard]] blt::size_t get_k() const
+            {
+                return k;
+            }
+
+            [[nodiscard]] blt::size_t get_bins() const
+            {
+                return bins;
+            }
+
+        private:
+            blt::size_t bins = 0;
+            blt::size_t k = 0;
+            // size() * k of each
+            std::vector<blt::u32> indices;
+            std::vector<Scalar> values;
+            std::vector<Scalar> norms_squared;
+            std::vector<Scalar> residuals_squared;
+            std::vector<blt::u8> labels;
+            std::vector<Scalar> weights;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_SPARSE_H
@@ -0,0 +1,35 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_SPECTRUM_H
+#define COSC_4P80_ASSIGNMENT_3_SPECTRUM_H
+
+#include <assign3/fwdecl.h>
+#include <vector>
+
+namespace assign3
+{
+    /**
+     * Resamples a magnitude spectrum to a different number of bins covering the same frequency range.
+     * Each bin is treated as a band of constant power, the power of every new bin is the power overlapping its band, so the
+     * total energy (and the L2 norm of normalized data) is kept whether bins are being split or merged.
+     */
+    std::vector<Scalar> resample_spectrum(const std::vector<Scalar>& bins, blt::size_t new_size);
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_SPECTRUM_H
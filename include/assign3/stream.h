@@ -0,0 +1,130 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_STREAM_H
+#define COSC_4P80_ASSIGNMENT_3_STREAM_H
+
+#include <assign3/binary_file.h>
+#include <array>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace assign3
+{
+    /**
+     * Reads a binary data file (see mapped_data_file_t) a chunk of samples at a time, for datasets too large to hold in memory.
+     * A pass reads its chunks on a background thread into two buffers: while one chunk is being consumed the next one is read into
+     * the other buffer, so at most two chunks are in memory and the disk is kept busy. Each chunk is one large sequential read.
+     * Shuffled passes visit the chunks in a random order, move every chunk boundary by a random offset each pass (so samples near a
+     * boundary don't always end up together) and shuffle the samples within each chunk.
+     */
+    class data_stream_t
+    {
+        public:
+            // nothing (with a warning) if path isn't a valid binary data file or has no data to train on
+            static std::unique_ptr<data_stream_t> open(const std::string& path, blt::size_t chunk_samples = 16384);
+
+            data_stream_t(const data_stream_t&) = delete;
+            data_stream_t& operator=(const data_stream_t&) = delete;
+
+            ~data_stream_t();
+
+            // starts a pass over every sample, ending the previous one if it is still running
+            void begin_pass(bool shuffle, blt::size_t seed = 0);
+
+            /**
+             * next chunk of the current pass, nullptr once every chunk has been handed out or a read failed.
+             * The chunk stays valid until the next call to next or begin_pass
+             */
+            const data_file_t* next();
+
+            // count random samples read straight from the file, for initialising a map or anything else that needs to look at the data up front
+            [[nodiscard]] data_file_t sample(blt::size_t count, blt::size_t seed) const;
+
+            [[nodiscard]] blt::size_t get_samples() const
+            {
+                return layout.samples;
+            }
+
+            [[nodiscard]] blt::size_t get_bins() const
+            {
+                return layout.bins;
+            }
+
+            [[nodiscard]] blt::size_t get_chunk_samples() const
+            {
+                return chunk_samples;
+            }
+
+            // bytes of sample data read by a full pass
+            [[nodiscard]] blt::size_t get_pass_bytes() const
+            {
+                return layout.samples * layout.row_stride;
+            }
+
+            [[nodiscard]] Scalar total_weight() const
+            {
+                return weight_total;
+            }
+
+            [[nodiscard]] const std::string& get_path() const
+            {
+                return path;
+            }
+
+        private:
+            data_stream_t() = default;
+
+            // ends the current pass, waiting for the reader thread
+            void end_pass();
+
+            void read_pass();
+
+            // reads count samples from first on into out, in shuffled order when shuffle_seed is set
+            bool read_chunk(std::ifstream& stream, blt::size_t first, blt::size_t count, const blt::size_t* shuffle_seed,
+                            std::vector<char>& staging, data_file_t& out) const;
+
+            std::string path;
+            binary_layout_t layout;
+            blt::size_t chunk_samples = 0;
+            Scalar weight_total = 0;
+
+            // state of the current pass, shared with the reader thread
+            std::thread reader;
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::array<data_file_t, 2> buffers;
+            // first sample and size of each chunk, in the order the pass visits them
+            std::vector<std::pair<blt::size_t, blt::size_t>> chunks;
+            bool shuffle = false;
+            blt::size_t seed = 0;
+            // chunks handed to the consumer and chunks fully read, chunk i lives in buffers[i % 2]
+            blt::size_t handed_out = 0;
+            blt::size_t loaded = 0;
+            bool stopping = false;
+            bool failed = false;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_STREAM_H
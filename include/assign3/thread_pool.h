@@ -0,0 +1,126 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_THREAD_POOL_H
+#define COSC_4P80_ASSIGNMENT_3_THREAD_POOL_H
+
+#include <blt/std/types.h>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace assign3
+{
+    /**
+     * handle to a single task handed to the pool with submit
+     */
+    class pending_task_t
+    {
+            friend class thread_pool_t;
+        public:
+            explicit pending_task_t(std::function<void()> task): task(std::move(task))
+            {}
+
+            /**
+             * blocks until the task has finished. If no worker has picked it up yet it is run on the calling thread instead, so waiting on a
+             * task from inside the pool (or on a pool without workers) can't deadlock
+             */
+            void wait();
+
+            [[nodiscard]] bool is_done() const
+            {
+                return done;
+            }
+
+        private:
+            // runs the task unless someone else already has
+            void try_run();
+
+            std::function<void()> task;
+            std::atomic<bool> claimed{false};
+            std::atomic<bool> done{false};
+            std::mutex mutex;
+            std::condition_variable cv;
+    };
+
+    /**
+     * Fixed set of worker threads shared by everything that wants to run in parallel. Callers of run / parallel_for take work themselves
+     * while they wait, so nesting them (a task started by run evaluating a SOM with parallel_for) can't deadlock: if every worker is busy
+     * the caller just does all of the work on its own.
+     */
+    class thread_pool_t
+    {
+        public:
+            explicit thread_pool_t(blt::size_t workers);
+
+            thread_pool_t(const thread_pool_t&) = delete;
+            thread_pool_t& operator=(const thread_pool_t&) = delete;
+
+            ~thread_pool_t();
+
+            /**
+             * queues task to run in the background
+             */
+            std::shared_ptr<pending_task_t> submit(std::function<void()> task);
+
+            /**
+             * queues task only if a worker is free to pick it up right away, otherwise returns nullptr and leaves running it to the caller.
+             * Work queued behind busy workers only runs once whoever waits on it gives up and runs it inline, so it never overlaps anything
+             */
+            std::shared_ptr<pending_task_t> try_submit(std::function<void()> task);
+
+            /**
+             * runs task(i) for every i in [0, count) and returns once all of them have finished
+             */
+            void run(blt::size_t count, const std::function<void(blt::size_t)>& task);
+
+            /**
+             * splits [0, count) into chunks of grain indices and runs func(begin, end) on each. Chunk boundaries only depend on count and grain,
+             * never on the number of threads, so anything written per index comes out the same no matter how the chunks were scheduled
+             */
+            void parallel_for(blt::size_t count, blt::size_t grain, const std::function<void(blt::size_t, blt::size_t)>& func);
+
+            // number of threads that work on a run, including the calling thread
+            [[nodiscard]] blt::size_t concurrency() const
+            {
+                return workers.size() + 1;
+            }
+
+            // pool used by the GUI, the test actions and SOM evaluation
+            static thread_pool_t& shared();
+
+        private:
+            void worker_loop();
+
+            std::vector<std::thread> workers;
+            std::deque<std::function<void()>> queue;
+            std::mutex queue_mutex;
+            std::condition_variable queue_cv;
+            // workers waiting on queue_cv, guarded by queue_mutex. run only queues helpers for these, a helper queued while every worker
+            // is busy would just sit in the queue until long after its run has returned
+            blt::size_t idle = 0;
+            bool stopping = false;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_THREAD_POOL_H
@@ -0,0 +1,131 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_TRACE_H
+#define COSC_4P80_ASSIGNMENT_3_TRACE_H
+
+#include <assign3/array.h>
+#include <assign3/evaluator.h>
+#include <assign3/file.h>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+namespace assign3
+{
+    /**
+     * Compact record of a training run, enough to recompute BMU based metrics of every evaluated epoch without retraining.
+     * Each frame holds the best and second best matching unit of every sample, bit packed with just enough bits for the number of neurons.
+     * Keyframes store every sample, the frames between them only store the samples whose BMUs changed since the previous frame (plus one bit
+     * per sample saying which ones those are). Full codebooks and activations are kept every checkpoint_interval epochs.
+     */
+    class bmu_trace_t
+    {
+        public:
+            struct checkpoint_t
+            {
+                blt::size_t epoch;
+                std::vector<Scalar> codebook;
+                std::vector<Scalar> activations;
+            };
+
+            explicit bmu_trace_t(blt::size_t checkpoint_interval = 100, blt::size_t keyframe_interval = 50);
+
+            // resets the trace for a new run over file on the lattice of array, called by som_t when the trace is attached
+            void begin(const data_file_t& file, const array_t& array, const evaluator_t& evaluator);
+
+            void record(blt::size_t epoch, const std::vector<blt::size_t>& first, const std::vector<blt::size_t>& second,
+                        const std::vector<Scalar>& codebook, const std::vector<Scalar>& activations);
+
+            void decode(blt::size_t frame, std::vector<blt::size_t>& first, std::vector<blt::size_t>& second) const;
+
+            // weighted fraction of samples whose two BMUs are not lattice neighbours
+            [[nodiscard]] Scalar topological_error(blt::size_t frame) const;
+
+            // weighted number of samples mapped to each neuron
+            [[nodiscard]] std::vector<Scalar> hit_map(blt::size_t frame) const;
+
+            // weighted fraction of samples which share a class with the majority of the samples mapped to the same neuron
+            [[nodiscard]] Scalar class_purity(blt::size_t frame) const;
+
+            // latest checkpoint at or before epoch, nullptr if there is none
+            [[nodiscard]] const checkpoint_t* checkpoint_at(blt::size_t epoch) const;
+
+            [[nodiscard]] blt::size_t frame_count() const
+            {
+                return frames.size();
+            }
+
+            [[nodiscard]] blt::size_t epoch_of(blt::size_t frame) const
+            {
+                return frames[frame].epoch;
+            }
+
+            [[nodiscard]] blt::size_t get_width() const
+            {
+                return width;
+            }
+
+            [[nodiscard]] blt::size_t get_height() const
+            {
+                return height;
+            }
+
+            // bytes used by the frames and checkpoints
+            [[nodiscard]] blt::size_t memory_usage() const;
+
+            void write(std::ostream& out) const;
+
+            // nothing if the stream doesn't hold a complete trace
+            static std::optional<bmu_trace_t> read(std::istream& in);
+
+        private:
+            struct frame_t
+            {
+                blt::size_t epoch = 0;
+                bool keyframe = false;
+                std::vector<blt::u64> bits;
+            };
+
+            // sizes read from a file line up with each other, so decoding can't read past a frame
+            [[nodiscard]] bool is_consistent() const;
+
+            [[nodiscard]] bool are_neighbours(blt::size_t a, blt::size_t b) const
+            {
+                return (adjacency[(a * neurons + b) / 64] >> ((a * neurons + b) % 64)) & 1;
+            }
+
+            blt::size_t checkpoint_interval;
+            blt::size_t keyframe_interval;
+
+            blt::size_t width = 0, height = 0;
+            blt::size_t neurons = 0;
+            blt::size_t index_bits = 1;
+            // one bit per neuron pair
+            std::vector<blt::u64> adjacency;
+            std::vector<bool> labels;
+            std::vector<Scalar> weights;
+
+            std::vector<frame_t> frames;
+            std::vector<checkpoint_t> checkpoints;
+            std::vector<blt::size_t> last_first, last_second;
+    };
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_TRACE_H
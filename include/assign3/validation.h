@@ -0,0 +1,50 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COSC_4P80_ASSIGNMENT_3_VALIDATION_H
+#define COSC_4P80_ASSIGNMENT_3_VALIDATION_H
+
+#include <assign3/file.h>
+#include <vector>
+
+namespace assign3
+{
+    struct fold_result_t
+    {
+        blt::size_t training_samples = 0;
+        blt::size_t held_out_samples = 0;
+        // (weighted) held out samples misclassified by the activations of the map trained without them
+        Scalar quantization_error = 0;
+        // as a fraction of the held out weight
+        Scalar quantization_rate = 0;
+        Scalar topological_error = 0;
+        double seconds = 0;
+    };
+
+    /**
+     * Stratified k-fold cross validation of a SOM configuration. The file is split into folds with dataset_partitioner, which copies the
+     * data once, and each fold's training set shares the storage of the other folds so memory doesn't grow with the number of folds.
+     * One map per fold is trained concurrently on the shared thread pool, each for epochs epochs and evaluated only at the end, and then
+     * scored on the fold it never saw. With every worker training a fold, the evaluations inside each fold run inline on its own thread
+     * instead of queueing work for the pool.
+     */
+    std::vector<fold_result_t> cross_validate(const data_file_t& file, blt::size_t folds, blt::size_t seed, blt::size_t width, blt::size_t height,
+                                              blt::size_t epochs, shape_t shape, init_t init, Scalar initial_learn_rate = 1);
+}
+
+#endif //COSC_4P80_ASSIGNMENT_3_VALIDATION_H
@@ -15,6 +15,13 @@ else:
     subtitle1 = ""
     subtitle2 = ""
 
+# optional lower,upper confidence bounds for each error, drawn as a band
+interval1 = None
+interval2 = None
+if len(sys.argv) > 8:
+    interval1 = pd.read_csv(sys.argv[7]).to_numpy()
+    interval2 = pd.read_csv(sys.argv[8]).to_numpy()
+
 df1 = pd.read_csv(file1)
 df2 = pd.read_csv(file2)
 
@@ -28,6 +35,8 @@ if split.lower() == "false":
     fig, ax1 = plt.subplots()
 
     ax1.plot(data1, color='b', label='Topological Error')
+    if interval1 is not None:
+        ax1.fill_between(np.arange(len(interval1)), interval1[:, 0], interval1[:, 1], color='b', alpha=0.2)
     ax1.set_xlabel('Epoch')
     ax1.set_ylabel('Error %', color='b')
     ax1.tick_params(axis='y', labelcolor='b')
@@ -37,6 +46,8 @@ if split.lower() == "false":
     ax2 = ax1.twinx()
 
     ax2.plot(data2, color='r', label='Quantization Error')
+    if interval2 is not None:
+        ax2.fill_between(np.arange(len(interval2)), interval2[:, 0], interval2[:, 1], color='r', alpha=0.2)
     ax2.set_ylabel('Incorrect BMU', color='r')
     ax2.tick_params(axis='y', labelcolor='r')
     ax2.set_ylim(y_min, y_max)
@@ -47,6 +58,8 @@ if split.lower() == "false":
     plt.savefig("errors{}.png".format(bins))
 else:
     plt.plot(data1, color='b', label='Topological Error')
+    if interval1 is not None:
+        plt.fill_between(np.arange(len(interval1)), interval1[:, 0], interval1[:, 1], color='b', alpha=0.2)
     plt.xlabel('Epoch')
     plt.ylabel('Error %', color='b')
     plt.tick_params(axis='y', labelcolor='b')
@@ -58,6 +71,8 @@ else:
     plt.savefig("errors-topological{}.png".format(bins))
     
     plt.plot(data2, color='b', label='Quantization Error')
+    if interval2 is not None:
+        plt.fill_between(np.arange(len(interval2)), interval2[:, 0], interval2[:, 1], color='b', alpha=0.2)
     plt.xlabel('Epoch')
     plt.ylabel('Incorrect BMU', color='b')
     plt.tick_params(axis='y', labelcolor='b')
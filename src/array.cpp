@@ -17,9 +17,82 @@
  */
 #include <assign3/array.h>
 #include <cmath>
+#include <algorithm>
 
 namespace assign3
 {
+    static blt::i64 wrap_index(const blt::i64 v, const blt::i64 size)
+    {
+        return ((v % size) + size) % size;
+    }
+
+    void array_t::sample_row(const blt::i64 y, const Scalar x, const Scalar weight, std::vector<Scalar>& out) const
+    {
+        if (weight == 0)
+            return;
+        // odd honey comb rows are shifted half a cell, undo that to get back to a column index
+        const auto column = is_offset() && y % 2 != 0 ? x - 0.5f : x;
+        auto x0 = static_cast<blt::i64>(std::floor(column));
+        const auto fx = column - static_cast<Scalar>(x0);
+        auto x1 = x0 + 1;
+        if (is_wrapped())
+        {
+            x0 = wrap_index(x0, width);
+            x1 = wrap_index(x1, width);
+        } else
+        {
+            x0 = std::clamp(x0, static_cast<blt::i64>(0), width - 1);
+            x1 = std::clamp(x1, static_cast<blt::i64>(0), width - 1);
+        }
+
+        const auto& a = get(x0, y).get_data();
+        const auto& b = get(x1, y).get_data();
+        for (blt::size_t i = 0; i < out.size(); i++)
+            out[i] += weight * ((1 - fx) * a[i] + fx * b[i]);
+    }
+
+    array_t array_t::resized(const blt::size_t new_width, const blt::size_t new_height) const
+    {
+        const auto dimensions = map.front().get_data().size();
+        array_t grown{dimensions, new_width, new_height, shape};
+
+        // wrapped lattices are periodic so cells map by the ratio of the sizes, otherwise the corners of both lattices line up
+        const auto scale = [this](const blt::i64 old_size, const blt::size_t new_size) {
+            if (is_wrapped())
+                return static_cast<Scalar>(old_size) / static_cast<Scalar>(new_size);
+            return new_size > 1 ? static_cast<Scalar>(old_size - 1) / static_cast<Scalar>(new_size - 1) : 0.0f;
+        };
+        const auto scale_x = scale(width, new_width);
+        const auto scale_y = scale(height, new_height);
+
+        std::vector<Scalar> data(dimensions);
+        for (auto& n : grown.map)
+        {
+            std::fill(data.begin(), data.end(), 0);
+            const auto x = n.get_x() * scale_x;
+            const auto y = n.get_y() * scale_y;
+
+            auto y0 = static_cast<blt::i64>(std::floor(y));
+            const auto fy = y - static_cast<Scalar>(y0);
+            auto y1 = y0 + 1;
+            if (is_wrapped())
+            {
+                y0 = wrap_index(y0, height);
+                y1 = wrap_index(y1, height);
+            } else
+            {
+                y0 = std::clamp(y0, static_cast<blt::i64>(0), height - 1);
+                y1 = std::clamp(y1, static_cast<blt::i64>(0), height - 1);
+            }
+
+            sample_row(y0, x, 1 - fy, data);
+            sample_row(y1, x, fy, data);
+            n.set_data(data);
+        }
+
+        return grown;
+    }
+    
     
     blt::i64 array_t::wrap_height(blt::i64 y) const
     {
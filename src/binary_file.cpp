@@ -0,0 +1,357 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/binary_file.h>
+#include <blt/std/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+#if defined(__linux__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define ASSIGN3_HAS_MMAP
+#endif
+
+namespace assign3
+{
+    struct binary_header_t
+    {
+        char magic[4];
+        blt::u32 version;
+        blt::u64 samples;
+        blt::u64 bins;
+        blt::u32 precision;
+        // bit 0 is set when the file holds weights
+        blt::u32 flags;
+        blt::u64 row_stride;
+        blt::u64 labels_offset;
+        blt::u64 weights_offset;
+        blt::u64 matrix_offset;
+    };
+
+    static_assert(sizeof(binary_header_t) == binary_header_size);
+
+    static constexpr char binary_magic[4] = {'S', 'O', 'M', 'D'};
+    static constexpr blt::u32 binary_version = 1;
+    static constexpr blt::size_t binary_alignment = 64;
+
+    static blt::size_t align_to(const blt::size_t value, const blt::size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // false when a * b doesn't fit in a u64, the header sizes come straight from the file
+    static bool checked_multiply(const blt::u64 a, const blt::u64 b, blt::u64& result)
+    {
+        if (a != 0 && b > std::numeric_limits<blt::u64>::max() / a)
+            return false;
+        result = a * b;
+        return true;
+    }
+
+    std::optional<binary_layout_t> read_binary_layout(const char* header_bytes, const blt::size_t file_size, const std::string& path)
+    {
+        binary_header_t header{};
+        std::memcpy(&header, header_bytes, sizeof(header));
+        const auto label_words = header.samples / 64 + (header.samples % 64 != 0);
+        const auto weighted = (header.flags & 1) != 0;
+        const auto fits = [file_size](const blt::u64 offset, const blt::u64 size) {
+            return offset <= file_size && size <= file_size - offset;
+        };
+        if (std::memcmp(header.magic, binary_magic, sizeof(binary_magic)) != 0 || header.version != binary_version)
+        {
+            BLT_WARN("'%s' is not a binary data file (or is from a different version)", path.c_str());
+            return {};
+        }
+        blt::u64 row_size = 0, labels_size = 0, weights_size = 0, matrix_size = 0;
+        const auto sizes_fit = checked_multiply(header.bins, header.precision, row_size) &&
+                               checked_multiply(label_words, sizeof(blt::u64), labels_size) &&
+                               checked_multiply(header.samples, sizeof(float), weights_size) &&
+                               checked_multiply(header.samples, header.row_stride, matrix_size);
+        if (!sizes_fit || (header.precision != sizeof(float) && header.precision != sizeof(double)) || header.row_stride < row_size ||
+            header.matrix_offset % binary_alignment != 0 || header.labels_offset % alignof(blt::u64) != 0 ||
+            header.weights_offset % alignof(float) != 0 || !fits(header.labels_offset, labels_size) ||
+            (weighted && !fits(header.weights_offset, weights_size)) || !fits(header.matrix_offset, matrix_size))
+        {
+            BLT_WARN("Binary data file '%s' is truncated or has a corrupt header", path.c_str());
+            return {};
+        }
+
+        binary_layout_t layout;
+        layout.samples = header.samples;
+        layout.bins = header.bins;
+        layout.precision = header.precision;
+        layout.row_stride = header.row_stride;
+        layout.weighted = weighted;
+        layout.labels_offset = header.labels_offset;
+        layout.weights_offset = header.weights_offset;
+        layout.matrix_offset = header.matrix_offset;
+        return layout;
+    }
+
+    std::optional<mapped_data_file_t> mapped_data_file_t::open(const std::string& path)
+    {
+        mapped_data_file_t file;
+#ifdef ASSIGN3_HAS_MMAP
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            BLT_WARN("Unable to open binary data file '%s'", path.c_str());
+            return {};
+        }
+        struct stat info{};
+        if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(binary_header_t)))
+        {
+            ::close(fd);
+            BLT_WARN("Binary data file '%s' is too small to hold a header", path.c_str());
+            return {};
+        }
+        auto* memory = mmap(nullptr, static_cast<blt::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps the file alive on its own
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+            BLT_WARN("Unable to map binary data file '%s'", path.c_str());
+            return {};
+        }
+        file.memory = static_cast<const char*>(memory);
+        file.memory_size = static_cast<blt::size_t>(info.st_size);
+        file.mapped = true;
+#else
+        std::ifstream stream{path, std::ios::binary | std::ios::ate};
+        if (!stream)
+        {
+            BLT_WARN("Unable to open binary data file '%s'", path.c_str());
+            return {};
+        }
+        file.memory_size = static_cast<blt::size_t>(stream.tellg());
+        if (file.memory_size < sizeof(binary_header_t))
+        {
+            BLT_WARN("Binary data file '%s' is too small to hold a header", path.c_str());
+            return {};
+        }
+        auto* memory = static_cast<char*>(::operator new[](file.memory_size, std::align_val_t{binary_alignment}));
+        file.memory = memory;
+        stream.seekg(0);
+        if (!stream.read(memory, static_cast<std::streamsize>(file.memory_size)))
+        {
+            BLT_WARN("Unable to read binary data file '%s'", path.c_str());
+            return {};
+        }
+#endif
+
+        const auto layout = read_binary_layout(file.memory, file.memory_size, path);
+        if (!layout)
+            return {};
+
+        file.samples = layout->samples;
+        file.bins = layout->bins;
+        file.precision = layout->precision;
+        file.row_stride = layout->row_stride;
+        file.labels = reinterpret_cast<const blt::u64*>(file.memory + layout->labels_offset);
+        file.weights = layout->weighted ? reinterpret_cast<const float*>(file.memory + layout->weights_offset) : nullptr;
+        file.matrix = file.memory + layout->matrix_offset;
+        return file;
+    }
+
+    bool mapped_data_file_t::write(const std::string& path, const data_file_t& file, const blt::size_t precision)
+    {
+        const auto samples = file.data_points.size();
+        std::vector<blt::u64> labels((samples + 63) / 64);
+        for (blt::size_t i = 0; i < samples; i++)
+        {
+            if (file.data_points[i].is_bad)
+                labels[i / 64] |= static_cast<blt::u64>(1) << (i % 64);
+        }
+
+        binary_data_writer_t writer{path, samples, file.data_points.bin_count(), labels, file.weights, precision};
+        writer.write(file);
+        return writer.finish();
+    }
+
+    binary_data_writer_t::binary_data_writer_t(const std::string& path, const blt::size_t samples, const blt::size_t bins,
+                                               const std::vector<blt::u64>& labels, const std::vector<Scalar>& weights,
+                                               const blt::size_t precision): path(path), samples(samples), bins(bins), precision(precision)
+    {
+        if (precision != sizeof(float) && precision != sizeof(double))
+        {
+            BLT_WARN("Binary data files hold float or double bins, not %ld byte values", precision);
+            return;
+        }
+
+        const auto label_words = (samples + 63) / 64;
+        const auto weighted = !weights.empty();
+        binary_header_t header{};
+        std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+        header.version = binary_version;
+        header.samples = samples;
+        header.bins = bins;
+        header.precision = static_cast<blt::u32>(precision);
+        header.flags = weighted ? 1 : 0;
+        header.row_stride = align_to(bins * precision, binary_alignment);
+        header.labels_offset = sizeof(binary_header_t);
+        const auto after_labels = header.labels_offset + label_words * sizeof(blt::u64);
+        header.weights_offset = weighted ? after_labels : 0;
+        header.matrix_offset = align_to(weighted ? after_labels + samples * sizeof(float) : after_labels, binary_alignment);
+
+        out.open(path, std::ios::binary);
+        if (!out)
+        {
+            BLT_WARN("Unable to open '%s' for writing", path.c_str());
+            return;
+        }
+        blt::size_t written = 0;
+        const auto write = [this, &written](const void* data, const blt::size_t size) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            written += size;
+        };
+
+        std::vector<blt::u64> stored_labels(labels.begin(), labels.end());
+        stored_labels.resize(label_words);
+        write(&header, sizeof(header));
+        write(stored_labels.data(), stored_labels.size() * sizeof(blt::u64));
+        if (weighted)
+        {
+            std::vector<float> stored_weights(weights.begin(), weights.end());
+            stored_weights.resize(samples, 1);
+            write(stored_weights.data(), stored_weights.size() * sizeof(float));
+        }
+        static constexpr char zeros[binary_alignment] = {};
+        while (written < header.matrix_offset)
+            write(zeros, std::min(header.matrix_offset - written, binary_alignment));
+
+        row.resize(header.row_stride);
+        good = static_cast<bool>(out);
+    }
+
+    bool binary_data_writer_t::write(const data_file_t& block)
+    {
+        if (!good)
+            return false;
+        if (!block.data_points.empty() && block.data_points.bin_count() != bins)
+        {
+            BLT_WARN("Every sample of a binary data file must have the same number of bins, unable to write '%s'", path.c_str());
+            good = false;
+            return false;
+        }
+        if (written_samples + block.data_points.size() > samples)
+        {
+            BLT_WARN("More samples were written to '%s' than its header has room for", path.c_str());
+            good = false;
+            return false;
+        }
+
+        for (const auto point : block.data_points)
+        {
+            for (blt::size_t i = 0; i < bins; i++)
+            {
+                if (precision == sizeof(float))
+                {
+                    const auto value = static_cast<float>(point.bins[i]);
+                    std::memcpy(row.data() + i * precision, &value, precision);
+                } else
+                {
+                    const auto value = static_cast<double>(point.bins[i]);
+                    std::memcpy(row.data() + i * precision, &value, precision);
+                }
+            }
+            out.write(row.data(), static_cast<std::streamsize>(row.size()));
+        }
+        written_samples += block.data_points.size();
+        good = static_cast<bool>(out);
+        return good;
+    }
+
+    bool binary_data_writer_t::finish()
+    {
+        if (good && written_samples != samples)
+        {
+            BLT_WARN("Only %ld of the %ld samples of '%s' were written", written_samples, samples, path.c_str());
+            good = false;
+        }
+        if (out.is_open())
+            out.close();
+        return good && !out.fail();
+    }
+
+    mapped_data_file_t::mapped_data_file_t(mapped_data_file_t&& move) noexcept
+    {
+        *this = std::move(move);
+    }
+
+    mapped_data_file_t& mapped_data_file_t::operator=(mapped_data_file_t&& move) noexcept
+    {
+        if (this == &move)
+            return *this;
+        release();
+        memory = std::exchange(move.memory, nullptr);
+        memory_size = std::exchange(move.memory_size, 0);
+        mapped = std::exchange(move.mapped, false);
+        samples = move.samples;
+        bins = move.bins;
+        precision = move.precision;
+        row_stride = move.row_stride;
+        labels = move.labels;
+        weights = move.weights;
+        matrix = move.matrix;
+        return *this;
+    }
+
+    mapped_data_file_t::~mapped_data_file_t()
+    {
+        release();
+    }
+
+    void mapped_data_file_t::release()
+    {
+        if (memory == nullptr)
+            return;
+#ifdef ASSIGN3_HAS_MMAP
+        if (mapped)
+            munmap(const_cast<char*>(memory), memory_size);
+#else
+        ::operator delete[](const_cast<char*>(memory), std::align_val_t{binary_alignment});
+#endif
+        memory = nullptr;
+    }
+
+    data_file_t mapped_data_file_t::to_data_file() const
+    {
+        data_file_t file;
+        file.data_points.reserve(samples, bins);
+        for (blt::size_t i = 0; i < samples; i++)
+        {
+            auto point = file.data_points.emplace_back(bins, is_bad(i));
+            if (precision == sizeof(Scalar))
+                std::copy(row(i), row(i) + bins, point.begin());
+            else
+            {
+                const auto* values = reinterpret_cast<const double*>(matrix + i * row_stride);
+                std::transform(values, values + bins, point.begin(), [](const double v) { return static_cast<Scalar>(v); });
+            }
+        }
+        if (weights != nullptr)
+            file.weights.assign(weights, weights + samples);
+        return file;
+    }
+}
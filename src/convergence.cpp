@@ -0,0 +1,77 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/convergence.h>
+#include <assign3/som.h>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+namespace assign3
+{
+    // the error curves are noisy (a single sample flipping moves the topological error by 1/N) so a plateau is measured
+    // as the change in mean between the two halves of the window rather than the raw range
+    static Scalar trend_of(const std::vector<Scalar>& values, const blt::size_t window)
+    {
+        const auto half = static_cast<blt::ptrdiff_t>(window / 2);
+        const auto mid = values.end() - half;
+        const auto first = std::accumulate(mid - half, mid, static_cast<Scalar>(0));
+        const auto second = std::accumulate(mid, values.end(), static_cast<Scalar>(0));
+        return std::abs(second - first) / static_cast<Scalar>(half);
+    }
+
+    std::optional<std::string> plateau_monitor_t::should_stop(const som_t& som) const
+    {
+        const auto& topological = som.get_topological_errors();
+        const auto& quantization = som.get_quantization_errors();
+        if (window < 2 || topological.size() < window || quantization.size() < window)
+            return {};
+
+        const auto topological_trend = trend_of(topological, window);
+        const auto weight = som.evaluated_weight();
+        const auto quantization_trend = trend_of(quantization, window) / (weight > 0 ? weight : 1);
+
+        if (topological_trend <= tolerance && quantization_trend <= tolerance)
+            return "errors plateaued over " + std::to_string(window) + " epochs (topological change " + std::to_string(topological_trend) +
+                   ", quantization change " + std::to_string(quantization_trend) + ")";
+        return {};
+    }
+
+    std::optional<std::string> codebook_movement_monitor_t::should_stop(const som_t& som) const
+    {
+        const auto& movements = som.get_codebook_movements();
+        // nothing to look at, all_of over no epochs would stop every run straight away
+        if (patience == 0 || movements.size() < patience)
+            return {};
+
+        if (std::all_of(movements.end() - static_cast<blt::ptrdiff_t>(patience), movements.end(), [this](const Scalar v) {
+            return v < threshold;
+        }))
+            return "codebook moved less than " + std::to_string(threshold) + " for " + std::to_string(patience) + " epochs";
+        return {};
+    }
+
+    std::optional<std::string> any_convergence_monitor_t::should_stop(const som_t& som) const
+    {
+        for (const auto& monitor : monitors)
+        {
+            if (auto reason = monitor->should_stop(som))
+                return reason;
+        }
+        return {};
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/coreset.h>
+#include <blt/std/random.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+
+namespace assign3
+{
+    static Scalar distance_squared(const blt::span<const Scalar> a, const blt::span<const Scalar> b)
+    {
+        Scalar total = 0;
+        for (blt::size_t i = 0; i < a.size(); i++)
+        {
+            const auto d = a[i] - b[i];
+            total += d * d;
+        }
+        return total;
+    }
+
+    static void compress_class(const data_file_t& file, const std::vector<blt::size_t>& members, const blt::size_t size,
+                               blt::random::random_t& rand, data_file_t& out)
+    {
+        if (members.empty() || size == 0)
+            return;
+
+        // k-means++ seeding, weighted by the existing sample weights so compressing a coreset again behaves
+        std::vector<blt::size_t> centers;
+        std::vector<Scalar> closest(members.size(), std::numeric_limits<Scalar>::max());
+        std::vector<blt::size_t> assignment(members.size(), 0);
+
+        centers.push_back(members[std::uniform_int_distribution<blt::size_t>{0, members.size() - 1}(rand)]);
+        while (true)
+        {
+            Scalar total = 0;
+            for (blt::size_t i = 0; i < members.size(); i++)
+            {
+                const auto d = distance_squared(file.data_points[members[i]].bins, file.data_points[centers.back()].bins);
+                if (d < closest[i])
+                {
+                    closest[i] = d;
+                    assignment[i] = centers.size() - 1;
+                }
+                total += closest[i] * file.weight(members[i]);
+            }
+
+            if (centers.size() >= size || total <= 0)
+                break;
+
+            auto target = rand.get_double(0, total);
+            blt::size_t picked = members.size() - 1;
+            for (blt::size_t i = 0; i < members.size(); i++)
+            {
+                target -= closest[i] * file.weight(members[i]);
+                if (target <= 0)
+                {
+                    picked = i;
+                    break;
+                }
+            }
+            centers.push_back(members[picked]);
+        }
+
+        // one lloyd step, each representative becomes the weighted mean of the samples closest to it
+        const auto bins = file.data_points[members.front()].bins.size();
+        const auto bad = file.data_points[members.front()].is_bad;
+        std::vector<data_t> means(centers.size(), data_t{bad, std::vector<Scalar>(bins)});
+        std::vector<Scalar> weights(centers.size());
+        for (blt::size_t i = 0; i < members.size(); i++)
+        {
+            const auto w = file.weight(members[i]);
+            const auto point = file.data_points[members[i]].bins;
+            auto& mean = means[assignment[i]].bins;
+            for (blt::size_t j = 0; j < bins; j++)
+                mean[j] += point[j] * w;
+            weights[assignment[i]] += w;
+        }
+
+        for (blt::size_t c = 0; c < centers.size(); c++)
+        {
+            if (weights[c] <= 0)
+                continue;
+            for (auto& v : means[c].bins)
+                v /= weights[c];
+            out.data_points.push_back(means[c]);
+            out.weights.push_back(weights[c]);
+        }
+    }
+
+    data_file_t build_coreset(const data_file_t& file, const blt::size_t size, const blt::size_t seed)
+    {
+        std::vector<blt::size_t> good, bad;
+        for (blt::size_t i = 0; i < file.data_points.size(); i++)
+        {
+            if (file.data_points[i].is_bad)
+                bad.push_back(i);
+            else
+                good.push_back(i);
+        }
+
+        // stratify, both classes keep at least one representative as long as they have any samples and size leaves room for both
+        auto bad_size = static_cast<blt::size_t>(static_cast<double>(size) * static_cast<double>(bad.size()) /
+                                                 static_cast<double>(std::max(file.data_points.size(), static_cast<blt::size_t>(1))));
+        if (!bad.empty() && !good.empty() && size >= 2)
+            bad_size = std::clamp(bad_size, static_cast<blt::size_t>(1), size - 1);
+        bad_size = std::min(bad_size, bad.size());
+        const auto good_size = std::min(size - bad_size, good.size());
+
+        blt::random::random_t rand{seed};
+        data_file_t coreset;
+        compress_class(file, good, good_size, rand, coreset);
+        compress_class(file, bad, bad_size, rand, coreset);
+        return coreset;
+    }
+}
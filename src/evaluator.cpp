@@ -0,0 +1,714 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/evaluator.h>
+#include <assign3/thread_pool.h>
+#include <blt/iterator/enumerate.h>
+#include <blt/std/string.h>
+#include <blt/std/random.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace assign3
+{
+    // inverse of the standard normal CDF by bisection, only used for a handful of confidence levels
+    static double normal_quantile(const double p)
+    {
+        double low = -10, high = 10;
+        for (int i = 0; i < 100; i++)
+        {
+            const auto mid = (low + high) / 2;
+            if (0.5 * std::erfc(-mid / std::sqrt(2.0)) < p)
+                low = mid;
+            else
+                high = mid;
+        }
+        return (low + high) / 2;
+    }
+
+    // rows of work per chunk so each chunk does at least a few thousand operations, small maps aren't worth waking other threads for
+    static blt::size_t grain_for(const blt::size_t work_per_index)
+    {
+        constexpr blt::size_t min_chunk_work = 16384;
+        return std::max(min_chunk_work / std::max(work_per_index, static_cast<blt::size_t>(1)), static_cast<blt::size_t>(1));
+    }
+
+    evaluation_schedule_t evaluation_schedule_t::every(const blt::size_t epochs)
+    {
+        evaluation_schedule_t schedule;
+        schedule.type = type_t::EVERY;
+        schedule.interval = std::max(epochs, static_cast<blt::size_t>(1));
+        return schedule;
+    }
+
+    evaluation_schedule_t evaluation_schedule_t::geometric(const Scalar ratio)
+    {
+        evaluation_schedule_t schedule;
+        schedule.type = type_t::GEOMETRIC;
+        schedule.ratio = std::max(ratio, static_cast<Scalar>(1.01));
+        return schedule;
+    }
+
+    evaluation_schedule_t evaluation_schedule_t::final_only()
+    {
+        evaluation_schedule_t schedule;
+        schedule.type = type_t::FINAL;
+        return schedule;
+    }
+
+    evaluation_schedule_t evaluation_schedule_t::parse(const std::string& str)
+    {
+        const auto split = str.find(':');
+        const auto name = blt::string::toLowerCase(str.substr(0, split));
+        const auto value = split == std::string::npos ? std::string{} : str.substr(split + 1);
+        if (name == "final")
+            return final_only();
+        if (name == "geometric")
+            return geometric(value.empty() ? 2 : std::stof(value));
+        if (name == "every")
+            return every(value.empty() ? 1 : std::stoul(value));
+        return every(std::stoul(str));
+    }
+
+    bool evaluation_schedule_t::should_evaluate(const blt::size_t epoch, const blt::size_t max_epochs) const
+    {
+        if (epoch >= max_epochs)
+            return true;
+        switch (type)
+        {
+            case type_t::EVERY:
+                return epoch % interval == 0;
+            case type_t::GEOMETRIC:
+            {
+                // evaluated epochs are the distinct values of floor(ratio^k)
+                double value = 1;
+                while (static_cast<blt::size_t>(value) < epoch)
+                    value *= ratio;
+                return static_cast<blt::size_t>(value) == epoch;
+            }
+            case type_t::FINAL:
+                return false;
+        }
+        return true;
+    }
+
+    void evaluator_t::set_lattice(const array_t& array, distance_function_t* dist_func)
+    {
+        const auto& map = array.get_map();
+        neurons = map.size();
+        lattice_width = array.get_width();
+        lattice_height = array.get_height();
+        lattice_shape = array.get_shape();
+        // anything kept for incremental matching belongs to the old lattice
+        matched_codebook.clear();
+        raw_activations.clear();
+        lattice_distances.resize(neurons * neurons);
+        neighbour_distances.assign(neurons, std::numeric_limits<Scalar>::max());
+        for (const auto& [i, a] : blt::enumerate(map))
+        {
+            for (const auto& [j, b] : blt::enumerate(map))
+            {
+                const auto d = neuron_t::distance(dist_func, a, b);
+                lattice_distances[i * neurons + j] = d;
+                if (i != j)
+                    neighbour_distances[i] = std::min(neighbour_distances[i], d);
+            }
+        }
+    }
+
+    std::vector<Scalar> evaluator_t::snapshot(const array_t& array)
+    {
+        std::vector<Scalar> codebook;
+        for (const auto& n : array.get_map())
+            codebook.insert(codebook.end(), n.get_data().begin(), n.get_data().end());
+        return codebook;
+    }
+
+    bool evaluator_t::are_neighbours(const blt::size_t a, const blt::size_t b) const
+    {
+        return blt::f_equal(lattice_distances[a * neurons + b], neighbour_distances[a]);
+    }
+
+    std::vector<Scalar> evaluator_t::u_matrix(const std::vector<Scalar>& codebook) const
+    {
+        const auto dimensions = codebook.size() / neurons;
+        std::vector<Scalar> heights(neurons);
+        thread_pool_t::shared().parallel_for(neurons, grain_for(neurons * dimensions), [&](const blt::size_t begin, const blt::size_t end) {
+            for (blt::size_t i = begin; i < end; i++)
+            {
+                Scalar total = 0;
+                blt::size_t count = 0;
+                for (blt::size_t j = 0; j < neurons; j++)
+                {
+                    if (i == j || !are_neighbours(i, j))
+                        continue;
+                    Scalar dist = 0;
+                    for (blt::size_t k = 0; k < dimensions; k++)
+                    {
+                        const auto d = codebook[i * dimensions + k] - codebook[j * dimensions + k];
+                        dist += d * d;
+                    }
+                    total += std::sqrt(dist);
+                    count++;
+                }
+                heights[i] = count == 0 ? 0 : total / static_cast<Scalar>(count);
+            }
+        });
+        return heights;
+    }
+
+    void evaluator_t::set_incremental(const data_file_t* data, const Scalar tolerance)
+    {
+        incremental_data = tolerance > 0 ? data : nullptr;
+        drift_tolerance = tolerance;
+        matched_codebook.clear();
+    }
+
+    void evaluator_t::match(const std::vector<Scalar>& codebook, const data_file_t& data)
+    {
+        const auto samples = data.data_points.size();
+        const auto dimensions = codebook.size() / neurons;
+        const auto incremental = incremental_data != nullptr && &data == incremental_data;
+        reused_rows = incremental && matched_codebook.size() == codebook.size() && distances.size() == neurons * samples;
+        distances.resize(neurons * samples);
+        first_bmu.resize(samples);
+        second_bmu.resize(samples);
+        changed_rows.assign(neurons, 1);
+        if (incremental)
+            matched_codebook.resize(codebook.size());
+        else
+            matched_codebook.clear();
+
+        auto& pool = thread_pool_t::shared();
+
+        // every distance is written by exactly one chunk, so the block is the same however the chunks get scheduled
+        pool.parallel_for(neurons, grain_for(samples * dimensions), [&](const blt::size_t begin, const blt::size_t end) {
+            for (blt::size_t i = begin; i < end; i++)
+            {
+                const auto* weights = codebook.data() + i * dimensions;
+                if (reused_rows)
+                {
+                    Scalar drift = 0;
+                    for (blt::size_t k = 0; k < dimensions; k++)
+                    {
+                        const auto d = weights[k] - matched_codebook[i * dimensions + k];
+                        drift += d * d;
+                    }
+                    if (std::sqrt(drift) <= drift_tolerance)
+                    {
+                        changed_rows[i] = 0;
+                        continue;
+                    }
+                }
+                if (incremental)
+                    std::copy(weights, weights + dimensions, matched_codebook.begin() + static_cast<std::ptrdiff_t>(i * dimensions));
+
+                auto* row = distances.data() + i * samples;
+                for (const auto& [sample, point] : blt::enumerate(data.data_points))
+                {
+                    Scalar dist = 0;
+                    for (blt::size_t k = 0; k < dimensions; k++)
+                    {
+                        const auto d = weights[k] - point.bins[k];
+                        dist += d * d;
+                    }
+                    row[sample] = std::sqrt(dist);
+                }
+            }
+        });
+        recomputed_neurons = static_cast<blt::size_t>(std::count(changed_rows.begin(), changed_rows.end(), 1));
+
+        // activations are only refreshed by compute_activations, which may not be the next one to look at the rows
+        if (!reused_rows)
+            stale_activations.assign(neurons, 1);
+        for (blt::size_t i = 0; i < neurons; i++)
+            stale_activations[i] |= changed_rows[i];
+
+        pool.parallel_for(samples, grain_for(neurons), [&](const blt::size_t begin, const blt::size_t end) {
+            for (blt::size_t sample = begin; sample < end; sample++)
+            {
+                std::pair<blt::size_t, Scalar> min1 = {0, std::numeric_limits<Scalar>::max()};
+                std::pair<blt::size_t, Scalar> min2 = {0, std::numeric_limits<Scalar>::max()};
+                for (blt::size_t i = 0; i < neurons; i++)
+                {
+                    const auto dist = distances[i * samples + sample];
+                    if (dist < min1.second)
+                    {
+                        min2 = min1;
+                        min1 = {i, dist};
+                    }
+                    else if (dist < min2.second)
+                        min2 = {i, dist};
+                }
+                first_bmu[sample] = min1.first;
+                second_bmu[sample] = min2.first;
+            }
+        });
+    }
+
+    Scalar evaluator_t::compute_activations(const std::vector<Scalar>& codebook, const data_file_t& file,
+                                            const topology_function_t& topology_function, const Scalar user_scale, const Scalar distance,
+                                            const Scalar activation, std::vector<Scalar>& activations)
+    {
+        match(codebook, file);
+        const auto samples = file.data_points.size();
+
+        // a neuron whose distances haven't changed since its activation was computed keeps it, as long as the activation settings are the same
+        const std::array<Scalar, 3> parameters{user_scale, distance, activation};
+        const auto reuse = reused_rows && raw_activations.size() == neurons && activation_function == &topology_function &&
+                           activation_parameters == parameters;
+        activation_function = &topology_function;
+        activation_parameters = parameters;
+        raw_activations.resize(neurons);
+
+        scales.resize(neurons);
+        if (activation_mode == activation_mode_t::LATTICE)
+        {
+            compute_scales(topology_function, user_scale, distance, activation);
+            std::vector<Scalar> hits(neurons);
+            accumulate_hits(file, topology_function, hits);
+            spread_hits(hits, topology_function, raw_activations);
+            // nothing about the spread carries over to an exact pass
+            stale_activations.assign(neurons, 1);
+        } else
+        {
+            thread_pool_t::shared().parallel_for(neurons, grain_for(samples), [&](const blt::size_t begin, const blt::size_t end) {
+                for (blt::size_t i = begin; i < end; i++)
+                {
+                    if (reuse && !stale_activations[i])
+                        continue;
+                    stale_activations[i] = 0;
+                    const auto half = neighbour_distances[i] / distance;
+                    scales[i] = user_scale * topology_function.scale(half, activation);
+                    raw_activations[i] = activation_of(i, file, topology_function);
+                }
+            });
+        }
+        activations = raw_activations;
+        return normalize_activations(activations);
+    }
+
+    void evaluator_t::compute_scales(const topology_function_t& topology_function, const Scalar user_scale, const Scalar distance,
+                                     const Scalar activation)
+    {
+        scales.resize(neurons);
+        for (blt::size_t i = 0; i < neurons; i++)
+            scales[i] = user_scale * topology_function.scale(neighbour_distances[i] / distance, activation);
+    }
+
+    Scalar evaluator_t::activation_of(const blt::size_t neuron, const data_file_t& file, const topology_function_t& topology_function) const
+    {
+        const auto samples = file.data_points.size();
+        const auto* row = distances.data() + neuron * samples;
+        Scalar total = 0;
+        for (const auto& [sample, point] : blt::enumerate(file.data_points))
+        {
+            const auto ds = topology_function.call(row[sample], scales[neuron]) * file.weight(sample);
+            if (point.is_bad)
+                total -= ds;
+            else
+                total += ds;
+        }
+        return total;
+    }
+
+    Scalar evaluator_t::normalize_activations(std::vector<Scalar>& activations) const
+    {
+        // reductions happen in neuron order on this thread so the results don't depend on the number of threads
+        Scalar min = std::numeric_limits<Scalar>::max();
+        Scalar max = std::numeric_limits<Scalar>::min();
+        Scalar global_scale_avg = 0;
+        for (blt::size_t i = 0; i < neurons; i++)
+        {
+            global_scale_avg += scales[i];
+            min = std::min(min, activations[i]);
+            max = std::max(max, activations[i]);
+        }
+
+        for (auto& v : activations)
+            v = 2 * (v - min) / (max - min) - 1;
+
+        return global_scale_avg / static_cast<Scalar>(neurons);
+    }
+
+    void evaluator_t::accumulate_hits(const data_file_t& file, const topology_function_t& topology_function, std::vector<Scalar>& hits) const
+    {
+        const auto samples = file.data_points.size();
+        for (const auto& [sample, point] : blt::enumerate(file.data_points))
+        {
+            const auto bmu = first_bmu[sample];
+            const auto ds = topology_function.call(distances[bmu * samples + sample], scales[bmu]) * file.weight(sample);
+            hits[bmu] += point.is_bad ? -ds : ds;
+        }
+    }
+
+    void evaluator_t::spread_hits(const std::vector<Scalar>& hits, const topology_function_t& topology_function, std::vector<Scalar>& activations)
+    {
+        activations.assign(neurons, 0);
+        const auto uniform = std::all_of(scales.begin(), scales.end(), [this](const Scalar scale) {
+            return blt::f_equal(scale, scales.front());
+        });
+        const auto grid = lattice_shape == shape_t::GRID || lattice_shape == shape_t::GRID_WRAP;
+        // exp(-s * (dx^2 + dy^2)) = exp(-s * dx^2) * exp(-s * dy^2), which only holds for the gaussian
+        if (uniform && grid && dynamic_cast<const gaussian_function_t*>(&topology_function) != nullptr)
+        {
+            const auto wrapped = lattice_shape == shape_t::GRID_WRAP;
+            const auto make_kernel = [&](const blt::size_t size) {
+                std::vector<Scalar> kernel(size);
+                for (blt::size_t d = 0; d < size; d++)
+                {
+                    const auto offset = static_cast<Scalar>(wrapped ? std::min(d, size - d) : d);
+                    kernel[d] = topology_function.call(offset, scales.front());
+                }
+                return kernel;
+            };
+            const auto kernel_x = make_kernel(lattice_width);
+            const auto kernel_y = make_kernel(lattice_height);
+            // the wrapped kernels are symmetric around size / 2, so either way they are indexed by the plain offset
+            const auto offset_of = [](const blt::size_t a, const blt::size_t b) {
+                return a > b ? a - b : b - a;
+            };
+
+            std::vector<Scalar> rows(neurons);
+            for (blt::size_t y = 0; y < lattice_height; y++)
+            {
+                for (blt::size_t x = 0; x < lattice_width; x++)
+                {
+                    Scalar total = 0;
+                    for (blt::size_t from = 0; from < lattice_width; from++)
+                        total += hits[y * lattice_width + from] * kernel_x[offset_of(x, from)];
+                    rows[y * lattice_width + x] = total;
+                }
+            }
+            for (blt::size_t y = 0; y < lattice_height; y++)
+            {
+                for (blt::size_t x = 0; x < lattice_width; x++)
+                {
+                    Scalar total = 0;
+                    for (blt::size_t from = 0; from < lattice_height; from++)
+                        total += rows[from * lattice_width + x] * kernel_y[offset_of(y, from)];
+                    activations[y * lattice_width + x] = total;
+                }
+            }
+            return;
+        }
+
+        thread_pool_t::shared().parallel_for(neurons, grain_for(neurons), [&](const blt::size_t begin, const blt::size_t end) {
+            for (blt::size_t i = begin; i < end; i++)
+            {
+                Scalar total = 0;
+                for (blt::size_t j = 0; j < neurons; j++)
+                    total += hits[j] * topology_function.call(lattice_distances[i * neurons + j], scales[i]);
+                activations[i] = total;
+            }
+        });
+    }
+
+    Scalar evaluator_t::classification_agreement(const std::vector<Scalar>& a, const std::vector<Scalar>& b, const Scalar quantization_distance)
+    {
+        const auto classify = [quantization_distance](const Scalar v) {
+            return v >= quantization_distance ? 1 : (v <= -quantization_distance ? -1 : 0);
+        };
+        blt::size_t agree = 0;
+        for (blt::size_t i = 0; i < std::min(a.size(), b.size()); i++)
+        {
+            if (classify(a[i]) == classify(b[i]))
+                agree++;
+        }
+        return a.empty() ? 1 : static_cast<Scalar>(agree) / static_cast<Scalar>(a.size());
+    }
+
+    evaluation_t evaluator_t::evaluate(const std::vector<Scalar>& codebook, const data_file_t& file, const topology_function_t& topology_function,
+                                       const Scalar user_scale, const Scalar distance, const Scalar activation, const Scalar quantization_distance)
+    {
+        evaluation_t result;
+        // compute_activations leaves the match of file behind, so both errors come from the same block
+        result.scale_average = compute_activations(codebook, file, topology_function, user_scale, distance, activation, result.activations);
+        result.topological_error = topological_error_of_match(file);
+        result.quantization_error = quantization_error_of_match(file, result.activations, quantization_distance);
+        result.topological_interval = {result.topological_error, result.topological_error};
+        result.quantization_interval = {result.quantization_error, result.quantization_error};
+        if (keep_matches)
+        {
+            result.first_bmus = first_bmu;
+            result.second_bmus = second_bmu;
+        }
+        return result;
+    }
+
+    evaluation_t evaluator_t::evaluate(const std::vector<Scalar>& codebook, data_stream_t& stream, const topology_function_t& topology_function,
+                                       const Scalar user_scale, const Scalar distance, const Scalar activation, const Scalar quantization_distance)
+    {
+        stream.begin_pass(false);
+        return evaluate_blocks(codebook, [&stream]() { return stream.next(); }, topology_function, user_scale, distance, activation,
+                               quantization_distance);
+    }
+
+    evaluation_t evaluator_t::evaluate(const std::vector<Scalar>& codebook, const padded_dataset_t& data,
+                                       const topology_function_t& topology_function, const Scalar user_scale, const Scalar distance,
+                                       const Scalar activation, const Scalar quantization_distance)
+    {
+        constexpr blt::size_t block_samples = 4096;
+        data_file_t block;
+        blt::size_t first = 0;
+        return evaluate_blocks(codebook, [&]() -> const data_file_t* {
+            if (first >= data.size())
+                return nullptr;
+            const auto count = std::min(block_samples, data.size() - first);
+            block = data.materialize(first, count);
+            first += count;
+            return &block;
+        }, topology_function, user_scale, distance, activation, quantization_distance);
+    }
+
+    evaluation_t evaluator_t::evaluate_blocks(const std::vector<Scalar>& codebook, const std::function<const data_file_t*()>& next,
+                                              const topology_function_t& topology_function, const Scalar user_scale, const Scalar distance,
+                                              const Scalar activation, const Scalar quantization_distance)
+    {
+        compute_scales(topology_function, user_scale, distance, activation);
+
+        std::vector<Scalar> raw(neurons), hits(neurons);
+        // weight of the good (0) and bad (1) samples each neuron is the BMU of
+        std::vector<std::array<Scalar, 2>> bmu_weights(neurons);
+        Scalar topological = 0;
+        Scalar total_weight = 0;
+        while (const auto* chunk = next())
+        {
+            match(codebook, *chunk);
+            if (activation_mode == activation_mode_t::LATTICE)
+                accumulate_hits(*chunk, topology_function, hits);
+            else
+            {
+                thread_pool_t::shared().parallel_for(neurons, grain_for(chunk->data_points.size()),
+                                                     [&](const blt::size_t begin, const blt::size_t end) {
+                                                         for (blt::size_t i = begin; i < end; i++)
+                                                             raw[i] += activation_of(i, *chunk, topology_function);
+                                                     });
+            }
+            for (const auto& [sample, point] : blt::enumerate(chunk->data_points))
+            {
+                const auto w = chunk->weight(sample);
+                if (is_topological_error(sample))
+                    topological += w;
+                bmu_weights[first_bmu[sample]][point.is_bad ? 1 : 0] += w;
+                total_weight += w;
+            }
+        }
+        if (activation_mode == activation_mode_t::LATTICE)
+            spread_hits(hits, topology_function, raw);
+        // the rows left behind belong to the last block, nothing can be reused from them
+        raw_activations.clear();
+        stale_activations.assign(neurons, 1);
+
+        evaluation_t result;
+        result.activations = std::move(raw);
+        result.scale_average = normalize_activations(result.activations);
+        result.topological_error = total_weight > 0 ? topological / total_weight : 0;
+        for (blt::size_t i = 0; i < neurons; i++)
+        {
+            // same rule as is_quantization_error, applied to every sample sharing a BMU at once
+            const auto a = result.activations[i];
+            if (a > -quantization_distance && a < quantization_distance)
+                result.quantization_error += bmu_weights[i][0] + bmu_weights[i][1];
+            else if (a <= -quantization_distance)
+                result.quantization_error += bmu_weights[i][0];
+            else
+                result.quantization_error += bmu_weights[i][1];
+        }
+        result.topological_interval = {result.topological_error, result.topological_error};
+        result.quantization_interval = {result.quantization_error, result.quantization_error};
+        return result;
+    }
+
+    Scalar evaluator_t::topological_error(const std::vector<Scalar>& codebook, const data_file_t& data)
+    {
+        match(codebook, data);
+        return topological_error_of_match(data);
+    }
+
+    Scalar evaluator_t::quantization_error(const std::vector<Scalar>& codebook, const data_file_t& data, const std::vector<Scalar>& activations,
+                                           const Scalar quantization_distance)
+    {
+        match(codebook, data);
+        return quantization_error_of_match(data, activations, quantization_distance);
+    }
+
+    Scalar evaluator_t::topological_error_of_match(const data_file_t& data) const
+    {
+        Scalar total = 0;
+        for (blt::size_t sample = 0; sample < data.data_points.size(); sample++)
+        {
+            if (is_topological_error(sample))
+                total += data.weight(sample);
+        }
+        return total / data.total_weight();
+    }
+
+    bool evaluator_t::is_quantization_error(const blt::size_t sample, const data_view_t& point, const std::vector<Scalar>& activations,
+                                            const Scalar quantization_distance) const
+    {
+        const auto nearest = activations[first_bmu[sample]];
+
+        const bool is_neural = nearest > -quantization_distance && nearest < quantization_distance;
+        if (is_neural)
+            return true;
+
+        const bool is_bad = nearest <= -quantization_distance;
+        const bool is_good = nearest >= quantization_distance;
+
+        return !((is_bad && point.is_bad) || (is_good && !point.is_bad));
+    }
+
+    Scalar evaluator_t::quantization_error_of_match(const data_file_t& data, const std::vector<Scalar>& activations,
+                                                    const Scalar quantization_distance) const
+    {
+        Scalar incorrect = 0;
+        for (const auto& [sample, point] : blt::enumerate(data.data_points))
+        {
+            if (is_quantization_error(sample, point, activations, quantization_distance))
+                incorrect += data.weight(sample);
+        }
+        return incorrect;
+    }
+
+    // Agresti-Coull centre of a proportion seen as rate over n samples. Unlike the raw rate it never sits on 0 or 1, where the Wald
+    // variance p(1 - p) would claim there's no uncertainty left at all
+    static double adjusted_rate(const double rate, const double n, const double z)
+    {
+        return (rate * n + z * z / 2) / (n + z * z);
+    }
+
+    evaluation_t evaluator_t::estimate(const std::vector<Scalar>& codebook, const sample_plan_t& plan, const topology_function_t& topology_function,
+                                       const Scalar user_scale, const Scalar distance, const Scalar activation, const Scalar quantization_distance,
+                                       const Scalar confidence)
+    {
+        auto result = evaluate(codebook, plan.sample, topology_function, user_scale, distance, activation, quantization_distance);
+        // matches of a subsample don't line up with the samples of the file
+        result.first_bmus.clear();
+        result.second_bmus.clear();
+
+        // per class error rates. Weights within a class were all scaled by the same amount so the rates match the unscaled sample
+        std::array<Scalar, 2> weights{}, topological{}, quantization{};
+        for (const auto& [sample, point] : blt::enumerate(plan.sample.data_points))
+        {
+            const auto w = plan.sample.weight(sample);
+            const auto h = point.is_bad ? 1 : 0;
+            weights[h] += w;
+            if (is_topological_error(sample))
+                topological[h] += w;
+            if (is_quantization_error(sample, point, result.activations, quantization_distance))
+                quantization[h] += w;
+        }
+
+        const auto total_weight = plan.population_weight[0] + plan.population_weight[1];
+        const auto z = normal_quantile(1 - (1 - static_cast<double>(confidence)) / 2);
+        double topological_variance = 0, quantization_variance = 0;
+        for (blt::size_t h = 0; h < 2; h++)
+        {
+            if (plan.drawn[h] == 0 || weights[h] <= 0)
+                continue;
+            result.topological_rates[h] = topological[h] / weights[h];
+            result.quantization_rates[h] = quantization[h] / weights[h];
+
+            result.drawn[h] = plan.drawn[h];
+
+            const auto share = static_cast<double>(plan.population_weight[h] / total_weight);
+            const auto n = static_cast<double>(plan.drawn[h]);
+            const auto correction = 1.0 - n / static_cast<double>(plan.population[h]);
+            const auto pt = adjusted_rate(result.topological_rates[h], n, z);
+            const auto pq = adjusted_rate(result.quantization_rates[h], n, z);
+            topological_variance += share * share * pt * (1 - pt) / (n + z * z) * correction;
+            quantization_variance += share * share * pq * (1 - pq) / (n + z * z) * correction;
+        }
+
+        const auto topological_half = static_cast<Scalar>(z * std::sqrt(topological_variance));
+        const auto quantization_half = static_cast<Scalar>(z * std::sqrt(quantization_variance)) * total_weight;
+        result.topological_interval = {std::max(result.topological_error - topological_half, static_cast<Scalar>(0)),
+                                       std::min(result.topological_error + topological_half, static_cast<Scalar>(1))};
+        result.quantization_interval = {std::max(result.quantization_error - quantization_half, static_cast<Scalar>(0)),
+                                        std::min(result.quantization_error + quantization_half, total_weight)};
+        return result;
+    }
+
+    error_sampler_t::error_sampler_t(const Scalar interval_width, const Scalar confidence, const blt::size_t min_per_class):
+        interval_width(interval_width), confidence(confidence), min_per_class(min_per_class)
+    {}
+
+    sample_plan_t error_sampler_t::draw(const data_file_t& file, const blt::size_t seed) const
+    {
+        sample_plan_t plan;
+        std::array<std::vector<blt::size_t>, 2> members;
+        for (const auto& [i, point] : blt::enumerate(file.data_points))
+        {
+            const auto h = point.is_bad ? 1 : 0;
+            members[h].push_back(i);
+            plan.population_weight[h] += file.weight(i);
+        }
+        const auto total_weight = plan.population_weight[0] + plan.population_weight[1];
+        const auto population = static_cast<double>(file.data_points.size());
+
+        // sample size for a simple stratified estimate of a proportion with proportional allocation, with the finite population correction
+        const auto z = normal_quantile(1 - (1 - static_cast<double>(confidence)) / 2);
+        const auto half_width = static_cast<double>(interval_width) / 2;
+        double needed = 0;
+        for (const auto& rates : {topological_rates, quantization_rates})
+        {
+            double variance = 0;
+            for (blt::size_t h = 0; h < 2; h++)
+            {
+                const auto p = adjusted_rate(rates[h], static_cast<double>(drawn[h]), z);
+                variance += static_cast<double>(plan.population_weight[h] / total_weight) * p * (1 - p);
+            }
+            const auto n0 = z * z * variance / (half_width * half_width);
+            needed = std::max(needed, n0 / (1 + n0 / population));
+        }
+
+        blt::random::random_t rand{seed};
+        for (blt::size_t h = 0; h < 2; h++)
+        {
+            auto& indices = members[h];
+            plan.population[h] = indices.size();
+            const auto share = static_cast<double>(indices.size()) / population;
+            const auto wanted = std::max(static_cast<blt::size_t>(std::ceil(needed * share)), min_per_class);
+            plan.drawn[h] = std::min(wanted, indices.size());
+
+            // partial shuffle, only the front drawn entries are needed
+            for (blt::size_t i = 0; i < plan.drawn[h]; i++)
+                std::swap(indices[i], indices[std::uniform_int_distribution<blt::size_t>{i, indices.size() - 1}(rand)]);
+
+            Scalar drawn_weight = 0;
+            for (blt::size_t i = 0; i < plan.drawn[h]; i++)
+                drawn_weight += file.weight(indices[i]);
+            const auto expansion = drawn_weight > 0 ? plan.population_weight[h] / drawn_weight : 1;
+            for (blt::size_t i = 0; i < plan.drawn[h]; i++)
+            {
+                plan.sample.data_points.push_back(file.data_points[indices[i]]);
+                plan.sample.weights.push_back(file.weight(indices[i]) * expansion);
+            }
+        }
+        return plan;
+    }
+
+    void error_sampler_t::update(const evaluation_t& evaluation)
+    {
+        topological_rates = evaluation.topological_rates;
+        quantization_rates = evaluation.quantization_rates;
+        drawn = evaluation.drawn;
+    }
+}
@@ -0,0 +1,331 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/features.h>
+#include <assign3/thread_pool.h>
+#include <blt/std/logging.h>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+
+namespace assign3
+{
+    std::vector<signal_t> parse_signals(const std::string_view contents)
+    {
+        std::vector<signal_t> signals;
+        const auto* it = contents.data();
+        const auto* end = contents.data() + contents.size();
+        while (it != end)
+        {
+            const auto* line_end = std::find(it, end, '\n');
+            signal_t signal;
+            int label = 0;
+            bool valid = false;
+            bool first = true;
+            while (true)
+            {
+                while (it != line_end && (*it == ' ' || *it == '\t' || *it == '\r'))
+                    ++it;
+                if (it == line_end)
+                    break;
+                Scalar value;
+                const auto [ptr, ec] = first ? std::from_chars(it, line_end, label) : std::from_chars(it, line_end, value);
+                if (ec != std::errc{})
+                {
+                    valid = false;
+                    break;
+                }
+                if (!first)
+                    signal.values.push_back(value);
+                valid = !first;
+                first = false;
+                it = ptr;
+            }
+            if (valid)
+            {
+                signal.is_bad = label == 1;
+                signals.push_back(std::move(signal));
+            }
+            it = line_end == end ? end : line_end + 1;
+        }
+        return signals;
+    }
+
+    std::optional<std::vector<signal_t>> load_signal_file(const std::string& path)
+    {
+        std::ifstream stream{path, std::ios::binary | std::ios::ate};
+        if (!stream)
+        {
+            BLT_WARN("Unable to open signal file '%s'", path.c_str());
+            return {};
+        }
+        std::string buffer(static_cast<blt::size_t>(stream.tellg()), '\0');
+        stream.seekg(0);
+        if (!stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size())))
+        {
+            BLT_WARN("Unable to read signal file '%s'", path.c_str());
+            return {};
+        }
+        return parse_signals(buffer);
+    }
+
+    fft_t::fft_t(const blt::size_t size): n(std::max(size, static_cast<blt::size_t>(1)))
+    {
+        // 4 = 2 * 2 so radix 2 covers every power of two, the odd factors follow
+        auto remaining = n;
+        for (blt::size_t p = 2; p * p <= remaining; p++)
+        {
+            while (remaining % p == 0)
+            {
+                factors.push_back(p);
+                remaining /= p;
+            }
+        }
+        if (remaining > 1)
+            factors.push_back(remaining);
+        for (const auto p : factors)
+            max_factor = std::max(max_factor, p);
+
+        twiddles.resize(n);
+        for (blt::size_t k = 0; k < n; k++)
+            twiddles[k] = std::polar(1.0, -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(n));
+    }
+
+    void fft_t::transform(const complex_t* in, complex_t* out, const blt::size_t stride) const
+    {
+        transform(in, out, n, stride, 0);
+    }
+
+    void fft_t::transform(const complex_t* in, complex_t* out, const blt::size_t size, const blt::size_t stride, const blt::size_t factor) const
+    {
+        if (size == 1)
+        {
+            out[0] = in[0];
+            return;
+        }
+
+        // decimation in time, the p interleaved sub-sequences are transformed into consecutive blocks of out
+        const auto p = factors[factor];
+        const auto m = size / p;
+        for (blt::size_t r = 0; r < p; r++)
+            transform(in + r * stride, out + r * m, m, stride * p, factor + 1);
+
+        // twiddles of this size are every (n / size)th twiddle of the full size
+        const auto step = n / size;
+        if (p == 2)
+        {
+            for (blt::size_t k = 0; k < m; k++)
+            {
+                const auto a = out[k];
+                const auto b = out[k + m] * twiddles[k * step];
+                out[k] = a + b;
+                out[k + m] = a - b;
+            }
+            return;
+        }
+
+        // output k + q * m only depends on inputs k + r * m, so each k is gathered before being overwritten
+        const auto p_step = n / p;
+        complex_t gathered[16];
+        std::vector<complex_t> large;
+        auto* t = gathered;
+        if (p > 16)
+        {
+            large.resize(p);
+            t = large.data();
+        }
+        for (blt::size_t k = 0; k < m; k++)
+        {
+            for (blt::size_t r = 0; r < p; r++)
+                t[r] = out[k + r * m] * twiddles[r * k * step];
+            for (blt::size_t q = 0; q < p; q++)
+            {
+                complex_t sum = t[0];
+                for (blt::size_t r = 1; r < p; r++)
+                    sum += t[r] * twiddles[(r * q % p) * p_step];
+                out[k + q * m] = sum;
+            }
+        }
+    }
+
+    feature_extractor_t::feature_extractor_t(const blt::size_t bins): bins(std::max(bins, static_cast<blt::size_t>(1))), fft(2 * this->bins)
+    {
+        // periodic Hann, half overlapping windows of it sum to a constant
+        const auto size = fft.size();
+        window.resize(size);
+        for (blt::size_t i = 0; i < size; i++)
+        {
+            window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * static_cast<double>(i) / static_cast<double>(size));
+            window_sum += window[i];
+        }
+    }
+
+    void feature_extractor_t::extract(const blt::span<const Scalar> signal, const blt::span<Scalar> out) const
+    {
+        const auto size = fft.size();
+        const auto hop = size / 2;
+        const auto windows = signal.size() <= size ? 1 : (signal.size() - size + hop - 1) / hop + 1;
+
+        // mean removed and windowed, the last window is moved back so it ends on the last sample instead of running off the end
+        const auto prepare = [&](const blt::size_t w, const auto& store) {
+            const auto start = std::min(w * hop, signal.size() > size ? signal.size() - size : 0);
+            const auto count = std::min(size, signal.size() - start);
+            double mean = 0;
+            for (blt::size_t i = 0; i < count; i++)
+                mean += signal[start + i];
+            mean /= static_cast<double>(std::max(count, static_cast<blt::size_t>(1)));
+            for (blt::size_t i = 0; i < size; i++)
+                store(i, i < count ? (signal[start + i] - mean) * window[i] : 0.0);
+        };
+
+        // windows are real, so two of them go through one transform as the real and imaginary parts and are separated again with
+        // X[k] = (Z[k] + conj(Z[n - k])) / 2 and Y[k] = (Z[k] - conj(Z[n - k])) / 2i
+        std::vector<fft_t::complex_t> in(size), spectrum(size);
+        std::vector<double> power(bins);
+        for (blt::size_t w = 0; w < windows; w += 2)
+        {
+            const auto paired = w + 1 < windows;
+            prepare(w, [&](const blt::size_t i, const double v) {
+                in[i] = v;
+            });
+            if (paired)
+            {
+                prepare(w + 1, [&](const blt::size_t i, const double v) {
+                    in[i].imag(v);
+                });
+            }
+
+            fft.transform(in.data(), spectrum.data());
+            for (blt::size_t k = 1; k <= bins; k++)
+            {
+                const auto z = spectrum[k];
+                const auto mirror = std::conj(spectrum[size - k]);
+                if (paired)
+                    power[k - 1] += std::norm(z + mirror) / 4 + std::norm(z - mirror) / 4;
+                else
+                    power[k - 1] += std::norm(z);
+            }
+        }
+
+        // a sine of amplitude a peaks at a * window_sum / 2, rms is a / sqrt(2). The nyquist bin has no mirror so it doesn't double
+        for (blt::size_t k = 0; k < bins; k++)
+        {
+            const auto scale = (k + 1 == bins ? 1.0 : 2.0) / window_sum / std::sqrt(2.0);
+            out[k] = static_cast<Scalar>(std::sqrt(power[k] / static_cast<double>(windows)) * scale);
+        }
+    }
+
+    data_file_t feature_extractor_t::extract(const std::vector<signal_t>& signals) const
+    {
+        std::vector<Scalar> values(signals.size() * bins);
+        thread_pool_t::shared().parallel_for(signals.size(), 1, [&](const blt::size_t begin, const blt::size_t end) {
+            for (blt::size_t i = begin; i < end; i++)
+                extract(signals[i].values, blt::span<Scalar>{values.data() + i * bins, bins});
+        });
+
+        data_file_t file;
+        file.data_points.reserve(signals.size(), bins);
+        for (blt::size_t i = 0; i < signals.size(); i++)
+            file.data_points.push_back(signals[i].is_bad, blt::span<const Scalar>{values.data() + i * bins, bins});
+        return file;
+    }
+
+    sliding_spectrum_t::sliding_spectrum_t(const blt::size_t bins, const blt::size_t hop): bins(std::max(bins, static_cast<blt::size_t>(1))),
+                                                                                             hop(hop == 0 ? this->bins : hop), fft(2 * this->bins)
+    {
+        const auto size = fft.size();
+        ring.resize(size);
+        coefficients.resize(this->bins + 2);
+        rotations.resize(this->bins + 2);
+        for (blt::size_t k = 0; k < rotations.size(); k++)
+            rotations[k] = std::polar(1.0, 2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size));
+    }
+
+    blt::size_t sliding_spectrum_t::push(const blt::span<const Scalar> samples, data_file_t& frames)
+    {
+        const auto size = fft.size();
+        blt::size_t emitted = 0;
+        scratch.resize(bins);
+        for (const auto sample : samples)
+        {
+            // the oldest sample leaves, the new one takes its place and every coefficient rotates to the window's new start
+            const auto delta = static_cast<double>(sample) - ring[position];
+            ring[position] = sample;
+            position = (position + 1) % size;
+            for (blt::size_t k = 0; k < coefficients.size(); k++)
+                coefficients[k] = (coefficients[k] + delta) * rotations[k];
+            seen++;
+
+            if (++since_refresh == size)
+                refresh();
+
+            if (seen >= size && (seen - size) % hop == 0)
+            {
+                frame(scratch);
+                frames.data_points.push_back(false, blt::span<const Scalar>{scratch.data(), bins});
+                emitted++;
+            }
+        }
+        return emitted;
+    }
+
+    void sliding_spectrum_t::frame(const blt::span<Scalar> out) const
+    {
+        // the periodic Hann window is the kernel (-1/4, 1/2, -1/4) in the frequency domain, DC is left out to remove the mean
+        const auto window_sum = static_cast<double>(fft.size()) / 2;
+        double total = 0;
+        for (blt::size_t k = 1; k <= bins; k++)
+        {
+            const auto below = k == 1 ? fft_t::complex_t{} : coefficients[k - 1];
+            const auto windowed = 0.5 * coefficients[k] - 0.25 * (below + coefficients[k + 1]);
+            const auto scale = (k == bins ? 1.0 : 2.0) / window_sum / std::sqrt(2.0);
+            const auto amplitude = std::abs(windowed) * scale;
+            out[k - 1] = static_cast<Scalar>(amplitude);
+            total += amplitude * amplitude;
+        }
+
+        // a silent window has no shape to normalise, it stays zero rather than becoming NaN
+        const auto mag = std::sqrt(total);
+        if (mag > 0)
+        {
+            for (blt::size_t k = 0; k < bins; k++)
+                out[k] = static_cast<Scalar>(out[k] / mag);
+        }
+    }
+
+    void sliding_spectrum_t::reset()
+    {
+        std::fill(ring.begin(), ring.end(), 0.0);
+        std::fill(coefficients.begin(), coefficients.end(), fft_t::complex_t{});
+        position = 0;
+        seen = 0;
+        since_refresh = 0;
+    }
+
+    void sliding_spectrum_t::refresh()
+    {
+        const auto size = fft.size();
+        std::vector<fft_t::complex_t> in(size), spectrum(size);
+        for (blt::size_t i = 0; i < size; i++)
+            in[i] = ring[(position + i) % size];
+        fft.transform(in.data(), spectrum.data());
+        for (blt::size_t k = 0; k < coefficients.size(); k++)
+            coefficients[k] = spectrum[k % size];
+        since_refresh = 0;
+    }
+}
@@ -16,13 +16,19 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <assign3/file.h>
+#include <assign3/binary_file.h>
+#include <assign3/thread_pool.h>
 #include <blt/std/string.h>
 #include <blt/std/random.h>
-#include <blt/fs/loader.h>
+#include <blt/std/logging.h>
 #include <filesystem>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <algorithm>
+#include <numeric>
 #include <random>
 #include "blt/iterator/enumerate.h"
 
@@ -37,52 +43,134 @@ namespace assign3
             if (file.is_directory())
                 continue;
             auto file_path = file.path().string();
-            if (blt::string::ends_with(file_path, ".out"))
-                files.push_back(blt::fs::getFile(file_path));
+            if (blt::string::ends_with(file_path, binary_data_extension))
+                files.push_back(std::move(file_path));
+            // a converted copy is loaded instead of the text file
+            else if (blt::string::ends_with(file_path, ".out") &&
+                     !std::filesystem::exists(file_path.substr(0, file_path.size() - 4) + std::string(binary_data_extension)))
+                files.push_back(std::move(file_path));
         }
+        // directory iteration order is unspecified, sorted the files come out the same every run
+        std::sort(files.begin(), files.end());
         
         return files;
     }
     
-    std::vector<data_file_t> data_file_t::load_data_files(const std::vector<std::string>& files)
+    // spaces, tabs and the \r of windows line endings, never the end of the line itself
+    static void skip_blanks(const char*& it, const char* end)
     {
-        std::vector<data_file_t> loaded_data;
+        while (it != end && (*it == ' ' || *it == '\t' || *it == '\r'))
+            ++it;
+    }
+    
+    template <typename T>
+    static bool parse_value(const char*& it, const char* end, T& value)
+    {
+        skip_blanks(it, end);
+        const auto [ptr, ec] = std::from_chars(it, end, value);
+        if (ec != std::errc{})
+            return false;
+        it = ptr;
+        return true;
+    }
+    
+    std::optional<data_file_t> data_file_t::parse(const std::string_view contents)
+    {
+        const auto* it = contents.data();
+        const auto* end = contents.data() + contents.size();
+        
+        blt::size_t count = 0;
+        blt::size_t bin_count = 0;
+        const auto* header_end = std::find(it, end, '\n');
+        if (!parse_value(it, header_end, count) || !parse_value(it, header_end, bin_count))
+            return {};
+        it = header_end == end ? end : header_end + 1;
         
-        // load all file
-        for (auto file : files)
+        // values are parsed straight into the sample they end up in, a line that turns out to be malformed is just dropped again
+        data_file_t data;
+        data.data_points.reserve(count, bin_count);
+        while (it != end)
         {
-            // we only use unix line endings here...
-            blt::string::replaceAll(file, "\r", "");
-            auto lines = blt::string::split(file, "\n");
-            auto line_it = lines.begin();
-            auto meta = blt::string::split(*line_it, ' ');
+            const auto* line_end = std::find(it, end, '\n');
+            auto bins = data.data_points.emplace_back(bin_count);
             
-            // load data inside files
-            data_file_t data;
-            data.data_points.reserve(std::stoll(meta[0]));
-            auto bin_count = std::stoul(meta[1]);
+            int label = 0;
+            bool valid = parse_value(it, line_end, label);
+            for (blt::size_t i = 0; valid && i < bin_count; i++)
+                valid = parse_value(it, line_end, bins[i]);
+            skip_blanks(it, line_end);
             
-            for (++line_it; line_it != lines.end(); ++line_it)
+            if (valid && it == line_end)
+                data.data_points.set_bad(data.data_points.size() - 1, label == 1);
+            else
+                data.data_points.pop_back();
+            it = line_end == end ? end : line_end + 1;
+        }
+        
+        return data;
+    }
+    
+    // buffer is reused between text files, bytes is set to the size of the data read
+    static std::optional<data_file_t> load_file(const std::string& path, std::string& buffer, blt::size_t& bytes)
+    {
+        if (blt::string::ends_with(path, binary_data_extension))
+        {
+            const auto mapped = mapped_data_file_t::open(path);
+            if (!mapped)
+                return {};
+            bytes = mapped->get_samples() * mapped->get_bins() * mapped->get_precision();
+            return mapped->to_data_file();
+        }
+        std::ifstream stream{path, std::ios::binary | std::ios::ate};
+        if (!stream)
+            return {};
+        const auto size = static_cast<blt::size_t>(stream.tellg());
+        buffer.resize(size);
+        stream.seekg(0);
+        if (!stream.read(buffer.data(), static_cast<std::streamsize>(size)))
+            return {};
+        bytes = size;
+        return data_file_t::parse(buffer);
+    }
+    
+    std::optional<data_file_t> data_file_t::load(const std::string& path)
+    {
+        std::string buffer;
+        blt::size_t bytes = 0;
+        return load_file(path, buffer, bytes);
+    }
+    
+    std::vector<data_file_t> data_file_t::load_data_files(const std::vector<std::string>& files)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::optional<data_file_t>> parsed(files.size());
+        std::vector<blt::size_t> sizes(files.size());
+        
+        // one file per chunk, each chunk reuses its buffer for every text file it reads
+        thread_pool_t::shared().parallel_for(files.size(), 1, [&](const blt::size_t begin, const blt::size_t end) {
+            std::string buffer;
+            for (blt::size_t i = begin; i < end; i++)
+                parsed[i] = load_file(files[i], buffer, sizes[i]);
+        });
+        
+        std::vector<data_file_t> loaded_data;
+        blt::size_t total_size = 0;
+        for (const auto& [i, data] : blt::enumerate(parsed))
+        {
+            if (!data)
             {
-                auto line_data_meta = blt::string::split(*line_it, ' ');
-                if (line_data_meta.size() != bin_count + 1)
-                    continue;
-                auto line_data_it = line_data_meta.begin();
-                
-                // load bins
-                data_t line_data;
-                line_data.is_bad = std::stoi(*line_data_it) == 1;
-                line_data.bins.reserve(bin_count);
-                
-                for (++line_data_it; line_data_it != line_data_meta.end(); ++line_data_it)
-                    line_data.bins.push_back(std::stof(*line_data_it));
-                
-                data.data_points.push_back(line_data);
+                BLT_WARN("Unable to load data file '%s', skipping it", files[i].c_str());
+                continue;
             }
-            
-            loaded_data.push_back(data);
+            total_size += sizes[i];
+            loaded_data.push_back(std::move(*data));
         }
         
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto megabytes = static_cast<double>(total_size) / (1024.0 * 1024.0);
+        BLT_INFO("Loaded %ld data files (%f MB) in %fs, %f MB/s", loaded_data.size(), megabytes, seconds,
+                 seconds > 0 ? megabytes / seconds : 0.0);
+        
         return loaded_data;
     }
     
@@ -94,9 +182,8 @@ namespace assign3
     data_t data_t::with_padding(blt::size_t desired_size, Scalar padding_value) const
     {
         data_t data = *this;
-        auto amount_to_add = static_cast<blt::ptrdiff_t>(data.bins.size()) - static_cast<blt::ptrdiff_t>(desired_size);
-        for (blt::ptrdiff_t i = 0; i < amount_to_add; i++)
-            data.bins.push_back(padding_value);
+        if (data.bins.size() < desired_size)
+            data.bins.resize(desired_size, padding_value);
         return data;
     }
     
@@ -113,73 +200,428 @@ namespace assign3
         return data;
     }
     
+    data_view_t data_storage_t::operator[](const blt::size_t index) const
+    {
+        const auto [c, i] = locate(index);
+        const auto& chunk = *chunks[c];
+        return {((chunk.labels[i / 64] >> (i % 64)) & 1) != 0, blt::span<const Scalar>{chunk.values.data() + i * bins, bins}};
+    }
+    
+    std::pair<blt::size_t, blt::size_t> data_storage_t::locate(const blt::size_t index) const
+    {
+        // a file which was never concatenated is a single chunk
+        if (chunks.size() == 1)
+            return {0, index};
+        const auto c = static_cast<blt::size_t>(std::upper_bound(starts.begin(), starts.end(), index) - starts.begin()) - 1;
+        return {c, index - starts[c]};
+    }
+    
+    data_storage_t::chunk_t& data_storage_t::writable(const blt::size_t chunk)
+    {
+        if (chunks[chunk].use_count() > 1)
+            chunks[chunk] = std::make_shared<chunk_t>(*chunks[chunk]);
+        return *chunks[chunk];
+    }
+    
+    data_storage_t::chunk_t& data_storage_t::tail()
+    {
+        // a shared last chunk is left to its other owners rather than cloned, new samples start a chunk of their own
+        if (chunks.empty() || chunks.back().use_count() > 1)
+        {
+            chunks.push_back(std::make_shared<chunk_t>());
+            starts.push_back(count);
+        }
+        return *chunks.back();
+    }
+    
+    void data_storage_t::reserve(const blt::size_t samples, const blt::size_t bin_count)
+    {
+        if (empty())
+            bins = bin_count;
+        BLT_ASSERT(bins == bin_count);
+        auto& chunk = tail();
+        chunk.values.reserve((chunk.samples + samples) * bins);
+        chunk.labels.reserve((chunk.samples + samples + 63) / 64);
+    }
+    
+    blt::span<Scalar> data_storage_t::emplace_back(const blt::size_t bin_count, const bool is_bad)
+    {
+        if (empty())
+            bins = bin_count;
+        BLT_ASSERT(bins == bin_count);
+        auto& chunk = tail();
+        const auto i = chunk.samples++;
+        chunk.values.resize(chunk.samples * bins);
+        chunk.labels.resize((chunk.samples + 63) / 64);
+        if (is_bad)
+            chunk.labels[i / 64] |= static_cast<blt::u64>(1) << (i % 64);
+        count++;
+        return {chunk.values.data() + i * bins, bins};
+    }
+    
+    void data_storage_t::push_back(const bool is_bad, const blt::span<const Scalar> values)
+    {
+        auto row = emplace_back(values.size(), is_bad);
+        std::copy(values.begin(), values.end(), row.begin());
+    }
+    
+    void data_storage_t::pop_back()
+    {
+        auto& chunk = writable(chunks.size() - 1);
+        const auto i = --chunk.samples;
+        chunk.labels[i / 64] &= ~(static_cast<blt::u64>(1) << (i % 64));
+        chunk.values.resize(chunk.samples * bins);
+        chunk.labels.resize((chunk.samples + 63) / 64);
+        count--;
+        if (chunk.samples == 0)
+        {
+            chunks.pop_back();
+            starts.pop_back();
+        }
+    }
+    
+    void data_storage_t::append(const data_storage_t& o)
+    {
+        if (o.empty())
+            return;
+        if (empty())
+            bins = o.bins;
+        BLT_ASSERT(bins == o.bins);
+        // drop a trailing chunk with nothing in it, left behind by a reserve
+        if (!chunks.empty() && chunks.back()->samples == 0)
+        {
+            chunks.pop_back();
+            starts.pop_back();
+        }
+        for (const auto& chunk : o.chunks)
+        {
+            chunks.push_back(chunk);
+            starts.push_back(count);
+            count += chunk->samples;
+        }
+    }
+    
+    void data_storage_t::clear()
+    {
+        chunks.clear();
+        starts.clear();
+        count = 0;
+        bins = 0;
+    }
+    
+    blt::span<Scalar> data_storage_t::mutable_bins(const blt::size_t index)
+    {
+        const auto [c, i] = locate(index);
+        auto& chunk = writable(c);
+        return {chunk.values.data() + i * bins, bins};
+    }
+    
+    void data_storage_t::set_bad(const blt::size_t index, const bool is_bad)
+    {
+        const auto [c, i] = locate(index);
+        auto& word = writable(c).labels[i / 64];
+        const auto bit = static_cast<blt::u64>(1) << (i % 64);
+        word = is_bad ? word | bit : word & ~bit;
+    }
+    
+    void data_storage_t::resize_bins(const blt::size_t bin_count, const Scalar padding_value)
+    {
+        const auto old_bins = bins;
+        bins = bin_count;
+        if (old_bins == bin_count || empty())
+            return;
+        const auto kept = std::min(old_bins, bin_count);
+        for (blt::size_t c = 0; c < chunks.size(); c++)
+        {
+            if (chunks[c].use_count() > 1)
+            {
+                // copying the shared chunk first and then resizing the copy would hold three buffers at once, build the new rows directly
+                const auto& shared = *chunks[c];
+                auto resized = std::make_shared<chunk_t>();
+                resized->samples = shared.samples;
+                resized->labels = shared.labels;
+                resized->values.resize(shared.samples * bin_count, padding_value);
+                for (blt::size_t r = 0; r < shared.samples; r++)
+                    std::memcpy(resized->values.data() + r * bin_count, shared.values.data() + r * old_bins, kept * sizeof(Scalar));
+                chunks[c] = std::move(resized);
+                continue;
+            }
+            auto& chunk = *chunks[c];
+            auto* values = chunk.values.data();
+            if (bin_count > old_bins)
+            {
+                // rows only ever move towards the back, so going from the last row forwards never overwrites one still to be moved
+                chunk.values.resize(chunk.samples * bin_count);
+                values = chunk.values.data();
+                for (blt::size_t r = chunk.samples; r-- > 0;)
+                {
+                    std::memmove(values + r * bin_count, values + r * old_bins, old_bins * sizeof(Scalar));
+                    std::fill(values + r * bin_count + old_bins, values + (r + 1) * bin_count, padding_value);
+                }
+            }
+            else
+            {
+                for (blt::size_t r = 0; r < chunk.samples; r++)
+                    std::memmove(values + r * bin_count, values + r * old_bins, bin_count * sizeof(Scalar));
+                chunk.values.resize(chunk.samples * bin_count);
+            }
+        }
+    }
+    
     data_file_t data_file_t::normalize() const
     {
         auto copy = *this;
-        
-        for (auto& v : copy.data_points)
-            v = v.normalize();
-        
+        copy.normalize_in_place();
         return copy;
     }
     
     data_file_t data_file_t::with_padding(blt::size_t desired_size, Scalar padding_value) const
     {
         auto copy = *this;
-        
-        for (auto& v : copy.data_points)
-            v = v.with_padding(desired_size, padding_value);
-        
+        copy.pad_in_place(desired_size, padding_value);
         return copy;
     }
     
+    data_file_t& data_file_t::normalize_in_place()
+    {
+        const auto bins = data_points.bin_count();
+        data_points.for_each_chunk([bins](Scalar* values, const blt::size_t samples) {
+            for (blt::size_t r = 0; r < samples; r++)
+            {
+                auto* row = values + r * bins;
+                Scalar total = 0;
+                for (blt::size_t i = 0; i < bins; i++)
+                    total += row[i] * row[i];
+                const auto mag = std::sqrt(total);
+                for (blt::size_t i = 0; i < bins; i++)
+                    row[i] /= mag;
+            }
+        });
+        return *this;
+    }
+    
+    data_file_t& data_file_t::pad_in_place(const blt::size_t desired_size, const Scalar padding_value)
+    {
+        if (data_points.bin_count() < desired_size)
+            data_points.resize_bins(desired_size, padding_value);
+        return *this;
+    }
+    
+    Scalar data_file_t::total_weight() const
+    {
+        if (weights.empty())
+            return static_cast<Scalar>(data_points.size());
+        Scalar total = 0;
+        for (auto v : weights)
+            total += v;
+        return total;
+    }
+    
+    void data_file_t::format_samples(std::string& out, const int decimals) const
+    {
+        char buffer[64];
+        for (const auto point : data_points)
+        {
+            out += point.is_bad ? '1' : '0';
+            for (const auto v : point.bins)
+            {
+                buffer[0] = ' ';
+                const auto [end, ec] = decimals < 0
+                                           ? std::to_chars(buffer + 1, buffer + sizeof(buffer), v)
+                                           : std::to_chars(buffer + 1, buffer + sizeof(buffer), v, std::chars_format::fixed, decimals);
+                out.append(buffer, ec == std::errc{} ? end : buffer + 1);
+            }
+            out += " \n";
+        }
+    }
+    
+    bool data_file_t::write(const std::string& path, const int decimals) const
+    {
+        std::ofstream out{path, std::ios::binary};
+        if (!out)
+        {
+            BLT_WARN("Unable to open '%s' for writing", path.c_str());
+            return false;
+        }
+        std::string text = std::to_string(data_points.size()) + ' ' + std::to_string(data_points.bin_count()) + " \n";
+        format_samples(text, decimals);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        return static_cast<bool>(out);
+    }
+    
     data_file_t& data_file_t::operator+=(const data_file_t& o)
     {
-        data_points.insert(data_points.end(), o.data_points.begin(), o.data_points.end());
+        if (!weights.empty() || !o.weights.empty())
+        {
+            weights.resize(data_points.size(), 1);
+            if (o.weights.empty())
+                weights.resize(data_points.size() + o.data_points.size(), 1);
+            else
+                weights.insert(weights.end(), o.weights.begin(), o.weights.end());
+        }
+        data_points.append(o.data_points);
         return *this;
     }
     
     data_file_t operator+(const data_file_t& a, const data_file_t& b)
     {
         data_file_t file = a;
-        file.data_points.insert(file.data_points.end(), b.data_points.begin(), b.data_points.end());
+        file += b;
         return file;
     }
     
-    partitioned_dataset_t dataset_partitioner::partition(blt::size_t groups) const
+    data_file_t data_file_t::gather(const std::vector<blt::size_t>& indices) const
     {
-        std::vector<data_t> good_data;
-        std::vector<data_t> bad_data;
-        
-        for (const auto& f : files)
+        data_file_t file;
+        file.data_points.reserve(indices.size(), data_points.bin_count());
+        if (!weights.empty())
+            file.weights.reserve(indices.size());
+        for (const auto i : indices)
         {
-            for (const auto& v : f.data_points)
-            {
-                if (v.is_bad)
-                    bad_data.push_back(v);
-                else
-                    good_data.push_back(v);
-            }
+            file.data_points.push_back(data_points[i]);
+            if (!weights.empty())
+                file.weights.push_back(weights[i]);
+        }
+        return file;
+    }
+    
+    data_file_t partitioned_dataset_t::without(const blt::size_t group) const
+    {
+        data_file_t file;
+        for (const auto& [i, g] : blt::enumerate(groups))
+        {
+            if (i != group)
+                file += g;
+        }
+        return file;
+    }
+    
+    std::vector<std::vector<blt::size_t>> dataset_partitioner::partition_indices(const blt::size_t groups, const blt::size_t seed) const
+    {
+        std::vector<blt::size_t> good_data;
+        std::vector<blt::size_t> bad_data;
+        for (const auto& [i, v] : blt::enumerate(data.data_points))
+        {
+            if (v.is_bad)
+                bad_data.push_back(i);
+            else
+                good_data.push_back(i);
         }
         
-        blt::random::random_t rand{std::random_device{}()};
+        blt::random::random_t rand{seed};
         
         std::shuffle(good_data.begin(), good_data.end(), rand);
         std::shuffle(bad_data.begin(), bad_data.end(), rand);
         
-        std::vector<data_file_t> grouped_data;
-        grouped_data.resize(groups);
+        std::vector<std::vector<blt::size_t>> grouped(groups);
         
         blt::size_t insert_group = 0;
-        for (const auto& good : good_data)
-            grouped_data[insert_group++ % groups].data_points.push_back(good);
+        for (const auto good : good_data)
+            grouped[insert_group++ % groups].push_back(good);
         
-        for (const auto& bad : bad_data)
-            grouped_data[insert_group++ % groups].data_points.push_back(bad);
+        for (const auto bad : bad_data)
+            grouped[insert_group++ % groups].push_back(bad);
         
+        return grouped;
+    }
+    
+    partitioned_dataset_t dataset_partitioner::partition(const blt::size_t groups, const blt::size_t seed) const
+    {
+        std::vector<data_file_t> grouped_data;
+        for (const auto& indices : partition_indices(groups, seed))
+            grouped_data.push_back(data.gather(indices));
         return partitioned_dataset_t{std::move(grouped_data)};
     }
     
+    partitioned_dataset_t dataset_partitioner::partition(const blt::size_t groups) const
+    {
+        return partition(groups, std::random_device{}());
+    }
+    
+    padded_dataset_t& padded_dataset_t::with(const data_file_t& file)
+    {
+        if (file.data_points.empty())
+            return *this;
+        files.push_back(file);
+        starts.push_back(count);
+        count += file.data_points.size();
+        bins = std::max(bins, file.data_points.bin_count());
+        
+        cuts.clear();
+        for (const auto& f : files)
+            cuts.push_back(f.data_points.bin_count());
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+        return *this;
+    }
+    
+    std::pair<blt::size_t, blt::size_t> padded_dataset_t::locate(const blt::size_t index) const
+    {
+        const auto f = static_cast<blt::size_t>(std::upper_bound(starts.begin(), starts.end(), index) - starts.begin()) - 1;
+        return {f, index - starts[f]};
+    }
+    
+    padded_view_t padded_dataset_t::operator[](const blt::size_t index) const
+    {
+        const auto [f, i] = locate(index);
+        const auto point = files[f].data_points[i];
+        return {point.is_bad, point.bins, bins, padding};
+    }
+    
+    Scalar padded_dataset_t::weight(const blt::size_t index) const
+    {
+        const auto [f, i] = locate(index);
+        return files[f].weight(i);
+    }
+    
+    Scalar padded_dataset_t::total_weight() const
+    {
+        Scalar total = 0;
+        for (const auto& f : files)
+            total += f.total_weight();
+        return total;
+    }
+    
+    data_file_t padded_dataset_t::materialize(const blt::size_t first, const blt::size_t count) const
+    {
+        std::vector<blt::size_t> indices(count);
+        std::iota(indices.begin(), indices.end(), first);
+        return materialize(indices);
+    }
+    
+    data_file_t padded_dataset_t::materialize(const std::vector<blt::size_t>& indices) const
+    {
+        data_file_t file;
+        file.data_points.reserve(indices.size(), bins);
+        bool weighted = false;
+        for (const auto& f : files)
+            weighted |= !f.weights.empty();
+        for (const auto i : indices)
+        {
+            const auto point = (*this)[i];
+            auto out = file.data_points.emplace_back(bins, point.is_bad);
+            std::copy(point.bins.begin(), point.bins.end(), out.begin());
+            std::fill(out.begin() + static_cast<std::ptrdiff_t>(point.bins.size()), out.end(), padding);
+            if (weighted)
+                file.weights.push_back(weight(i));
+        }
+        return file;
+    }
+    
+    data_file_t padded_dataset_t::sample(const blt::size_t count, const blt::size_t seed) const
+    {
+        if (count >= this->count)
+            return materialize(0, this->count);
+        
+        blt::random::random_t rand{seed};
+        std::uniform_int_distribution<blt::size_t> dist{0, this->count - 1};
+        std::vector<blt::size_t> picked(count);
+        for (auto& index : picked)
+            index = dist(rand);
+        std::sort(picked.begin(), picked.end());
+        return materialize(picked);
+    }
+    
     void save_as_csv(const std::string& file, const std::vector<std::pair<std::string, std::vector<Scalar>>>& data)
     {
         std::ofstream stream{file};
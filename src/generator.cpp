@@ -0,0 +1,193 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/generator.h>
+#include <assign3/binary_file.h>
+#include <assign3/spectrum.h>
+#include <assign3/thread_pool.h>
+#include <blt/std/random.h>
+#include <blt/std/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+
+namespace assign3
+{
+    // samples generated (and formatted) by one task
+    static constexpr blt::size_t block_samples = 4096;
+    // fraction of the within class variation of each bin applied as noise, the mixing of two real spectra supplies the rest
+    static constexpr Scalar noise_fraction = 0.5;
+
+    // splitmix64, decorrelates the per sample seeds so neighbouring samples don't get related random streams
+    static blt::u64 mix_seed(blt::u64 value)
+    {
+        value += 0x9E3779B97F4A7C15ull;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    std::optional<spectrum_generator_t> spectrum_generator_t::from_file(const data_file_t& source, const blt::size_t bins, const Scalar bad_ratio,
+                                                                        const blt::size_t seed)
+    {
+        spectrum_generator_t generator;
+        generator.bins = bins;
+        generator.bad_ratio = std::clamp(bad_ratio, static_cast<Scalar>(0), static_cast<Scalar>(1));
+        generator.seed = seed;
+        for (const auto point : source.data_points)
+        {
+            const std::vector<Scalar> values(point.bins.begin(), point.bins.end());
+            generator.spectra[point.is_bad ? 1 : 0].push_back(resample_spectrum(values, bins));
+        }
+        if (generator.spectra[0].empty() || generator.spectra[1].empty())
+        {
+            BLT_WARN("Generating data needs at least one good and one bad sample to start from");
+            return {};
+        }
+
+        for (blt::size_t h = 0; h < 2; h++)
+        {
+            const auto& class_spectra = generator.spectra[h];
+            auto& sigma = generator.sigmas[h];
+            sigma.resize(bins);
+            for (blt::size_t b = 0; b < bins; b++)
+            {
+                double mean = 0, squares = 0;
+                for (const auto& spectrum : class_spectra)
+                {
+                    mean += spectrum[b];
+                    squares += static_cast<double>(spectrum[b]) * spectrum[b];
+                }
+                mean /= static_cast<double>(class_spectra.size());
+                const auto variance = std::max(squares / static_cast<double>(class_spectra.size()) - mean * mean, 0.0);
+                // a log-normal with this sigma has the same coefficient of variation as the bin
+                const auto cv2 = mean > 0 ? variance / (mean * mean) : 0.0;
+                sigma[b] = noise_fraction * static_cast<Scalar>(std::sqrt(std::log1p(cv2)));
+            }
+        }
+        return generator;
+    }
+
+    bool spectrum_generator_t::is_bad(const blt::size_t sample) const
+    {
+        blt::random::random_t rand{mix_seed(mix_seed(seed) ^ (sample * 2))};
+        return rand.get_double() < bad_ratio;
+    }
+
+    data_file_t spectrum_generator_t::generate(const blt::size_t first, const blt::size_t count) const
+    {
+        data_file_t data;
+        data.data_points.reserve(count, bins);
+        std::normal_distribution<Scalar> normal{0, 1};
+        for (blt::size_t sample = first; sample < first + count; sample++)
+        {
+            const auto bad = is_bad(sample);
+            const auto h = bad ? 1 : 0;
+            const auto& class_spectra = spectra[h];
+            blt::random::random_t rand{mix_seed(mix_seed(seed) ^ (sample * 2 + 1))};
+            normal.reset();
+
+            std::uniform_int_distribution<blt::size_t> pick{0, class_spectra.size() - 1};
+            const auto& a = class_spectra[pick(rand)];
+            const auto& b = class_spectra[pick(rand)];
+            const auto t = static_cast<Scalar>(rand.get_double());
+            const auto gain = std::exp(static_cast<Scalar>(0.1) * normal(rand));
+
+            auto row = data.data_points.emplace_back(bins, bad);
+            for (blt::size_t i = 0; i < bins; i++)
+            {
+                const auto sigma = sigmas[h][i];
+                // mean preserving, the noise scales the bin without shifting its expected value
+                const auto noise = std::exp(sigma * normal(rand) - sigma * sigma / 2);
+                row[i] = gain * (t * a[i] + (1 - t) * b[i]) * noise;
+            }
+        }
+        return data;
+    }
+
+    template <typename Make, typename Write>
+    bool spectrum_generator_t::write_blocks(const blt::size_t samples, Make&& make, Write&& write) const
+    {
+        auto& pool = thread_pool_t::shared();
+        const auto blocks = (samples + block_samples - 1) / block_samples;
+        // a few blocks per thread are in memory at once, however large the file is
+        const auto batch = std::max(pool.concurrency(), static_cast<blt::size_t>(1)) * 4;
+        std::vector<decltype(make(0, 0))> generated(batch);
+        for (blt::size_t first_block = 0; first_block < blocks; first_block += batch)
+        {
+            const auto count = std::min(batch, blocks - first_block);
+            pool.parallel_for(count, 1, [&](const blt::size_t begin, const blt::size_t end) {
+                for (blt::size_t i = begin; i < end; i++)
+                {
+                    const auto first = (first_block + i) * block_samples;
+                    generated[i] = make(first, std::min(block_samples, samples - first));
+                }
+            });
+            for (blt::size_t i = 0; i < count; i++)
+            {
+                if (!write(generated[i]))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool spectrum_generator_t::write_text(const std::string& path, const blt::size_t samples) const
+    {
+        std::ofstream out{path, std::ios::binary};
+        if (!out)
+        {
+            BLT_WARN("Unable to open '%s' for writing", path.c_str());
+            return false;
+        }
+        out << samples << ' ' << bins << " \n";
+
+        // formatting is the slow part so it happens on the worker threads too
+        const auto format = [this](const blt::size_t first, const blt::size_t count) {
+            std::string text;
+            // synthetic samples look like the bundled files, two decimal places
+            generate(first, count).format_samples(text, 2);
+            return text;
+        };
+        const auto ok = write_blocks(samples, format, [&out](const std::string& text) {
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+            return static_cast<bool>(out);
+        });
+        if (!ok || !out)
+        {
+            BLT_WARN("Unable to write '%s'", path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool spectrum_generator_t::write_binary(const std::string& path, const blt::size_t samples, const blt::size_t precision) const
+    {
+        // the labels come before the bins, they are cheap to draw on their own
+        std::vector<blt::u64> labels((samples + 63) / 64);
+        for (blt::size_t i = 0; i < samples; i++)
+        {
+            if (is_bad(i))
+                labels[i / 64] |= static_cast<blt::u64>(1) << (i % 64);
+        }
+        binary_data_writer_t writer{path, samples, bins, labels, {}, precision};
+        write_blocks(samples, [this](const blt::size_t first, const blt::size_t count) { return generate(first, count); },
+                     [&writer](const data_file_t& block) { return writer.write(block); });
+        return writer.finish();
+    }
+}
@@ -0,0 +1,177 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/history.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace assign3
+{
+    template <typename T>
+    static Scalar quantize(const Scalar* values, const Scalar* base, const blt::size_t count, T* out)
+    {
+        Scalar largest = 0;
+        for (blt::size_t i = 0; i < count; i++)
+            largest = std::max(largest, std::abs(values[i] - base[i]));
+        const auto scale = largest / static_cast<Scalar>(std::numeric_limits<T>::max());
+        for (blt::size_t i = 0; i < count; i++)
+            out[i] = scale > 0 ? static_cast<T>(std::lround((values[i] - base[i]) / scale)) : T{0};
+        return scale;
+    }
+
+    template <typename T>
+    static void dequantize(const T* deltas, const Scalar* base, const Scalar scale, const blt::size_t count, Scalar* out)
+    {
+        for (blt::size_t i = 0; i < count; i++)
+            out[i] = base[i] + static_cast<Scalar>(deltas[i]) * scale;
+    }
+
+    blt::size_t codebook_history_t::frame_t::bytes() const
+    {
+        return sizeof(frame_t) + (codebook.size() + activations.size() + codebook_scales.size()) * sizeof(Scalar) +
+               codebook_deltas.size() * sizeof(blt::i8) + activation_deltas.size() * sizeof(blt::i16);
+    }
+
+    codebook_history_t::codebook_history_t(const blt::size_t keyframe_interval, const blt::size_t memory_budget):
+        keyframe_interval(std::max(keyframe_interval, static_cast<blt::size_t>(1))), memory_budget(memory_budget)
+    {}
+
+    void codebook_history_t::begin(const blt::size_t neurons, const blt::size_t dimensions)
+    {
+        this->neurons = neurons;
+        this->dimensions = dimensions;
+        stride = 1;
+        since_keyframe = 0;
+        memory = 0;
+        frames.clear();
+    }
+
+    void codebook_history_t::record(const blt::size_t epoch, const std::vector<Scalar>& codebook, const std::vector<Scalar>& activations)
+    {
+        if (codebook.size() != neurons * dimensions || activations.size() != neurons)
+            return;
+        if (epoch % stride != 0 || (!frames.empty() && epoch <= frames.back().epoch))
+            return;
+
+        frame_t frame;
+        frame.epoch = epoch;
+        const auto* key = frames.empty() ? nullptr : find_keyframe(frames.back().key_epoch);
+        if (key == nullptr || since_keyframe >= keyframe_interval)
+        {
+            frame.key_epoch = epoch;
+            frame.codebook = codebook;
+            frame.activations = activations;
+            since_keyframe = 0;
+        } else
+        {
+            frame.key_epoch = key->epoch;
+            frame.codebook_deltas.resize(codebook.size());
+            frame.codebook_scales.resize(neurons);
+            for (blt::size_t n = 0; n < neurons; n++)
+            {
+                const auto offset = n * dimensions;
+                frame.codebook_scales[n] = quantize(codebook.data() + offset, key->codebook.data() + offset, dimensions,
+                                                    frame.codebook_deltas.data() + offset);
+            }
+            frame.activation_deltas.resize(neurons);
+            frame.activation_scale = quantize(activations.data(), key->activations.data(), neurons, frame.activation_deltas.data());
+        }
+        since_keyframe++;
+        memory += frame.bytes();
+        frames.push_back(std::move(frame));
+
+        if (memory_budget > 0 && memory > memory_budget)
+            thin();
+    }
+
+    std::optional<blt::size_t> codebook_history_t::reconstruct(const blt::size_t epoch, std::vector<Scalar>& codebook,
+                                                               std::vector<Scalar>& activations) const
+    {
+        auto it = std::upper_bound(frames.begin(), frames.end(), epoch, [](const blt::size_t e, const frame_t& frame) {
+            return e < frame.epoch;
+        });
+        if (it == frames.begin())
+            return {};
+        const auto& frame = *(--it);
+
+        if (frame.epoch == frame.key_epoch)
+        {
+            codebook = frame.codebook;
+            activations = frame.activations;
+            return frame.epoch;
+        }
+
+        const auto* key = find_keyframe(frame.key_epoch);
+        codebook.resize(neurons * dimensions);
+        activations.resize(neurons);
+        for (blt::size_t n = 0; n < neurons; n++)
+        {
+            const auto offset = n * dimensions;
+            dequantize(frame.codebook_deltas.data() + offset, key->codebook.data() + offset, frame.codebook_scales[n], dimensions,
+                       codebook.data() + offset);
+        }
+        dequantize(frame.activation_deltas.data(), key->activations.data(), frame.activation_scale, neurons, activations.data());
+        return frame.epoch;
+    }
+
+    const codebook_history_t::frame_t* codebook_history_t::find_keyframe(const blt::size_t epoch) const
+    {
+        auto it = std::lower_bound(frames.begin(), frames.end(), epoch, [](const frame_t& frame, const blt::size_t e) {
+            return frame.epoch < e;
+        });
+        if (it == frames.end() || it->epoch != epoch)
+            return nullptr;
+        return &*it;
+    }
+
+    void codebook_history_t::thin()
+    {
+        // keyframes that are still needed by a frame (or by the next one recorded) have to stay whatever their epoch
+        while (memory > memory_budget)
+        {
+            stride *= 2;
+            std::vector<blt::size_t> referenced;
+            for (const auto& frame : frames)
+            {
+                if (frame.epoch != frame.key_epoch && frame.epoch % stride == 0)
+                    referenced.push_back(frame.key_epoch);
+            }
+            referenced.push_back(frames.back().key_epoch);
+
+            const auto before = frames.size();
+            frames.erase(std::remove_if(frames.begin(), frames.end(), [this, &referenced](const frame_t& frame) {
+                if (frame.epoch % stride == 0)
+                    return false;
+                if (frame.epoch == frame.key_epoch)
+                    return std::find(referenced.begin(), referenced.end(), frame.epoch) == referenced.end();
+                return true;
+            }), frames.end());
+
+            memory = 0;
+            since_keyframe = 0;
+            for (const auto& frame : frames)
+            {
+                memory += frame.bytes();
+                since_keyframe = frame.epoch == frame.key_epoch ? 1 : since_keyframe + 1;
+            }
+            // only keyframes that are still needed are left, and a larger stride can't drop anything else
+            if (frames.size() == before && stride > frames.back().epoch)
+                break;
+        }
+    }
+}
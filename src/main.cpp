@@ -6,12 +6,23 @@
 #include "implot.h"
 #include <assign3/file.h>
 #include <assign3/manager.h>
-#include <thread>
+#include <assign3/projection.h>
+#include <assign3/progressive.h>
+#include <assign3/coreset.h>
+#include <assign3/binary_file.h>
+#include <assign3/stream.h>
+#include <assign3/generator.h>
+#include <assign3/features.h>
+#include <assign3/validation.h>
+#include <assign3/thread_pool.h>
 #include <mutex>
+#include <atomic>
 #include <fstream>
 #include <filesystem>
 #include <cstdlib>
 #include <utility>
+#include <chrono>
+#include <random>
 #include <blt/fs/loader.h>
 
 void plot_heatmap(const std::string& path, const std::string& activations_csv, const blt::size_t bin_size, const std::string& subtitle)
@@ -28,14 +39,16 @@ void plot_heatmap(const std::string& path, const std::string& activations_csv, c
 }
 
 void plot_line_graph(const std::string& path, const std::string& topological_csv, const std::string& quantization_csv, blt::size_t bin_size,
-                     const std::string& subtitle, const std::string& subtitle2)
+                     const std::string& subtitle, const std::string& subtitle2, const std::string& topological_interval_csv = "",
+                     const std::string& quantization_interval_csv = "")
 {
 #ifdef __linux__
     auto pwd = std::filesystem::current_path().string();
     if (!blt::string::ends_with(pwd, '/'))
         pwd += '/';
     const std::string command = "cd '" + path + "' && python3 '" + pwd + "../plot_line_graph.py' \"" + topological_csv + "\" \"" + quantization_csv +
-        "\" " + std::to_string(bin_size) + " true \"" + subtitle + "\" \"" + subtitle2 + "\"";
+        "\" " + std::to_string(bin_size) + " true \"" + subtitle + "\" \"" + subtitle2 + "\"" +
+        (topological_interval_csv.empty() ? "" : " \"" + topological_interval_csv + "\" \"" + quantization_interval_csv + "\"");
     BLT_TRACE(command);
     std::system(command.c_str());
 #endif
@@ -117,6 +130,8 @@ void update(const blt::gfx::window_data& window_data)
 
 void destroy(const blt::gfx::window_data&)
 {
+    // the loader works on the shared pool, which may not outlive the data
+    data.stop();
     global_matrices.cleanup();
     resources.cleanup();
     renderer.cleanup();
@@ -129,10 +144,31 @@ void load_data_files(const std::string& str)
 {
     data.files = assign3::data_file_t::load_data_files_from_path(str);
     for (auto& v : data.files)
-        v = v.normalize();
+        v.normalize_in_place();
     data.update();
 }
 
+projection_type_t parse_projection(const std::string& name)
+{
+    const auto lower = blt::string::toLowerCase(name);
+    if (lower == "sparse" || lower == "random")
+        return projection_type_t::SPARSE_RANDOM;
+    if (lower == "pca")
+        return projection_type_t::RANDOMIZED_PCA;
+    return projection_type_t::NONE;
+}
+
+void add_projection_arguments(blt::arg_parse& parser, const std::string& default_projection = "none")
+{
+    parser.addArgument(blt::arg_builder{"--projection", "-p"}
+                       .setDefault(default_projection)
+                       .setHelp("Reduce the bins before training. Can be: [none, sparse, pca]").build());
+
+    parser.addArgument(blt::arg_builder{"--dims", "-k"}
+                       .setDefault("16")
+                       .setHelp("Number of dimensions to project the data down to").build());
+}
+
 void action_start_graphics(const std::vector<std::string>& argv_vector)
 {
     blt::arg_parse parser{};
@@ -144,9 +180,13 @@ void action_start_graphics(const std::vector<std::string>& argv_vector)
 
     parser.addArgument(blt::arg_builder{"--silly"}.setAction(blt::arg_action_t::STORE_TRUE).setDefault(false).build());
 
+    add_projection_arguments(parser);
+
     auto args = parser.parse_args(argv_vector);
 
-    load_data_files(args.get<std::string>("file"));
+    // the window opens straight away and networks are made as the files arrive
+    data.load_async(args.get<std::string>("file"));
+    renderer.set_projection(parse_projection(args.get<std::string>("projection")), std::stoi(args.get<std::string>("dims")));
 
     silly = args.get<bool>("silly");
 
@@ -176,11 +216,15 @@ struct task_t // NOLINT
     shape_t shape;
     init_t init;
     Scalar initial_learn_rate;
+    std::string prefix{};
+    // bins of the file before it was projected, names the output directory so projected files don't share one
+    blt::size_t source_bins = 0;
 
     task_t() = default; // NOLINT
 
     task_t(data_file_t* file, blt::u32 width, blt::u32 height, size_t maxEpochs, shape_t shape, init_t init, Scalar initial_learn_rate):
-        file(file), width(width), height(height), max_epochs(maxEpochs), shape(shape), init(init), initial_learn_rate(initial_learn_rate)
+        file(file), width(width), height(height), max_epochs(maxEpochs), shape(shape), init(init), initial_learn_rate(initial_learn_rate),
+        source_bins(file->data_points.bin_count())
     {
     }
 
@@ -188,8 +232,47 @@ struct task_t // NOLINT
     std::vector<std::vector<Scalar>> topological_errors{};
     std::vector<std::vector<Scalar>> quantization_errors{};
     std::vector<std::vector<Scalar>> activations{};
+    std::vector<blt::size_t> stop_epochs{};
+    std::vector<std::string> stop_reasons{};
+    // confidence intervals of the errors when they are estimated from a subsample
+    std::vector<std::vector<error_interval_t>> topological_intervals{};
+    std::vector<std::vector<error_interval_t>> quantization_intervals{};
+};
+
+struct early_stop_t
+{
+    bool enabled = false;
+    blt::size_t window = 200;
+    Scalar tolerance = 0.005;
+    Scalar movement = 0.0005;
+
+    [[nodiscard]] std::unique_ptr<convergence_monitor_t> make_monitor() const
+    {
+        if (!enabled)
+            return nullptr;
+        auto monitor = std::make_unique<any_convergence_monitor_t>();
+        monitor->with(std::make_unique<plateau_monitor_t>(window, tolerance))
+                .with(std::make_unique<codebook_movement_monitor_t>(window, movement));
+        return monitor;
+    }
 };
 
+// holds each evaluated value until the next evaluation so curves from any schedule (or runs which stopped early) cover every epoch
+template <typename T>
+std::vector<T> errors_per_epoch(const std::vector<T>& errors, const std::vector<blt::size_t>& error_epochs, blt::size_t max_epochs)
+{
+    std::vector<T> expanded;
+    expanded.reserve(max_epochs + 1);
+    blt::size_t next = 0;
+    for (blt::size_t epoch = 0; epoch <= max_epochs; epoch++)
+    {
+        while (next + 1 < errors.size() && error_epochs[next + 1] <= epoch)
+            next++;
+        expanded.push_back(errors[next]);
+    }
+    return expanded;
+}
+
 struct sortable_data_t
 {
     std::string_view path;
@@ -234,7 +317,8 @@ struct sortable_data_t
 std::string make_path(const task_t& task)
 {
     std::stringstream paths;
-    paths << "bins-" << task.file->data_points.begin()->bins.size() << "/";
+    paths << task.prefix;
+    paths << "bins-" << task.source_bins << "/";
     paths << task.width << "x" << task.height << '-' << task.max_epochs << '/';
     std::string shape_name = shape_names[static_cast<int>(task.shape)];
     std::string init_name = init_names[static_cast<int>(task.init)];
@@ -254,19 +338,110 @@ void action_test(const std::vector<std::string>& argv_vector)
                        .setDefault("../data")
                        .setHelp("Path to data files").build());
 
+    add_projection_arguments(parser);
+
+    parser.addArgument(blt::arg_builder{"--early-stop"}
+                       .setAction(blt::arg_action_t::STORE_TRUE).setDefault(false)
+                       .setHelp("Stop runs once the errors plateau or the codebook stops moving").build());
+
+    parser.addArgument(blt::arg_builder{"--progressive"}
+                       .setAction(blt::arg_action_t::STORE_TRUE).setDefault(false)
+                       .setHelp("Train coarse to fine, starting from a small map and doubling it up to the requested size").build());
+
+    parser.addArgument(blt::arg_builder{"--coreset"}
+                       .setDefault("0")
+                       .setHelp("Compress every file to this many weighted samples before training, 0 trains on the full data").build());
+
+    parser.addArgument(blt::arg_builder{"--evaluate"}
+                       .setDefault("every:1")
+                       .setHelp("Which epochs compute errors. Can be: [every:k, geometric:ratio, final]").build());
+
+    parser.addArgument(blt::arg_builder{"--async"}
+                       .setAction(blt::arg_action_t::STORE_TRUE).setDefault(false)
+                       .setHelp("Evaluate codebook snapshots in the background while training continues").build());
+
+    parser.addArgument(blt::arg_builder{"--estimate"}
+                       .setDefault("0")
+                       .setHelp("Estimate errors from a subsample with a 95 percent confidence interval about this wide (fraction of the data), 0 is exact").build());
+
+    parser.addArgument(blt::arg_builder{"--lattice-activations"}
+                       .setAction(blt::arg_action_t::STORE_TRUE).setDefault(false)
+                       .setHelp("Compute activations by spreading BMU hits over the lattice and log how well they agree with the exact ones").build());
+
+    parser.addArgument(blt::arg_builder{"--drift-tolerance"}
+                       .setDefault("0")
+                       .setHelp("Only re-evaluate neurons whose codebook vector moved further than this since their last evaluation, 0 is exact").build());
+
+    parser.addArgument(blt::arg_builder{"--trace"}
+                       .setAction(blt::arg_action_t::STORE_TRUE).setDefault(false)
+                       .setHelp("Save a BMU trace of every run next to its results, see the replay action").build());
+
+    parser.addArgument(blt::arg_builder{"--umatrix"}
+                       .setAction(blt::arg_action_t::STORE_TRUE).setDefault(false)
+                       .setHelp("Save the U-matrix of every trained map next to its results").build());
+
+    parser.addArgument(blt::arg_builder{"--window"}
+                       .setDefault("200")
+                       .setHelp("Number of epochs the errors / codebook must stay settled for before stopping").build());
+
+    parser.addArgument(blt::arg_builder{"--tolerance"}
+                       .setDefault("0.005")
+                       .setHelp("Largest change in error (as a fraction) considered a plateau").build());
+
+    parser.addArgument(blt::arg_builder{"--movement"}
+                       .setDefault("0.0005")
+                       .setHelp("Largest RMS codebook movement per epoch considered settled").build());
+
     auto args = parser.parse_args(argv_vector);
 
     load_data_files(args.get<std::string>("file"));
 
+    early_stop_t early_stop;
+    early_stop.enabled = args.get<bool>("early-stop");
+    early_stop.window = std::stoul(args.get<std::string>("window"));
+    early_stop.tolerance = std::stof(args.get<std::string>("tolerance"));
+    early_stop.movement = std::stof(args.get<std::string>("movement"));
+
+    const auto progressive = args.get<bool>("progressive");
+    const auto schedule = evaluation_schedule_t::parse(args.get<std::string>("evaluate"));
+    const auto async = args.get<bool>("async");
+    const auto estimate_width = std::stof(args.get<std::string>("estimate"));
+    const auto drift_tolerance = std::stof(args.get<std::string>("drift-tolerance"));
+    const auto activation_mode = args.get<bool>("lattice-activations") ? activation_mode_t::LATTICE : activation_mode_t::EXACT;
+    const auto record_trace = args.get<bool>("trace");
+    const auto write_u_matrix = args.get<bool>("umatrix");
+
+    std::string prefix = progressive ? "progressive/" : "";
+    std::vector<blt::size_t> source_bins;
+    for (const auto& file : data.files)
+        source_bins.push_back(file.data_points.bin_count());
+    const auto projection_type = parse_projection(args.get<std::string>("projection"));
+    if (projection_type != projection_type_t::NONE)
+    {
+        const auto dims = std::stoul(args.get<std::string>("dims"));
+        for (auto& file : data.files)
+            file = projection_t::make(projection_type, file, dims, std::random_device{}()).project(file);
+        std::string projection_name = projection_names[static_cast<int>(projection_type)];
+        blt::string::replaceAll(projection_name, " ", "-");
+        prefix += projection_name + "-" + std::to_string(dims) + "/";
+    }
+
+    if (const auto coreset_size = std::stoul(args.get<std::string>("coreset")); coreset_size > 0)
+    {
+        for (auto& file : data.files)
+            file = build_coreset(file, coreset_size, std::random_device{}());
+        prefix += "coreset-" + std::to_string(coreset_size) + "/";
+    }
+
     std::vector<task_t> tasks;
-    std::vector<std::thread> threads;
     std::mutex task_mutex;
 
     // tasks.emplace_back(&data.files.back(), 5, 5, 2000, shape_t::GRID, init_t::COMPLETELY_RANDOM, 1);
     // tasks.emplace_back(&data.files.back(), 5, 5, 2000, shape_t::GRID, init_t::RANDOM_DATA, 1);
     // tasks.emplace_back(&data.files.back(), 5, 5, 2000, shape_t::GRID, init_t::SAMPLED_DATA, 1);
-    for (auto& file : data.files)
+    for (blt::size_t i = 0; i < data.files.size(); i++)
     {
+        auto& file = data.files[i];
         for (blt::u32 size = 5; size <= 7; size++)
         {
             for (int shape = 0; shape < 4; shape++)
@@ -274,6 +449,8 @@ void action_test(const std::vector<std::string>& argv_vector)
                 for (int init = 0; init < 3; init++)
                 {
                     tasks.emplace_back(&file, size, size, 2000, static_cast<shape_t>(shape), static_cast<init_t>(init), 1);
+                    tasks.back().prefix = prefix;
+                    tasks.back().source_bins = source_bins[i];
                 }
             }
         }
@@ -282,235 +459,759 @@ void action_test(const std::vector<std::string>& argv_vector)
 
     static blt::size_t runs = 30;
 
-    for (blt::size_t _ = 0; _ < std::thread::hardware_concurrency(); _++)
+    auto& pool = thread_pool_t::shared();
+    pool.run(pool.concurrency(), [&task_mutex, &tasks, early_stop, progressive, schedule, async, estimate_width, drift_tolerance,
+                                  activation_mode, record_trace, write_u_matrix](blt::size_t)
     {
-        threads.emplace_back([&task_mutex, &tasks]()
+        do
         {
-            do
+            task_t task;
             {
-                task_t task;
-                {
-                    std::scoped_lock lock(task_mutex);
-                    if (tasks.empty())
-                        break;
-                    task = std::move(tasks.back());
-                    tasks.pop_back();
-                }
+                std::scoped_lock lock(task_mutex);
+                if (tasks.empty())
+                    break;
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            }
 
-                bool do_run = false;
-                if (do_run)
+            bool do_run = false;
+            if (do_run)
+            {
+                for (blt::size_t run = 0; run < runs; run++)
                 {
-                    for (blt::size_t run = 0; run < runs; run++)
+                    std::unique_ptr<distance_function_t> dist;
+                    std::unique_ptr<som_t> direct;
+                    std::unique_ptr<progressive_trainer_t> trainer;
+                    if (progressive)
+                        trainer = std::make_unique<progressive_trainer_t>(*task.file, task.width, task.height, task.max_epochs,
+                                                                          &task.topology_func, task.shape, task.init, false);
+                    else
                     {
-                        gaussian_function_t func{};
-                        auto dist = distance_function_t::from_shape(task.shape, task.width, task.height);
-                        auto som = std::make_unique<som_t>(*task.file, task.width, task.height, task.max_epochs, dist.get(),
-                                                           &task.topology_func, task.shape, task.init, false);
-                        while (som->get_current_epoch() < som->get_max_epochs())
+                        dist = distance_function_t::from_shape(task.shape, task.width, task.height);
+                        direct = std::make_unique<som_t>(*task.file, task.width, task.height, task.max_epochs, dist.get(),
+                                                         &task.topology_func, task.shape, task.init, false);
+                    }
+                    som_t* som = trainer ? &trainer->get_som() : direct.get();
+
+                    auto monitor = early_stop.make_monitor();
+                    som->set_convergence_monitor(monitor.get());
+                    som->set_evaluation_schedule(schedule);
+                    som->set_async_evaluation(async);
+                    som->set_error_estimation(estimate_width);
+                    som->set_drift_tolerance(drift_tolerance);
+                    som->set_activation_mode(activation_mode);
+                    bmu_trace_t trace;
+                    if (record_trace)
+                        som->set_trace(&trace);
+                    while (!som->is_finished())
+                    {
+                        if (trainer)
+                            trainer->train_epoch(task.initial_learn_rate);
+                        else
                             som->train_epoch(task.initial_learn_rate);
-
-                        task.topological_errors.push_back(som->get_topological_errors());
-                        task.quantization_errors.push_back(som->get_quantization_errors());
-
-                        std::vector<Scalar> acts;
-                        for (const auto& v : som->get_array().get_map())
-                            acts.push_back(v.get_activation());
-                        task.activations.emplace_back(std::move(acts));
                     }
-                }
-                auto path = make_path(task);
-                std::filesystem::create_directories(path);
-
-                std::vector<Scalar> average_topological_errors;
-                std::vector<Scalar> average_quantization_errors;
-                std::vector<Scalar> average_activations;
-                std::vector<Scalar> stddev_topological_errors;
-                std::vector<Scalar> stddev_quantization_errors;
-                std::vector<Scalar> min_topological_errors;
-                std::vector<Scalar> min_quantization_errors;
-                std::vector<Scalar> last_topological_errors;
-                std::vector<Scalar> last_quantization_errors;
-
-                if (do_run)
-                {
-                    average_topological_errors.resize(task.topological_errors.begin()->size());
-                    average_quantization_errors.resize(task.quantization_errors.begin()->size());
-                    average_activations.resize(task.activations.begin()->size());
-                    stddev_topological_errors.resize(task.topological_errors.begin()->size());
-                    stddev_quantization_errors.resize(task.quantization_errors.begin()->size());
-
-                    min_topological_errors.resize(runs);
-                    min_quantization_errors.resize(runs);
-                    last_topological_errors.resize(runs);
-                    last_quantization_errors.resize(runs);
-
-                    for (auto [i, v] : blt::enumerate(task.topological_errors))
+
+                    // runs which stopped early hold their last value so every curve covers the same epochs when averaged
+                    // where they actually stopped is kept in stop_epochs.csv
+                    task.topological_errors.emplace_back(errors_per_epoch(som->get_topological_errors(), som->get_error_epochs(),
+                                                                          task.max_epochs));
+                    task.quantization_errors.emplace_back(errors_per_epoch(som->get_quantization_errors(), som->get_error_epochs(),
+                                                                           task.max_epochs));
+                    task.topological_intervals.emplace_back(errors_per_epoch(som->get_topological_error_intervals(), som->get_error_epochs(),
+                                                                             task.max_epochs));
+                    task.quantization_intervals.emplace_back(errors_per_epoch(som->get_quantization_error_intervals(), som->get_error_epochs(),
+                                                                              task.max_epochs));
+                    if (record_trace)
                     {
-                        min_topological_errors[i] = *std::min_element(v.begin(), v.end());
-                        last_topological_errors[i] = v.back();
+                        som->set_trace(nullptr);
+                        const auto trace_path = make_path(task);
+                        std::filesystem::create_directories(trace_path);
+                        std::ofstream trace_file{trace_path + "trace-" + std::to_string(run) + ".bin", std::ios::binary};
+                        trace.write(trace_file);
                     }
-                    for (auto [i, v] : blt::enumerate(task.quantization_errors))
+                    if (write_u_matrix)
                     {
-                        min_quantization_errors[i] = *std::min_element(v.begin(), v.end());
-                        last_quantization_errors[i] = v.back();
+                        const auto u_matrix_path = make_path(task);
+                        std::filesystem::create_directories(u_matrix_path);
+                        std::ofstream u_matrix_file{u_matrix_path + "u_matrix-" + std::to_string(run) + ".csv"};
+                        som->write_u_matrix(u_matrix_file);
                     }
+                    if (activation_mode == activation_mode_t::LATTICE)
+                        BLT_INFO("Run %ld of '%s': lattice activations classify %f of the neurons like the exact ones", run,
+                                 make_path(task).c_str(), som->activation_agreement());
+                    task.stop_epochs.push_back(som->get_current_epoch());
+                    task.stop_reasons.push_back(som->get_stop_reason());
+
+                    std::vector<Scalar> acts;
+                    for (const auto& v : som->get_array().get_map())
+                        acts.push_back(v.get_activation());
+                    task.activations.emplace_back(std::move(acts));
+                }
+            }
+            auto path = make_path(task);
+            std::filesystem::create_directories(path);
+
+            std::vector<Scalar> average_topological_errors;
+            std::vector<Scalar> average_quantization_errors;
+            std::vector<Scalar> average_activations;
+            std::vector<Scalar> stddev_topological_errors;
+            std::vector<Scalar> stddev_quantization_errors;
+            std::vector<Scalar> min_topological_errors;
+            std::vector<Scalar> min_quantization_errors;
+            std::vector<Scalar> last_topological_errors;
+            std::vector<Scalar> last_quantization_errors;
+
+            if (do_run)
+            {
+                average_topological_errors.resize(task.topological_errors.begin()->size());
+                average_quantization_errors.resize(task.quantization_errors.begin()->size());
+                average_activations.resize(task.activations.begin()->size());
+                stddev_topological_errors.resize(task.topological_errors.begin()->size());
+                stddev_quantization_errors.resize(task.quantization_errors.begin()->size());
+
+                min_topological_errors.resize(runs);
+                min_quantization_errors.resize(runs);
+                last_topological_errors.resize(runs);
+                last_quantization_errors.resize(runs);
+
+                for (auto [i, v] : blt::enumerate(task.topological_errors))
+                {
+                    min_topological_errors[i] = *std::min_element(v.begin(), v.end());
+                    last_topological_errors[i] = v.back();
+                }
+                for (auto [i, v] : blt::enumerate(task.quantization_errors))
+                {
+                    min_quantization_errors[i] = *std::min_element(v.begin(), v.end());
+                    last_quantization_errors[i] = v.back();
+                }
 
+                for (const auto& vec : task.topological_errors)
+                    for (auto [index, v] : blt::enumerate(vec))
+                        average_topological_errors[index] += v;
+                for (const auto& vec : task.quantization_errors)
+                    for (auto [index, v] : blt::enumerate(vec))
+                        average_quantization_errors[index] += v;
+                for (const auto& vec : task.activations)
+                    for (auto [index, v] : blt::enumerate(vec))
+                        average_activations[index] += v;
+
+                // calculate mean per point
+                for (auto& v : average_topological_errors)
+                    v /= static_cast<Scalar>(runs);
+                for (auto& v : average_quantization_errors)
+                    v /= static_cast<Scalar>(runs);
+
+                for (auto [i, mean] : blt::in_pairs(average_topological_errors, average_quantization_errors).enumerate())
+                {
+                    auto [t_mean, q_mean] = mean;
+                    float variance_t = 0;
+                    float variance_q = 0;
                     for (const auto& vec : task.topological_errors)
-                        for (auto [index, v] : blt::enumerate(vec))
-                            average_topological_errors[index] += v;
+                    {
+                        auto d = vec[i] - t_mean;
+                        variance_t += d * d;
+                    }
                     for (const auto& vec : task.quantization_errors)
-                        for (auto [index, v] : blt::enumerate(vec))
-                            average_quantization_errors[index] += v;
-                    for (const auto& vec : task.activations)
-                        for (auto [index, v] : blt::enumerate(vec))
-                            average_activations[index] += v;
-
-                    // calculate mean per point
-                    for (auto& v : average_topological_errors)
-                        v /= static_cast<Scalar>(runs);
-                    for (auto& v : average_quantization_errors)
-                        v /= static_cast<Scalar>(runs);
-
-                    for (auto [i, mean] : blt::in_pairs(average_topological_errors, average_quantization_errors).enumerate())
                     {
-                        auto [t_mean, q_mean] = mean;
-                        float variance_t = 0;
-                        float variance_q = 0;
-                        for (const auto& vec : task.topological_errors)
-                        {
-                            auto d = vec[i] - t_mean;
-                            variance_t += d * d;
-                        }
-                        for (const auto& vec : task.quantization_errors)
+                        auto d = vec[i] - q_mean;
+                        variance_q += d * d;
+                    }
+                    variance_t /= static_cast<Scalar>(runs);
+                    variance_q /= static_cast<Scalar>(runs);
+                    stddev_topological_errors[i] = std::sqrt(variance_t);
+                    stddev_quantization_errors[i] = std::sqrt(variance_q);
+                }
+            }
+            else
+            {
+                load_csv(average_topological_errors, path + "topological_avg.csv");
+                load_csv(average_quantization_errors, path + "quantization_avg.csv");
+                load_csv(average_activations, path + "activations_avg.csv");
+                load_csv(stddev_topological_errors, path + "topological_stddev.csv");
+                load_csv(stddev_quantization_errors, path + "quantization_stddev.csv");
+                load_csv(min_topological_errors, path + "min_topological.csv");
+                load_csv(min_quantization_errors, path + "min_quantization.csv");
+                load_csv(last_topological_errors, path + "last_topological.csv");
+                load_csv(last_quantization_errors, path + "last_quantization.csv");
+            }
+
+            Scalar avg_quantization_stddev = 0;
+            Scalar avg_topological_stddev = 0;
+
+            for (auto [q, t] : blt::in_pairs(stddev_quantization_errors, stddev_topological_errors))
+            {
+                avg_quantization_stddev += q;
+                avg_topological_stddev += t;
+            }
+
+            avg_quantization_stddev /= static_cast<Scalar>(task.max_epochs);
+            avg_topological_stddev /= static_cast<Scalar>(task.max_epochs);
+
+            auto min_quant =
+                *std::min_element(average_quantization_errors.begin(), average_quantization_errors.end());
+            auto max_quant =
+                *std::max_element(average_quantization_errors.begin(), average_quantization_errors.end());
+
+            auto min_topo = *std::min_element(average_topological_errors.begin(), average_topological_errors.end());
+            auto max_topo = *std::max_element(average_topological_errors.begin(), average_topological_errors.end());
+
+            if (do_run)
+            {
+                std::ofstream topological{path + "topological_avg.csv"};
+                std::ofstream quantization{path + "quantization_avg.csv"};
+                std::ofstream activations_avg{path + "activations_avg.csv"};
+                std::ofstream activations{path + "activations.csv"};
+                std::ofstream topological_stddev{path + "topological_stddev.csv"};
+                std::ofstream quantization_stddev{path + "quantization_stddev.csv"};
+
+                write_csv(min_topological_errors, path + "min_topological.csv");
+                write_csv(min_quantization_errors, path + "min_quantization.csv");
+                write_csv(last_topological_errors, path + "last_topological.csv");
+                write_csv(last_quantization_errors, path + "last_quantization.csv");
+
+                if (estimate_width > 0)
+                {
+                    // average bounds over the runs, the plots draw them as a band around the average error
+                    const auto write_intervals = [](const std::vector<std::vector<error_interval_t>>& intervals, const std::string& file) {
+                        std::ofstream out{file};
+                        out << "lower,upper\n";
+                        for (blt::size_t epoch = 0; epoch < intervals.front().size(); epoch++)
                         {
-                            auto d = vec[i] - q_mean;
-                            variance_q += d * d;
+                            Scalar lower = 0, upper = 0;
+                            for (const auto& run : intervals)
+                            {
+                                lower += run[epoch].lower;
+                                upper += run[epoch].upper;
+                            }
+                            out << lower / static_cast<Scalar>(intervals.size()) << ',' << upper / static_cast<Scalar>(intervals.size()) << '\n';
                         }
-                        variance_t /= static_cast<Scalar>(runs);
-                        variance_q /= static_cast<Scalar>(runs);
-                        stddev_topological_errors[i] = std::sqrt(variance_t);
-                        stddev_quantization_errors[i] = std::sqrt(variance_q);
-                    }
+                    };
+                    write_intervals(task.topological_intervals, path + "topological_interval.csv");
+                    write_intervals(task.quantization_intervals, path + "quantization_interval.csv");
                 }
                 else
                 {
-                    load_csv(average_topological_errors, path + "topological_avg.csv");
-                    load_csv(average_quantization_errors, path + "quantization_avg.csv");
-                    load_csv(average_activations, path + "activations_avg.csv");
-                    load_csv(stddev_topological_errors, path + "topological_stddev.csv");
-                    load_csv(stddev_quantization_errors, path + "quantization_stddev.csv");
-                    load_csv(min_topological_errors, path + "min_topological.csv");
-                    load_csv(min_quantization_errors, path + "min_quantization.csv");
-                    load_csv(last_topological_errors, path + "last_topological.csv");
-                    load_csv(last_quantization_errors, path + "last_quantization.csv");
+                    // left over from an earlier estimated run into the same directory, they'd be drawn around these exact errors
+                    std::filesystem::remove(path + "topological_interval.csv");
+                    std::filesystem::remove(path + "quantization_interval.csv");
                 }
 
-                Scalar avg_quantization_stddev = 0;
-                Scalar avg_topological_stddev = 0;
-
-                for (auto [q, t] : blt::in_pairs(stddev_quantization_errors, stddev_topological_errors))
+                std::ofstream stops{path + "stop_epochs.csv"};
+                stops << "run,epoch,reason\n";
+                for (auto [i, v] : blt::in_pairs(task.stop_epochs, task.stop_reasons).enumerate())
                 {
-                    avg_quantization_stddev += q;
-                    avg_topological_stddev += t;
+                    auto [epoch, reason] = v;
+                    stops << i << ',' << epoch << ",\"" << reason << "\"\n";
                 }
 
-                avg_quantization_stddev /= static_cast<Scalar>(task.max_epochs);
-                avg_topological_stddev /= static_cast<Scalar>(task.max_epochs);
-
-                auto min_quant =
-                    *std::min_element(average_quantization_errors.begin(), average_quantization_errors.end());
-                auto max_quant =
-                    *std::max_element(average_quantization_errors.begin(), average_quantization_errors.end());
+                topological_stddev << "Average topological stddev: " << avg_topological_stddev << std::endl;
+                quantization_stddev << "Average quantization stddev: " << avg_quantization_stddev << std::endl;
+                // topological_stddev << "Stddev Over Epochs: " << std::endl;
+                // quantization_stddev << "Stddev Over Epochs: " << std::endl;
 
-                auto min_topo = *std::min_element(average_topological_errors.begin(), average_topological_errors.end());
-                auto max_topo = *std::max_element(average_topological_errors.begin(), average_topological_errors.end());
+                for (auto v : stddev_topological_errors)
+                    topological_stddev << v << std::endl;
+                for (auto v : stddev_quantization_errors)
+                    quantization_stddev << v << std::endl;
 
-                if (do_run)
+                topological << "error\n";
+                quantization << "error\n";
+                for (auto [i, v] : blt::enumerate(average_topological_errors))
                 {
-                    std::ofstream topological{path + "topological_avg.csv"};
-                    std::ofstream quantization{path + "quantization_avg.csv"};
-                    std::ofstream activations_avg{path + "activations_avg.csv"};
-                    std::ofstream activations{path + "activations.csv"};
-                    std::ofstream topological_stddev{path + "topological_stddev.csv"};
-                    std::ofstream quantization_stddev{path + "quantization_stddev.csv"};
-
-                    write_csv(min_topological_errors, path + "min_topological.csv");
-                    write_csv(min_quantization_errors, path + "min_quantization.csv");
-                    write_csv(last_topological_errors, path + "last_topological.csv");
-                    write_csv(last_quantization_errors, path + "last_quantization.csv");
-
-                    topological_stddev << "Average topological stddev: " << avg_topological_stddev << std::endl;
-                    quantization_stddev << "Average quantization stddev: " << avg_quantization_stddev << std::endl;
-                    // topological_stddev << "Stddev Over Epochs: " << std::endl;
-                    // quantization_stddev << "Stddev Over Epochs: " << std::endl;
-
-                    for (auto v : stddev_topological_errors)
-                        topological_stddev << v << std::endl;
-                    for (auto v : stddev_quantization_errors)
-                        quantization_stddev << v << std::endl;
-
-                    topological << "error\n";
-                    quantization << "error\n";
-                    for (auto [i, v] : blt::enumerate(average_topological_errors))
-                    {
-                        topological << v << '\n';
-                    }
-                    for (auto [i, v] : blt::enumerate(average_quantization_errors))
-                    {
-                        quantization << v << '\n';
-                    }
-                    for (auto [i, v] : blt::enumerate(average_activations))
-                    {
-                        activations_avg << v / static_cast<Scalar>(runs);
-                        if (i % task.width == task.width - 1)
-                            activations_avg << '\n';
-                        else
-                            activations_avg << ',';
-                    }
-                    for (auto [i, v] : blt::enumerate(task.activations.front()))
-                    {
-                        activations << v;
-                        if (i % task.width == task.width - 1)
-                            activations << '\n';
-                        else
-                            activations << ',';
-                    }
+                    topological << v << '\n';
+                }
+                for (auto [i, v] : blt::enumerate(average_quantization_errors))
+                {
+                    quantization << v << '\n';
+                }
+                for (auto [i, v] : blt::enumerate(average_activations))
+                {
+                    activations_avg << v / static_cast<Scalar>(runs);
+                    if (i % task.width == task.width - 1)
+                        activations_avg << '\n';
+                    else
+                        activations_avg << ',';
+                }
+                for (auto [i, v] : blt::enumerate(task.activations.front()))
+                {
+                    activations << v;
+                    if (i % task.width == task.width - 1)
+                        activations << '\n';
+                    else
+                        activations << ',';
                 }
-
-                std::string shape_name = shape_names[static_cast<int>(task.shape)];
-                std::string init_name = init_names[static_cast<int>(task.init)];
-                blt::string::replaceAll(shape_name, " ", "-");
-                blt::string::replaceAll(init_name, " ", "-");
-
-                plot_heatmap(path, "activations.csv", task.file->data_points.front().bins.size(),
-                             std::to_string(task.width) + "x" + std::to_string(task.height) + " " += shape_name + ", " += init_name + ", " +
-                             std::to_string(
-                                 task.max_epochs) +
-                             " Epochs");
-
-                plot_line_graph(path, "topological_avg.csv", "quantization_avg.csv", task.file->data_points.front().bins.size(),
-                                std::to_string(task.width) + "x" + std::to_string(task.height) + " " += shape_name + ", " += init_name + ", Min: " +
-                                std::to_string(min_topo) + ", Max: " + std::to_string(max_topo) +
-                                ", " + std::to_string(task.max_epochs) + " Epochs",
-                                std::to_string(task.width) + "x" + std::to_string(task.height) + " " += shape_name + ", " += init_name + ", Min: " +
-                                std::to_string(min_quant) + ", Max: " +
-                                std::to_string(max_quant) + ", " + std::to_string(task.max_epochs) +
-                                " Epochs");
-
-                BLT_INFO("Task '%s' Complete", path.c_str());
             }
-            while (true);
-        });
+
+            std::string shape_name = shape_names[static_cast<int>(task.shape)];
+            std::string init_name = init_names[static_cast<int>(task.init)];
+            blt::string::replaceAll(shape_name, " ", "-");
+            blt::string::replaceAll(init_name, " ", "-");
+
+            plot_heatmap(path, "activations.csv", task.source_bins,
+                         std::to_string(task.width) + "x" + std::to_string(task.height) + " " += shape_name + ", " += init_name + ", " +
+                         std::to_string(
+                             task.max_epochs) +
+                         " Epochs");
+
+            const bool has_intervals = std::filesystem::exists(path + "topological_interval.csv");
+            plot_line_graph(path, "topological_avg.csv", "quantization_avg.csv", task.source_bins,
+                            std::to_string(task.width) + "x" + std::to_string(task.height) + " " += shape_name + ", " += init_name + ", Min: " +
+                            std::to_string(min_topo) + ", Max: " + std::to_string(max_topo) +
+                            ", " + std::to_string(task.max_epochs) + " Epochs",
+                            std::to_string(task.width) + "x" + std::to_string(task.height) + " " += shape_name + ", " += init_name + ", Min: " +
+                            std::to_string(min_quant) + ", Max: " +
+                            std::to_string(max_quant) + ", " + std::to_string(task.max_epochs) +
+                            " Epochs", has_intervals ? "topological_interval.csv" : "", has_intervals ? "quantization_interval.csv" : "");
+
+            BLT_INFO("Task '%s' Complete", path.c_str());
+        }
+        while (true);
+    });
+}
+
+struct timed_run_t
+{
+    double seconds = 0;
+    Scalar topological_error = 0;
+    Scalar quantization_error = 0;
+};
+
+timed_run_t timed_run(const data_file_t& file, blt::u32 size, blt::size_t epochs, shape_t shape, init_t init)
+{
+    gaussian_function_t topology_func{};
+    auto dist = distance_function_t::from_shape(shape, size, size);
+
+    const auto start = std::chrono::steady_clock::now();
+    som_t som{file, size, size, epochs, dist.get(), &topology_func, shape, init, false};
+    while (som.get_current_epoch() < som.get_max_epochs())
+        som.train_epoch(1);
+    const auto end = std::chrono::steady_clock::now();
+
+    timed_run_t run;
+    run.seconds = std::chrono::duration<double>(end - start).count();
+    run.topological_error = som.get_topological_errors().back();
+    run.quantization_error = som.get_quantization_errors().back();
+    return run;
+}
+
+void action_project(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("project");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to data files").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("500")
+                       .setHelp("Number of epochs to train both the full and projected maps for").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained maps").build());
+
+    add_projection_arguments(parser, "pca");
+
+    auto args = parser.parse_args(argv_vector);
+
+    load_data_files(args.get<std::string>("file"));
+
+    const auto projection_type = parse_projection(args.get<std::string>("projection"));
+    const auto dims = std::stoul(args.get<std::string>("dims"));
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+
+    for (const auto& file : data.files)
+    {
+        const auto bins = file.data_points.begin()->bins.size();
+        const auto full = timed_run(file, size, epochs, shape_t::GRID_WRAP, init_t::SAMPLED_DATA);
+
+        const auto fit_start = std::chrono::steady_clock::now();
+        const auto projection = projection_t::make(projection_type, file, dims, std::random_device{}());
+        const auto projected_file = projection.empty() ? file : projection.project(file);
+        const auto fit_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fit_start).count();
+
+        const auto reduced = timed_run(projected_file, size, epochs, shape_t::GRID_WRAP, init_t::SAMPLED_DATA);
+
+        BLT_INFO("Bins %ld -> %ld (%s)", bins, projected_file.data_points.begin()->bins.size(),
+                 projection_names[static_cast<int>(projection_type)].c_str());
+        BLT_INFO("\tFull: %f epochs/s, topological error %f, quantization error %f", static_cast<double>(epochs) / full.seconds,
+                 full.topological_error, full.quantization_error);
+        BLT_INFO("\tProjected: %f epochs/s (%fx, fit %fms), topological error %f, quantization error %f",
+                 static_cast<double>(epochs) / reduced.seconds, full.seconds / reduced.seconds, fit_seconds * 1000,
+                 reduced.topological_error, reduced.quantization_error);
+    }
+}
+
+void action_coreset(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("coreset");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to data files").build());
+
+    parser.addArgument(blt::arg_builder{"--coreset", "-c"}
+                       .setDefault("16")
+                       .setHelp("Number of weighted samples to compress each file down to").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("500")
+                       .setHelp("Number of epochs to train both the full and coreset maps for").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained maps").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    load_data_files(args.get<std::string>("file"));
+
+    const auto coreset_size = std::stoul(args.get<std::string>("coreset"));
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+
+    for (const auto& file : data.files)
+    {
+        const auto full = timed_run(file, size, epochs, shape_t::GRID_WRAP, init_t::SAMPLED_DATA);
+
+        const auto build_start = std::chrono::steady_clock::now();
+        const auto coreset = build_coreset(file, coreset_size, std::random_device{}());
+        const auto build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count();
+
+        gaussian_function_t topology_func{};
+        auto dist = distance_function_t::from_shape(shape_t::GRID_WRAP, size, size);
+        const auto start = std::chrono::steady_clock::now();
+        som_t som{coreset, size, size, epochs, dist.get(), &topology_func, shape_t::GRID_WRAP, init_t::SAMPLED_DATA, false};
+        while (!som.is_finished())
+            som.train_epoch(1);
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        BLT_INFO("Bins %ld, %ld samples -> %ld weighted samples (built in %fms)", file.data_points.begin()->bins.size(), file.data_points.size(),
+                 coreset.data_points.size(), build_seconds * 1000);
+        BLT_INFO("\tFull: %f epochs/s, topological error %f, quantization error %f", static_cast<double>(epochs) / full.seconds,
+                 full.topological_error, full.quantization_error);
+        BLT_INFO("\tCoreset: %f epochs/s (%fx), on full data topological error %f, quantization error %f",
+                 static_cast<double>(epochs) / seconds, full.seconds / seconds, som.topological_error(file), som.quantization_error(file));
+    }
+}
+
+void action_cross_validate(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("crossval");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to data files").build());
+
+    parser.addArgument(blt::arg_builder{"--folds", "-k"}
+                       .setDefault("5")
+                       .setHelp("Number of folds, one map is trained per fold").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("500")
+                       .setHelp("Number of epochs to train each fold's map for").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained maps").build());
+
+    parser.addArgument(blt::arg_builder{"--seed"}
+                       .setDefault("0")
+                       .setHelp("Seed of the fold assignment, the same seed always gives the same folds").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    load_data_files(args.get<std::string>("file"));
+
+    const auto folds = std::stoul(args.get<std::string>("folds"));
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+    const auto seed = std::stoul(args.get<std::string>("seed"));
+
+    for (const auto& file : data.files)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto results = cross_validate(file, folds, seed, size, size, epochs, shape_t::GRID_WRAP, init_t::SAMPLED_DATA);
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (results.empty())
+            continue;
+
+        BLT_INFO("Bins %ld, %ld samples, %ld folds in %fs", file.data_points.bin_count(), file.data_points.size(), results.size(), seconds);
+        double rate_total = 0, rate_squares = 0, topological_total = 0;
+        for (const auto& [i, result] : blt::enumerate(results))
+        {
+            BLT_INFO("\tFold %ld: trained on %ld, held out %ld misclassified %f (rate %f), topological error %f, %fs", i,
+                     result.training_samples, result.held_out_samples, result.quantization_error, result.quantization_rate,
+                     result.topological_error, result.seconds);
+            rate_total += result.quantization_rate;
+            rate_squares += result.quantization_rate * result.quantization_rate;
+            topological_total += result.topological_error;
+        }
+        const auto count = static_cast<double>(results.size());
+        const auto mean = rate_total / count;
+        BLT_INFO("\tHeld out misclassification rate %f +- %f, topological error %f", mean,
+                 std::sqrt(std::max(0.0, rate_squares / count - mean * mean)), topological_total / count);
+    }
+}
+
+void action_joint(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("joint");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to data files, every resolution is trained on together").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("500")
+                       .setHelp("Number of epochs to train for").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained map").build());
+
+    parser.addArgument(blt::arg_builder{"--padding"}
+                       .setDefault("0")
+                       .setHelp("Value the bins missing from lower resolution samples read as").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    load_data_files(args.get<std::string>("file"));
+
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+
+    padded_dataset_t padded{std::stof(args.get<std::string>("padding"))};
+    for (const auto& file : data.files)
+        padded.with(file);
+    if (padded.size() == 0)
+    {
+        BLT_ERROR("No data to train on");
+        return;
+    }
+
+    gaussian_function_t topology_func{};
+    auto dist = distance_function_t::from_shape(shape_t::GRID_WRAP, size, size);
+    const auto start = std::chrono::steady_clock::now();
+    som_t som{&padded, size, size, epochs, dist.get(), &topology_func, shape_t::GRID_WRAP, init_t::SAMPLED_DATA, false};
+    som.set_evaluation_schedule(evaluation_schedule_t::final_only());
+    while (!som.is_finished())
+        som.train_epoch(1);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BLT_INFO("Trained on %ld samples from %ld files padded to %ld bins in %fs (%f epochs/s)", padded.size(), padded.get_files().size(),
+             padded.bin_count(), seconds, static_cast<double>(epochs) / seconds);
+    BLT_INFO("\tTopological error %f, quantization error %f", som.get_topological_errors().back(), som.get_quantization_errors().back());
+}
+
+void action_sparse(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("sparse");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to data files").build());
+
+    parser.addArgument(blt::arg_builder{"--k", "-k"}
+                       .setDefault("32")
+                       .setHelp("Number of largest magnitude bins each sample keeps while training sparse").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("500")
+                       .setHelp("Number of epochs to train both the dense and sparse maps for").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained maps").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    load_data_files(args.get<std::string>("file"));
+
+    const auto k = std::stoul(args.get<std::string>("k"));
+    if (k == 0)
+    {
+        BLT_ERROR("k has to keep at least one bin");
+        return;
     }
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+
+    for (const auto& file : data.files)
+    {
+        if (k >= file.data_points.bin_count())
+        {
+            BLT_INFO("Bins %ld, every bin is kept with k = %ld, skipping", file.data_points.bin_count(), k);
+            continue;
+        }
+        const auto full = timed_run(file, size, epochs, shape_t::GRID_WRAP, init_t::SAMPLED_DATA);
+
+        gaussian_function_t topology_func{};
+        auto dist = distance_function_t::from_shape(shape_t::GRID_WRAP, size, size);
+        const auto start = std::chrono::steady_clock::now();
+        som_t som{file, size, size, epochs, dist.get(), &topology_func, shape_t::GRID_WRAP, init_t::SAMPLED_DATA, false};
+        som.set_evaluation_schedule(evaluation_schedule_t::final_only());
+        som.set_sparse_training(k);
+        if (!som.get_sparse_file())
+        {
+            BLT_WARN("Bins %ld, not trained sparse", file.data_points.bin_count());
+            continue;
+        }
+        while (!som.is_finished())
+            som.train_epoch(1);
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto& encoded = *som.get_sparse_file();
+
+        BLT_INFO("Bins %ld, %ld samples, top %ld bins kept, residual norm %f%% mean %f%% max", encoded.get_bins(), encoded.size(),
+                 encoded.get_k(), encoded.mean_residual_ratio() * 100, encoded.max_residual_ratio() * 100);
+        BLT_INFO("\tDense: %f epochs/s, topological error %f, quantization error %f", static_cast<double>(epochs) / full.seconds,
+                 full.topological_error, full.quantization_error);
+        BLT_INFO("\tSparse: %f epochs/s (%fx), on full data topological error %f, quantization error %f, BMU agreement %f%%",
+                 static_cast<double>(epochs) / seconds, full.seconds / seconds, som.get_topological_errors().back(),
+                 som.get_quantization_errors().back(), som.sparse_bmu_agreement() * 100);
+    }
+}
+
+void action_warm_start(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("warmstart");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to data files").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("500")
+                       .setHelp("Number of epochs to train the lowest resolution and every from scratch map for").build());
+
+    parser.addArgument(blt::arg_builder{"--warm-epochs", "-w"}
+                       .setDefault("100")
+                       .setHelp("Number of epochs to train each warm started map for").build());
+
+    parser.addArgument(blt::arg_builder{"--schedule-start"}
+                       .setDefault("0.5")
+                       .setHelp("Fraction of the learning schedule warm started maps skip").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained maps").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    load_data_files(args.get<std::string>("file"));
+
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto warm_epochs = std::stoul(args.get<std::string>("warm-epochs"));
+    const auto schedule_start = std::stof(args.get<std::string>("schedule-start"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+
+    std::vector<const data_file_t*> files;
+    for (const auto& file : data.files)
+        files.push_back(&file);
+    std::sort(files.begin(), files.end(), [](const data_file_t* a, const data_file_t* b) {
+        return a->data_points.begin()->bins.size() < b->data_points.begin()->bins.size();
+    });
+
+    gaussian_function_t topology_func{};
+    auto dist = distance_function_t::from_shape(shape_t::GRID_WRAP, size, size);
+
+    // each resolution is warm started from the one below it
+    std::unique_ptr<som_t> previous;
+    for (const auto* file : files)
+    {
+        const auto bins = file->data_points.begin()->bins.size();
+        const auto cold = timed_run(*file, size, epochs, shape_t::GRID_WRAP, init_t::SAMPLED_DATA);
+
+        if (previous == nullptr)
+        {
+            previous = std::make_unique<som_t>(*file, size, size, epochs, dist.get(), &topology_func, shape_t::GRID_WRAP,
+                                               init_t::SAMPLED_DATA, false);
+            while (!previous->is_finished())
+                previous->train_epoch(1);
+            BLT_INFO("Bins %ld (seed): %f epochs/s, topological error %f, quantization error %f", bins,
+                     static_cast<double>(epochs) / cold.seconds, cold.topological_error, cold.quantization_error);
+            continue;
+        }
+
+        const auto from_bins = previous->get_file().data_points.begin()->bins.size();
+        const auto start = std::chrono::steady_clock::now();
+        auto warm = std::make_unique<som_t>(*file, *previous, warm_epochs, dist.get(), &topology_func, schedule_start);
+        const auto initial_topological = warm->get_topological_errors().back();
+        const auto initial_quantization = warm->get_quantization_errors().back();
+        while (!warm->is_finished())
+            warm->train_epoch(1);
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        BLT_INFO("Bins %ld (warm started from %ld)", bins, from_bins);
+        BLT_INFO("\tFrom scratch: %ld epochs in %fs, topological error %f, quantization error %f", epochs, cold.seconds,
+                 cold.topological_error, cold.quantization_error);
+        BLT_INFO("\tWarm start: topological error %f, quantization error %f before training", initial_topological, initial_quantization);
+        BLT_INFO("\tWarm start: %ld epochs in %fs (%fx), topological error %f, quantization error %f", warm_epochs, seconds,
+                 cold.seconds / seconds, warm->get_topological_errors().back(), warm->get_quantization_errors().back());
+        previous = std::move(warm);
+    }
+}
+
+void action_replay(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("replay");
+
+    parser.addArgument(blt::arg_builder{"--trace", "-t"}
+                       .setHelp("BMU trace written by test --trace").build());
+
+    parser.addArgument(blt::arg_builder{"--output", "-o"}
+                       .setDefault("./")
+                       .setHelp("Directory to write the recomputed metrics to").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    if (!args.contains("trace"))
+    {
+        BLT_ERROR("A trace file is required");
+        return;
+    }
+
+    std::ifstream trace_file{args.get<std::string>("trace"), std::ios::binary};
+    const auto trace = bmu_trace_t::read(trace_file);
+    if (!trace)
+        return;
+
+    auto output = args.get<std::string>("output");
+    if (!blt::string::ends_with(output, '/'))
+        output += '/';
+    std::filesystem::create_directories(output);
 
-    while (!threads.empty())
+    const auto start = std::chrono::steady_clock::now();
+
+    std::ofstream metrics{output + "replay.csv"};
+    metrics << "epoch,topological error,class purity\n";
+    for (blt::size_t frame = 0; frame < trace->frame_count(); frame++)
+        metrics << trace->epoch_of(frame) << ',' << trace->topological_error(frame) << ',' << trace->class_purity(frame) << '\n';
+
+    std::ofstream hits{output + "hits.csv"};
+    if (trace->frame_count() > 0)
     {
-        if (threads.back().joinable())
+        const auto hit_map = trace->hit_map(trace->frame_count() - 1);
+        for (auto [i, v] : blt::enumerate(hit_map))
         {
-            threads.back().join();
-            threads.pop_back();
+            hits << v;
+            if (i % trace->get_width() == trace->get_width() - 1)
+                hits << '\n';
+            else
+                hits << ',';
         }
     }
+
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    BLT_INFO("Replayed %ld frames (%ld bytes of trace) in %fs", trace->frame_count(), trace->memory_usage(), seconds);
 }
 
 struct man_whitney_t
@@ -605,7 +1306,6 @@ void action_convert(const std::vector<std::string>& argv_vector)
 
     load_data_files(args.get<std::string>("file"));
 
-    std::vector<std::thread> threads;
     std::vector<test_t> tasks;
     std::mutex task_mutex;
 
@@ -634,154 +1334,518 @@ void action_convert(const std::vector<std::string>& argv_vector)
                            }, "UnUsed");
     }
 
-    for (blt::size_t i = 0; i < std::thread::hardware_concurrency(); i++)
+    auto& pool = thread_pool_t::shared();
+    pool.run(pool.concurrency(), [&](blt::size_t)
     {
-        threads.emplace_back([&]()
+        while (true)
         {
-            while (true)
+            test_t t;
             {
-                test_t t;
-                {
-                    std::unique_lock lock(task_mutex);
-                    if (tasks.empty())
-                        break;
-                    t = tasks.back();
-                    tasks.pop_back();
-                }
+                std::unique_lock lock(task_mutex);
+                if (tasks.empty())
+                    break;
+                t = tasks.back();
+                tasks.pop_back();
+            }
 
-                std::vector<std::string> paths;
-                blt::hashmap_t<std::string, std::vector<sortable_data_t>> data;
-                blt::hashmap_t<std::string, const task_t*> task_data;
-                for (const auto& task : t.tasks)
-                {
-                    auto path = make_path(task) + "last_topological.csv";
-                    paths.push_back(path);
-                    auto lines = blt::fs::getLinesFromFile(path);
-                    for (const auto& line : blt::iterate(lines).skip(1))
-                        data[path].emplace_back(paths.back(), std::stof(line), 0);
-                    task_data[path] = &task;
-                }
+            std::vector<std::string> paths;
+            blt::hashmap_t<std::string, std::vector<sortable_data_t>> data;
+            blt::hashmap_t<std::string, const task_t*> task_data;
+            for (const auto& task : t.tasks)
+            {
+                auto path = make_path(task) + "last_topological.csv";
+                paths.push_back(path);
+                auto lines = blt::fs::getLinesFromFile(path);
+                for (const auto& line : blt::iterate(lines).skip(1))
+                    data[path].emplace_back(paths.back(), std::stof(line), 0);
+                task_data[path] = &task;
+            }
 
-                std::string same = task_data.begin()->first;
-                for (const auto& task : task_data)
+            std::string same = task_data.begin()->first;
+            for (const auto& task : task_data)
+            {
+                for (auto [i, c] : blt::enumerate(task.first))
                 {
-                    for (auto [i, c] : blt::enumerate(task.first))
-                    {
-                        if (i < same.length() && same[i] != task.first[i])
-                            same[i] = '%';
-                    }
+                    if (i < same.length() && same[i] != task.first[i])
+                        same[i] = '%';
                 }
-                auto lines = blt::string::split_sv(same, '/');
-                std::string filtered_path = "stats/";
-                blt::size_t index = 0;
-                for (const auto& [i, line] : blt::enumerate(lines))
+            }
+            auto lines = blt::string::split_sv(same, '/');
+            std::string filtered_path = "stats/";
+            blt::size_t index = 0;
+            for (const auto& [i, line] : blt::enumerate(lines))
+            {
+                if (blt::string::contains(line, '%'))
                 {
-                    if (blt::string::contains(line, '%'))
-                    {
-                        index = i;
-                        continue;
-                    }
-                    filtered_path += line;
-                    filtered_path += '/';
+                    index = i;
+                    continue;
                 }
-                auto bin_line = blt::string::split(lines[0], '-');
-                auto bin_size = std::stoi(bin_line[1]);
-                std::filesystem::create_directories(filtered_path);
-                BLT_TRACE("Writing to path %s", filtered_path.c_str());
+                filtered_path += line;
+                filtered_path += '/';
+            }
+            auto bin_line = blt::string::split(lines[0], '-');
+            auto bin_size = std::stoi(bin_line[1]);
+            std::filesystem::create_directories(filtered_path);
+            BLT_TRACE("Writing to path %s", filtered_path.c_str());
 
-                std::vector<man_whitney_t> mans;
-                for (auto [i, pair] : blt::iterate(data.begin(), data.end()).enumerate())
-                {
-                    for (const auto& [path2, vec2] : blt::iterate(data.begin(), data.end()).skip(i + 1))
-                        mans.emplace_back(do_man_whitney(pair.first, path2, pair.second, vec2));
-                }
+            std::vector<man_whitney_t> mans;
+            for (auto [i, pair] : blt::iterate(data.begin(), data.end()).enumerate())
+            {
+                for (const auto& [path2, vec2] : blt::iterate(data.begin(), data.end()).skip(i + 1))
+                    mans.emplace_back(do_man_whitney(pair.first, path2, pair.second, vec2));
+            }
 
-                std::ofstream stats{filtered_path + "results_table.txt"};
-                stats << "\\begin{figure}[h!]\n\t\\centering" << std::endl;
-                stats << "\t\\makebox[\\textwidth]{\\begin{tabular}{cc}" << std::endl << "\t\t";
+            std::ofstream stats{filtered_path + "results_table.txt"};
+            stats << "\\begin{figure}[h!]\n\t\\centering" << std::endl;
+            stats << "\t\\makebox[\\textwidth]{\\begin{tabular}{cc}" << std::endl << "\t\t";
 
-                for (auto [i, task] : blt::enumerate(t.tasks))
+            for (auto [i, task] : blt::enumerate(t.tasks))
+            {
+                if (i != 0)
                 {
-                    if (i != 0)
-                    {
-                        if (i % 2 == 0)
-                            stats << "\\\\" << std::endl << "\t\t";
-                        else
-                            stats << " & \n\t\t";
-                    }
-                    stats << "\\includegraphics[width=0.6\\textwidth]{" << make_path(task) + "errors-topological" << bin_size << "}";
+                    if (i % 2 == 0)
+                        stats << "\\\\" << std::endl << "\t\t";
+                    else
+                        stats << " & \n\t\t";
                 }
-                stats << "\\\\" << std::endl;
-                stats << "\t\\end{tabular}}" << std::endl;
-                stats << "\t\\caption{}\n\t\\label{fig:}" << std::endl;
-                stats << "\\end{figure}" << std::endl << std::endl;
+                stats << "\\includegraphics[width=0.6\\textwidth]{" << make_path(task) + "errors-topological" << bin_size << "}";
+            }
+            stats << "\\\\" << std::endl;
+            stats << "\t\\end{tabular}}" << std::endl;
+            stats << "\t\\caption{}\n\t\\label{fig:}" << std::endl;
+            stats << "\\end{figure}" << std::endl << std::endl;
 
-                stats << "\\begin{figure}[h!]\n\t\\centering" << std::endl;
-                stats << "\t\\makebox[\\textwidth]{\\begin{tabular}{cc}" << std::endl << "\t\t";
+            stats << "\\begin{figure}[h!]\n\t\\centering" << std::endl;
+            stats << "\t\\makebox[\\textwidth]{\\begin{tabular}{cc}" << std::endl << "\t\t";
 
-                for (auto [i, task] : blt::enumerate(t.tasks))
+            for (auto [i, task] : blt::enumerate(t.tasks))
+            {
+                if (i != 0)
                 {
-                    if (i != 0)
-                    {
-                        if (i % 2 == 0)
-                            stats << "\\\\" << std::endl << "\t\t";
-                        else
-                            stats << " & \n\t\t";
-                    }
-                    stats << "\\includegraphics[width=0.6\\textwidth]{" << make_path(task) + "errors-topological" << bin_size << "}";
+                    if (i % 2 == 0)
+                        stats << "\\\\" << std::endl << "\t\t";
+                    else
+                        stats << " & \n\t\t";
                 }
-                stats << "\\\\" << std::endl << "\t\t";
-                for (auto [i, task] : blt::enumerate(t.tasks))
+                stats << "\\includegraphics[width=0.6\\textwidth]{" << make_path(task) + "errors-topological" << bin_size << "}";
+            }
+            stats << "\\\\" << std::endl << "\t\t";
+            for (auto [i, task] : blt::enumerate(t.tasks))
+            {
+                if (i != 0)
                 {
-                    if (i != 0)
-                    {
-                        if (i % 2 == 0)
-                            stats << "\\\\" << std::endl << "\t\t";
-                        else
-                            stats << " & \n\t\t";
-                    }
-                    stats << "\\includegraphics[width=0.6\\textwidth]{" << make_path(task) + "errors-quantization" << bin_size << "}";
+                    if (i % 2 == 0)
+                        stats << "\\\\" << std::endl << "\t\t";
+                    else
+                        stats << " & \n\t\t";
                 }
-                stats << "\\\\" << std::endl;
-                stats << "\t\\end{tabular}}" << std::endl;
-                stats << "\t\\caption{}\n\t\\label{fig:}" << std::endl;
-                stats << "\\end{figure}" << std::endl << std::endl;
-
-                stats << "\\begin{table}[h!]\n\t\\centering" << std::endl;
-                stats <<
-                    "\t\\makebox[\\textwidth]{\\begin{tabular}{||m{0.3\\linewidth}|m{0.125\\linewidth}|m{0.2\\linewidth}|m{0.2\\linewidth}|m{0.15\\linewidth}||}"
-                    << std::endl;
-                stats << "\t\t\\hline" << std::endl;
-                stats << "\t\tName & Z-Value & P-Value & Effect Size & Significant\\\\" << std::endl;
+                stats << "\\includegraphics[width=0.6\\textwidth]{" << make_path(task) + "errors-quantization" << bin_size << "}";
+            }
+            stats << "\\\\" << std::endl;
+            stats << "\t\\end{tabular}}" << std::endl;
+            stats << "\t\\caption{}\n\t\\label{fig:}" << std::endl;
+            stats << "\\end{figure}" << std::endl << std::endl;
+
+            stats << "\\begin{table}[h!]\n\t\\centering" << std::endl;
+            stats <<
+                "\t\\makebox[\\textwidth]{\\begin{tabular}{||m{0.3\\linewidth}|m{0.125\\linewidth}|m{0.2\\linewidth}|m{0.2\\linewidth}|m{0.15\\linewidth}||}"
+                << std::endl;
+            stats << "\t\t\\hline" << std::endl;
+            stats << "\t\tName & Z-Value & P-Value & Effect Size & Significant\\\\" << std::endl;
+            stats << "\t\t\\hline" << std::endl;
+            for (const auto& man : mans)
+            {
+                auto lines1 = blt::string::split(man.name1, '/');
+                auto lines2 = blt::string::split(man.name2, '/');
+                const auto& name1 = lines1[index];
+                const auto& name2 = lines2[index];
+
+                auto effect = man.r < 0.3 ? "Small" : (man.r < 0.5 ? "Medium" : "Large");
+                constexpr Scalar acceptance_region = 1.96;
+                auto sig = (man.z < -acceptance_region || man.z > acceptance_region) ? "Yes" : "No";
+
+                BLT_TRACE("Z: %f P: %f", man.z, cumulativeNormal(man.z));
+                stats << "\t\t" << name1 << " \\newline " << name2 << " & " << man.z << " & " << cumulativeNormal(man.z) << " & " << man.r << " ("
+                    << effect << ") & " << sig << "\\\\" << std::endl;
                 stats << "\t\t\\hline" << std::endl;
-                for (const auto& man : mans)
-                {
-                    auto lines1 = blt::string::split(man.name1, '/');
-                    auto lines2 = blt::string::split(man.name2, '/');
-                    const auto& name1 = lines1[index];
-                    const auto& name2 = lines2[index];
-
-                    auto effect = man.r < 0.3 ? "Small" : (man.r < 0.5 ? "Medium" : "Large");
-                    constexpr Scalar acceptance_region = 1.96;
-                    auto sig = (man.z < -acceptance_region || man.z > acceptance_region) ? "Yes" : "No";
-
-                    BLT_TRACE("Z: %f P: %f", man.z, cumulativeNormal(man.z));
-                    stats << "\t\t" << name1 << " \\newline " << name2 << " & " << man.z << " & " << cumulativeNormal(man.z) << " & " << man.r << " ("
-                        << effect << ") & " << sig << "\\\\" << std::endl;
-                    stats << "\t\t\\hline" << std::endl;
-                }
-                stats << "\t\\end{tabular}}" << std::endl;
-                stats << "\t\\caption{}\n\t\\label{tbl:}" << std::endl;
-                stats << "\\end{table}" << std::endl;
             }
-        });
+            stats << "\t\\end{tabular}}" << std::endl;
+            stats << "\t\\caption{}\n\t\\label{tbl:}" << std::endl;
+            stats << "\\end{table}" << std::endl;
+        }
+    });
+}
+
+void action_convert_data(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("convert-data");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Directory of .out data files to convert").build());
+
+    parser.addArgument(blt::arg_builder{"--output", "-o"}
+                       .setHelp("Directory to write the binary files to, defaults to next to the text files they replace").build());
+
+    parser.addArgument(blt::arg_builder{"--precision", "-p"}
+                       .setDefault("4")
+                       .setHelp("Bytes per stored bin value, 4 (float) or 8 (double)").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    const std::filesystem::path input = args.get<std::string>("file");
+    const std::filesystem::path output = args.contains("output") ? std::filesystem::path{args.get<std::string>("output")} : input;
+    const auto precision = std::stoul(args.get<std::string>("precision"));
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& file : std::filesystem::recursive_directory_iterator(input))
+    {
+        if (!file.is_directory() && file.path().extension() == ".out")
+            files.push_back(file.path());
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<blt::size_t> converted = 0;
+    thread_pool_t::shared().parallel_for(files.size(), 1, [&](const blt::size_t begin, const blt::size_t end)
+    {
+        for (blt::size_t i = begin; i < end; i++)
+        {
+            const auto contents = blt::fs::getFile(files[i].string());
+            const auto parsed = data_file_t::parse(contents);
+            if (!parsed)
+            {
+                BLT_WARN("Unable to parse '%s', skipping it", files[i].string().c_str());
+                continue;
+            }
+            auto target = output / std::filesystem::relative(files[i], input);
+            target.replace_extension(binary_data_extension);
+            std::filesystem::create_directories(target.parent_path());
+            if (mapped_data_file_t::write(target.string(), *parsed, precision))
+                ++converted;
+        }
+    });
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    BLT_INFO("Converted %ld of %ld data files in %fs", converted.load(), files.size(), seconds);
+
+    const auto reload_start = std::chrono::steady_clock::now();
+    const auto reloaded = data_file_t::load_data_files_from_path(output.string());
+    const auto reload_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - reload_start).count();
+    BLT_INFO("Reloading %s takes %fms (%ld files)", output.string().c_str(), reload_seconds * 1000, reloaded.size());
+}
+
+void action_stream(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("stream");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setHelp("Binary data file to train from without loading it, see convert-data").build());
+
+    parser.addArgument(blt::arg_builder{"--chunk", "-c"}
+                       .setDefault("16384")
+                       .setHelp("Samples read from disk at a time").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("100")
+                       .setHelp("Number of epochs to train for").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained map").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    if (!args.contains("file"))
+    {
+        BLT_ERROR("Please provide a binary data file to stream");
+        return;
     }
 
-    for (auto& thread : threads)
+    const auto stream = data_stream_t::open(args.get<std::string>("file"), std::stoul(args.get<std::string>("chunk")));
+    if (stream == nullptr)
+        return;
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+    const auto megabytes = static_cast<double>(stream->get_pass_bytes()) / (1024.0 * 1024.0);
+
+    // a pass that does nothing with the chunks, the most training could ever get out of the disk
+    const auto read_start = std::chrono::steady_clock::now();
+    stream->begin_pass(true, std::random_device{}());
+    while (stream->next() != nullptr)
+    {}
+    const auto read_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - read_start).count();
+    BLT_INFO("Streaming %ld samples of %ld bins (%f MB) in chunks of %ld, a bare pass takes %fs (%f MB/s)", stream->get_samples(),
+             stream->get_bins(), megabytes, stream->get_chunk_samples(), read_seconds, megabytes / read_seconds);
+
+    gaussian_function_t topology_func{};
+    auto dist = distance_function_t::from_shape(shape_t::GRID_WRAP, size, size);
+    som_t som{stream.get(), size, size, epochs, dist.get(), &topology_func, shape_t::GRID_WRAP, init_t::SAMPLED_DATA, false};
+    som.set_evaluation_schedule(evaluation_schedule_t::every(epochs / 10));
+
+    const auto start = std::chrono::steady_clock::now();
+    while (!som.is_finished())
+        som.train_epoch(1);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto passes = static_cast<double>(epochs + som.get_error_epochs().size() - 1);
+
+    BLT_INFO("Trained %ld epochs in %fs, %f epochs/s and %f MB/s over %f passes (including evaluations)", epochs, seconds,
+             static_cast<double>(epochs) / seconds, megabytes * passes / seconds, passes);
+    BLT_INFO("Topological error %f, quantization error %f", som.get_topological_errors().back(), som.get_quantization_errors().back());
+}
+
+void action_generate(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("generate");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to the real data files the generated spectra are based on").build());
+
+    parser.addArgument(blt::arg_builder{"--output", "-o"}
+                       .setDefault("generated")
+                       .setHelp("Path of the generated files, without the extension").build());
+
+    parser.addArgument(blt::arg_builder{"--samples", "-n"}
+                       .setDefault("100000")
+                       .setHelp("Number of samples to generate").build());
+
+    parser.addArgument(blt::arg_builder{"--bins", "-b"}
+                       .setDefault("1000")
+                       .setHelp("Number of bins per sample").build());
+
+    parser.addArgument(blt::arg_builder{"--bad-ratio", "-r"}
+                       .setHelp("Fraction of bad samples, defaults to the fraction in the source file").build());
+
+    parser.addArgument(blt::arg_builder{"--seed", "-s"}
+                       .setDefault("0")
+                       .setHelp("Seed, the same seed always generates the same files").build());
+
+    parser.addArgument(blt::arg_builder{"--format"}
+                       .setDefault("both")
+                       .setHelp("Which files to write: text (.out), binary (.outb) or both").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    const auto samples = std::stoul(args.get<std::string>("samples"));
+    const auto bins = std::stoul(args.get<std::string>("bins"));
+    const auto seed = std::stoul(args.get<std::string>("seed"));
+    const auto output = args.get<std::string>("output");
+    const auto format = blt::string::toLowerCase(args.get<std::string>("format"));
+
+    // the closest source at or above the requested resolution loses nothing to resampling, failing that the finest one there is
+    const auto better = [bins](const blt::size_t candidate, const blt::size_t current) {
+        if ((candidate >= bins) != (current >= bins))
+            return candidate >= bins;
+        return candidate >= bins ? candidate < current : candidate > current;
+    };
+    const auto files = data_file_t::load_data_files_from_path(args.get<std::string>("file"));
+    const data_file_t* source = nullptr;
+    for (const auto& file : files)
+    {
+        if (!file.data_points.empty() && (source == nullptr || better(file.data_points.bin_count(), source->data_points.bin_count())))
+            source = &file;
+    }
+    if (source == nullptr)
+    {
+        BLT_ERROR("No data files to base the generated data on");
+        return;
+    }
+
+    blt::size_t bad = 0;
+    for (const auto point : source->data_points)
+        bad += point.is_bad;
+    const auto bad_ratio = args.contains("bad-ratio")
+                               ? std::stof(args.get<std::string>("bad-ratio"))
+                               : static_cast<Scalar>(bad) / static_cast<Scalar>(source->data_points.size());
+
+    const auto generator = spectrum_generator_t::from_file(*source, bins, bad_ratio, seed);
+    if (!generator)
+        return;
+    BLT_INFO("Generating %ld samples of %ld bins from %ld bin data, %f bad", samples, bins, source->data_points.bin_count(), bad_ratio);
+
+    if (format == "text" || format == "both")
     {
-        if (thread.joinable())
-            thread.join();
+        const auto start = std::chrono::steady_clock::now();
+        if (generator->write_text(output + ".out", samples))
+            BLT_INFO("Wrote %s.out in %fs", output.c_str(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    if (format == "binary" || format == "both")
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (generator->write_binary(output + std::string(binary_data_extension), samples))
+            BLT_INFO("Wrote %s%s in %fs", output.c_str(), std::string(binary_data_extension).c_str(),
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+void action_extract(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("extract");
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../signals")
+                       .setHelp("Directory of raw signal (.sig) files to extract spectra from").build());
+
+    parser.addArgument(blt::arg_builder{"--output", "-o"}
+                       .setHelp("Directory to write the data files to, defaults to next to the signal files").build());
+
+    parser.addArgument(blt::arg_builder{"--bins", "-b"}
+                       .setDefault("16,25,32,64,150,1000")
+                       .setHelp("Comma separated bin counts, one data file is written per signal file and bin count").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    const std::filesystem::path input = args.get<std::string>("file");
+    const std::filesystem::path output = args.contains("output") ? std::filesystem::path{args.get<std::string>("output")} : input;
+
+    std::vector<feature_extractor_t> extractors;
+    for (const auto& bins : blt::string::split(args.get<std::string>("bins"), ','))
+        extractors.emplace_back(std::stoul(bins));
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& file : std::filesystem::recursive_directory_iterator(input))
+    {
+        if (!file.is_directory() && file.path().extension() == signal_extension)
+            files.push_back(file.path());
+    }
+
+    // every file is read once and turned into all of the resolutions, named like the bundled files (L30.sig becomes L30fft16.out, ...)
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<blt::size_t> written = 0;
+    thread_pool_t::shared().parallel_for(files.size(), 1, [&](const blt::size_t begin, const blt::size_t end)
+    {
+        for (blt::size_t i = begin; i < end; i++)
+        {
+            const auto signals = load_signal_file(files[i].string());
+            if (!signals)
+                continue;
+            auto target = output / std::filesystem::relative(files[i], input);
+            std::filesystem::create_directories(target.parent_path());
+            const auto stem = target.stem().string();
+            for (const auto& extractor : extractors)
+            {
+                target.replace_filename(stem + "fft" + std::to_string(extractor.get_bins()) + ".out");
+                if (extractor.extract(*signals).write(target.string()))
+                    ++written;
+            }
+        }
+    });
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    BLT_INFO("Wrote %ld data files from %ld signal files in %fs", written.load(), files.size(), seconds);
+}
+
+void action_monitor(const std::vector<std::string>& argv_vector)
+{
+    blt::arg_parse parser{};
+    parser.setHelpExtras("monitor");
+
+    parser.addArgument(blt::arg_builder{"--signals"}
+                       .setHelp("Raw signal (.sig) file whose captures are replayed as live signals").build());
+
+    parser.addArgument(blt::arg_builder{"--file", "-f"}
+                       .setDefault("../data")
+                       .setHelp("Path to the data files to train the map on").build());
+
+    parser.addArgument(blt::arg_builder{"--bins", "-b"}
+                       .setDefault("64")
+                       .setHelp("Bin count of the spectra, the map is trained on the data file with this many bins").build());
+
+    parser.addArgument(blt::arg_builder{"--hop"}
+                       .setDefault("0")
+                       .setHelp("Samples between frames, 0 for half a window").build());
+
+    parser.addArgument(blt::arg_builder{"--epochs", "-e"}
+                       .setDefault("500")
+                       .setHelp("Number of epochs to train the map for").build());
+
+    parser.addArgument(blt::arg_builder{"--size", "-s"}
+                       .setDefault("5")
+                       .setHelp("Width and height of the trained map").build());
+
+    auto args = parser.parse_args(argv_vector);
+
+    if (!args.contains("signals"))
+    {
+        BLT_ERROR("Please provide a signal file to monitor");
+        return;
+    }
+    const auto signals = load_signal_file(args.get<std::string>("signals"));
+    if (!signals)
+        return;
+
+    load_data_files(args.get<std::string>("file"));
+    const auto bins = std::stoul(args.get<std::string>("bins"));
+    const auto found = std::find_if(data.files.begin(), data.files.end(), [bins](const data_file_t& file) {
+        return file.data_points.bin_count() == bins;
+    });
+    if (found == data.files.end())
+    {
+        BLT_ERROR("No data file with %ld bins to train on", bins);
+        return;
+    }
+
+    // frames are normalised, so the map has to be too
+    const auto epochs = std::stoul(args.get<std::string>("epochs"));
+    const auto size = static_cast<blt::u32>(std::stoul(args.get<std::string>("size")));
+    gaussian_function_t topology_func{};
+    auto dist = distance_function_t::from_shape(shape_t::GRID_WRAP, size, size);
+    som_t som{*found, size, size, epochs, dist.get(), &topology_func, shape_t::GRID_WRAP, init_t::SAMPLED_DATA, true};
+    som.set_evaluation_schedule(evaluation_schedule_t::final_only());
+    while (!som.is_finished())
+        som.train_epoch(1);
+
+    // every frame is also checked against the offline extractor run on the same window, the two have to agree
+    sliding_spectrum_t spectrum{bins, std::stoul(args.get<std::string>("hop"))};
+    const feature_extractor_t extractor{bins};
+    const auto window = 2 * bins;
+    std::vector<Scalar> expected(bins);
+    Scalar max_deviation = 0;
+    blt::size_t total_frames = 0, agreeing = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& [i, signal] : blt::enumerate(*signals))
+    {
+        spectrum.reset();
+        data_file_t frames;
+        blt::size_t bad = 0, good = 0;
+        for (blt::size_t s = 0; s < signal.values.size(); s++)
+        {
+            // one sample at a time, as it would arrive from a sensor
+            if (spectrum.push(blt::span<const Scalar>{&signal.values[s], 1}, frames) == 0)
+                continue;
+            const auto live = frames.data_points[frames.data_points.size() - 1].bins;
+
+            extractor.extract(blt::span<const Scalar>{signal.values.data() + s + 1 - window, window}, expected);
+            Scalar magnitude = 0;
+            for (const auto v : expected)
+                magnitude += v * v;
+            magnitude = std::sqrt(magnitude);
+            for (blt::size_t b = 0; b < bins; b++)
+                max_deviation = std::max(max_deviation, std::abs(live[b] - (magnitude > 0 ? expected[b] / magnitude : 0)));
+
+            const auto activation = som.get_array().get_map()[som.get_closest_neuron(live)].get_activation();
+            if (activation <= -som.get_quantization_distance())
+                bad++;
+            else if (activation >= som.get_quantization_distance())
+                good++;
+        }
+        const auto count = frames.data_points.size();
+        total_frames += count;
+        if (count > 0 && (bad > good) == signal.is_bad)
+            agreeing++;
+        BLT_INFO("Capture %ld (%s): %ld frames, %ld bad, %ld good, %ld neutral", i, signal.is_bad ? "bad" : "good", count, bad, good,
+                 count - bad - good);
     }
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BLT_INFO("Monitored %ld captures, %ld frames in %fs, %ld captures classified by frame majority as labelled", signals->size(), total_frames,
+             seconds, agreeing);
+    if (max_deviation > 1e-4)
+        BLT_WARN("Live frames differ from the offline extractor by up to %f", max_deviation);
+    else
+        BLT_INFO("Live frames match the offline extractor to within %e", max_deviation);
 }
 
 int main(int argc, const char** argv)
@@ -799,7 +1863,7 @@ int main(int argc, const char** argv)
 
     parser.addArgument(blt::arg_builder{"action"}
                        .setAction(blt::arg_action_t::SUBCOMMAND)
-                       .setHelp("Action to run. Can be: [graphics, test, convert]").build());
+                       .setHelp("Action to run. Can be: [graphics, test, convert, convert-data, generate, extract, monitor, stream, project, coreset, crossval, joint, sparse, warmstart, replay]").build());
 
     auto copy = argv_vector;
     copy.erase(copy.begin() + 2, copy.end());
@@ -821,4 +1885,28 @@ int main(int argc, const char** argv)
         action_test(argv_vector);
     else if (action == "convert")
         action_convert(argv_vector);
+    else if (action == "project")
+        action_project(argv_vector);
+    else if (action == "coreset")
+        action_coreset(argv_vector);
+    else if (action == "crossval")
+        action_cross_validate(argv_vector);
+    else if (action == "joint")
+        action_joint(argv_vector);
+    else if (action == "sparse")
+        action_sparse(argv_vector);
+    else if (action == "warmstart")
+        action_warm_start(argv_vector);
+    else if (action == "replay")
+        action_replay(argv_vector);
+    else if (action == "convert-data")
+        action_convert_data(argv_vector);
+    else if (action == "stream")
+        action_stream(argv_vector);
+    else if (action == "generate")
+        action_generate(argv_vector);
+    else if (action == "extract")
+        action_extract(argv_vector);
+    else if (action == "monitor")
+        action_monitor(argv_vector);
 }
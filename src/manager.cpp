@@ -16,12 +16,16 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <assign3/manager.h>
+#include <assign3/thread_pool.h>
 #include <blt/gfx/window.h>
 #include <blt/math/log_util.h>
 #include <imgui.h>
 #include <implot.h>
 #include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <random>
+#include <tuple>
 #include <blt/std/system.h>
 #include <blt/std/time.h>
 
@@ -95,22 +99,128 @@ namespace assign3
         return info;
     }
 
+    motor_data_t::~motor_data_t()
+    {
+        stop();
+    }
+
+    void motor_data_t::stop()
+    {
+        stop_loading = true;
+        if (loader.joinable())
+            loader.join();
+    }
+
     void motor_data_t::update()
     {
+        map_files_names.clear();
         for (const auto& data : files)
             map_files_names.emplace_back(std::to_string(data.data_points.begin()->bins.size()));
     }
 
+    void motor_data_t::load_async(const std::string& path)
+    {
+        const auto paths = data_file_t::get_data_file_list(path);
+        blt::size_t first_slot;
+        {
+            std::scoped_lock lock(finished_mutex);
+            first_slot = slots.size();
+            slots.resize(first_slot + paths.size());
+            slot_done.resize(first_slot + paths.size(), false);
+        }
+        total_files += paths.size();
+
+        const auto load = [this, paths, first_slot]() {
+            thread_pool_t::shared().parallel_for(paths.size(), 1, [this, &paths, first_slot](const blt::size_t begin, const blt::size_t end) {
+                for (blt::size_t i = begin; i < end && !stop_loading; i++)
+                {
+                    auto file = data_file_t::load(paths[i]);
+                    if (file && !file->data_points.empty())
+                        file->normalize_in_place();
+                    else
+                    {
+                        BLT_WARN("Unable to load data file '%s', skipping it", paths[i].c_str());
+                        file.reset();
+                    }
+                    {
+                        std::scoped_lock lock(finished_mutex);
+                        slots[first_slot + i] = std::move(file);
+                        slot_done[first_slot + i] = true;
+                    }
+                    ++loaded_files;
+                }
+            });
+        };
+#ifdef __EMSCRIPTEN__
+        // no threads to spare in the browser, the files are preloaded into memory anyway
+        load();
+#else
+        if (loader.joinable())
+            loader.join();
+        loader = std::thread(load);
+#endif
+    }
+
+    bool motor_data_t::poll()
+    {
+        std::vector<data_file_t> arrived;
+        {
+            // a slot is only handed over once every slot before it has been, so files keep directory order and only ever grow at the end,
+            // which keeps the index of the selected file the same
+            std::scoped_lock lock(finished_mutex);
+            for (; next_slot < slots.size() && slot_done[next_slot]; next_slot++)
+            {
+                if (slots[next_slot])
+                    arrived.push_back(std::move(*slots[next_slot]));
+                slots[next_slot].reset();
+            }
+        }
+        if (arrived.empty())
+            return false;
+        for (auto& file : arrived)
+            files.push_back(std::move(file));
+        update();
+        return true;
+    }
+
     void renderer_t::create()
     {
         fr2d.create_default(250, 2048);
         br2d.create();
 
         topology_function = std::make_unique<gaussian_function_t>();
+        convergence_monitor.with(std::make_unique<plateau_monitor_t>(200, 0.005))
+                           .with(std::make_unique<codebook_movement_monitor_t>(200, 0.0005));
 
         regenerate_network();
     }
 
+    void renderer_t::regenerate_network()
+    {
+        // deferred until the selected file has been handed over, render picks it up from there
+        if (currently_selected_network < 0 || static_cast<blt::size_t>(currently_selected_network) >= motor_data.files.size())
+            return;
+        const auto& file = motor_data.files[currently_selected_network];
+        projection = projection_t::make(static_cast<projection_type_t>(selected_projection), file,
+                                        static_cast<blt::size_t>(std::max(projected_dimensions, 1)), std::random_device{}());
+        if (!projection.empty())
+            projected_file = projection.project(file);
+        
+        distance_function = distance_function_t::from_shape(static_cast<shape_t>(selected_som_mode), som_width, som_height);
+        som = std::make_unique<som_t>(get_training_file(), som_width, som_height, max_epochs, distance_function.get(), topology_function.get(),
+                                      static_cast<shape_t>(selected_som_mode), static_cast<init_t>(selected_init_type), normalize_init);
+        if (early_stopping)
+            som->set_convergence_monitor(&convergence_monitor);
+        som->set_drift_tolerance(drift_tolerance);
+        som->set_activation_mode(lattice_activations ? activation_mode_t::LATTICE : activation_mode_t::EXACT);
+        activation_agreement.reset();
+        som->set_history(&history);
+        // the bin picked for the component plane may not exist in the new network's (or projection's) codebook
+        selected_bin = std::clamp(selected_bin, 0, static_cast<int>(som->get_array().get_map().front().get_data().size()) - 1);
+        shown_epoch.reset();
+        network_generation++;
+    }
+
     void renderer_t::cleanup()
     {
         fr2d.cleanup();
@@ -141,12 +251,25 @@ namespace assign3
 
         static Scalar returned_scale = 0;
 
+        if (motor_data.poll() && som == nullptr)
+            regenerate_network();
+        if (som == nullptr)
+        {
+            render_loading();
+            return;
+        }
+
         ImGui::SetNextWindowPos(ImVec2{25, 25}, ImGuiCond_Appearing);
         if (ImGui::Begin("Controls"))
         {
             ImGui::SetNextItemOpen(true, ImGuiCond_Appearing);
             if (ImGui::CollapsingHeader("SOM Control"))
             {
+                if (motor_data.is_loading())
+                {
+                    ImGui::ProgressBar(static_cast<float>(motor_data.get_loaded_files()) /
+                                       static_cast<float>(motor_data.get_total_files()), ImVec2(-1, 0), "Loading data files");
+                }
                 ImGui::Text("Network Select");
                 if (ImGui::ListBox("##Network Select", &currently_selected_network, get_selection_string, motor_data.map_files_names.data(),
                                    static_cast<int>(motor_data.map_files_names.size())))
@@ -173,8 +296,17 @@ namespace assign3
                              init_names[selected_init_type] + ", " + std::to_string(max_epochs) + " Epochs";
                     plot_heatmap(text, motor_data.files[currently_selected_network].data_points.front().bins.size(), sub);
                 }
+                if (!projection.empty() && ImGui::Button("Save Reconstructed Codebook"))
+                {
+                    std::ofstream stream{std::to_string(blt::system::getCurrentTimeMilliseconds()) + "-codebook.csv"};
+                    projection.write_reconstructed_codebook(stream, som->get_array());
+                }
                 ImGui::Checkbox("Run to completion", &running);
+                if (ImGui::Checkbox("Early Stopping", &early_stopping))
+                    som->set_convergence_monitor(early_stopping ? &convergence_monitor : nullptr);
                 ImGui::Text("Epoch %ld / %ld", som->get_current_epoch(), som->get_max_epochs());
+                if (som->has_converged())
+                    ImGui::TextWrapped("%s", som->get_stop_reason().c_str());
             }
             ImGui::SetNextItemOpen(true, ImGuiCond_Appearing);
             if (ImGui::CollapsingHeader("SOM Settings"))
@@ -189,6 +321,16 @@ namespace assign3
                 ImGui::TextWrapped("Help: %s", init_helps[selected_init_type].c_str());
                 if (ImGui::Checkbox("Normalize Init Data", &normalize_init))
                     regenerate_network();
+                ImGui::SeparatorText("Projection");
+                if (ImGui::ListBox("##Projection", &selected_projection, get_selection_string, projection_names.data(),
+                                   static_cast<int>(projection_names.size())))
+                    regenerate_network();
+                if (selected_projection != static_cast<int>(projection_type_t::NONE))
+                {
+                    if (ImGui::InputInt("Projected Dimensions", &projected_dimensions))
+                        regenerate_network();
+                    ImGui::Text("Training in %ld of %ld dimensions", projection.get_output_dimensions(), projection.get_input_dimensions());
+                }
                 ImGui::SeparatorText("Som Specifics");
                 if (ImGui::InputInt("SOM Width", &som_width) || ImGui::InputInt("SOM Height", &som_height) ||
                     ImGui::InputInt("Max Epochs", &max_epochs))
@@ -199,6 +341,45 @@ namespace assign3
                 if (ImGui::InputFloat("Network Activation RBF Scale", &user_rbf_scale))
                     returned_scale = som->compute_neuron_activations(user_rbf_scale);
                 ImGui::Text("Average Scale: %f", returned_scale);
+                if (ImGui::InputFloat("Activation Drift Tolerance", &drift_tolerance))
+                    som->set_drift_tolerance(drift_tolerance);
+                ImGui::Text("Recomputed %ld / %ld neurons", som->get_recomputed_neurons(), som->get_array().get_map().size());
+                if (ImGui::Checkbox("Lattice Activations", &lattice_activations))
+                {
+                    som->set_activation_mode(lattice_activations ? activation_mode_t::LATTICE : activation_mode_t::EXACT);
+                    returned_scale = som->compute_neuron_activations(user_rbf_scale);
+                }
+                if (ImGui::Button("Compare With Exact"))
+                    activation_agreement = som->activation_agreement(user_rbf_scale);
+                if (activation_agreement)
+                    ImGui::Text("Neurons classified alike: %f", *activation_agreement);
+            }
+            if (ImGui::CollapsingHeader("History"))
+            {
+                ImGui::Checkbox("Show Past Epoch", &show_history);
+                ImGui::SliderInt("Epoch", &history_epoch, static_cast<int>(history.first_epoch()), static_cast<int>(history.last_epoch()));
+                if (show_history)
+                {
+                    shown_epoch = history.reconstruct(static_cast<blt::size_t>(history_epoch), history_codebook, history_activations);
+                    if (shown_epoch)
+                    {
+                        Scalar movement = 0;
+                        for (const auto& [i, n] : blt::enumerate(som->get_array().get_map()))
+                        {
+                            for (const auto& [j, v] : blt::enumerate(n.get_data()))
+                            {
+                                const auto d = v - history_codebook[i * n.get_data().size() + j];
+                                movement += d * d;
+                            }
+                        }
+                        ImGui::Text("Showing epoch %ld", *shown_epoch);
+                        ImGui::Text("RMS distance to current codebook: %f",
+                                    std::sqrt(movement / static_cast<Scalar>(som->get_array().get_map().size())));
+                    }
+                } else
+                    shown_epoch.reset();
+                ImGui::Text("%ld frames every %ld epoch(s), %.2f MB", history.frame_count(), history.get_stride(),
+                            static_cast<double>(history.memory_usage()) / (1024.0 * 1024.0));
             }
             if (ImGui::CollapsingHeader("Debug"))
             {
@@ -212,7 +393,7 @@ namespace assign3
                         {
                             ImGui::Checkbox("Data Type Color", &draw_colors);
                             ImGui::Checkbox("Data Lines", &draw_data_lines);
-                            auto current_data_file = motor_data.files[currently_selected_network];
+                            const auto& current_data_file = get_training_file();
                             static std::vector<std::string> names;
                             names.clear();
                             for (const auto& [i, v] : blt::enumerate(current_data_file.data_points))
@@ -236,13 +417,32 @@ namespace assign3
                             ImGui::ListBox("##SelectNeuron", &selected_neuron, get_selection_string, names.data(), static_cast<int>(names.size()));
                         }
                         break;
+                    case debug_t::U_MATRIX:
+                        if (ImGui::Button("Save U-Matrix"))
+                        {
+                            std::ofstream stream{std::to_string(blt::system::getCurrentTimeMilliseconds()) + "-umatrix.csv"};
+                            som->write_u_matrix(stream);
+                        }
+                        break;
+                    case debug_t::COMPONENT_PLANE:
+                        {
+                            const auto bins = static_cast<int>(som->get_array().get_map().front().get_data().size());
+                            ImGui::SliderInt("Bin", &selected_bin, 0, bins - 1);
+                            selected_bin = std::clamp(selected_bin, 0, bins - 1);
+                            if (ImGui::Button("Save Component Plane"))
+                            {
+                                std::ofstream stream{std::to_string(blt::system::getCurrentTimeMilliseconds()) + "-component-plane.csv"};
+                                som->write_component_planes(stream, {static_cast<blt::size_t>(selected_bin)});
+                            }
+                        }
+                        break;
                     }
                 }
             }
         }
         ImGui::End();
 
-        auto current_data_file = motor_data.files[currently_selected_network];
+        const auto& current_data_file = get_training_file();
 
         ImGui::SetNextWindowSize({250, 0}, ImGuiCond_Appearing);
         ImGui::SetNextWindowPos(ImVec2{static_cast<float>(getWindowWidth() - 275), 25}, ImGuiCond_Appearing);
@@ -253,8 +453,13 @@ namespace assign3
             {
                 static std::vector<float> activations;
                 activations.clear();
-                for (const auto& n : som->get_array().get_map())
-                    activations.push_back(n.get_activation());
+                if (shown_epoch)
+                    activations = history_activations;
+                else
+                {
+                    for (const auto& n : som->get_array().get_map())
+                        activations.push_back(n.get_activation());
+                }
                 auto rev = rotate90Clockwise(activations, som_width, som_height);
                 //                auto rev = closest_type;
                 //                std::reverse(rev.begin(), rev.end());
@@ -279,7 +484,7 @@ namespace assign3
 
         if (running)
         {
-            if (som->get_current_epoch() < som->get_max_epochs())
+            if (!som->is_finished())
                 returned_scale = som->train_epoch(initial_learn_rate, user_rbf_scale);
         }
 
@@ -287,9 +492,9 @@ namespace assign3
         if (!debug_mode)
         {
             draw_som(neuron_render_info_t{}.set_base_pos({370, 145}).set_neuron_scale(120).set_neuron_padding({5, 5}),
-                     [](render_data_t context)
+                     [this](render_data_t context)
                      {
-                         auto type = context.neuron.get_activation();
+                         auto type = shown_epoch ? history_activations[context.index] : context.neuron.get_activation();
                          return type >= 0 ? blt::make_color(0, type, 0) : blt::make_color(-type, 0, 0);
                      });
         }
@@ -299,6 +504,25 @@ namespace assign3
         draw_calls();
     }
 
+    void renderer_t::render_loading()
+    {
+        ImGui::SetNextWindowPos(ImVec2{25, 25}, ImGuiCond_Appearing);
+        if (ImGui::Begin("Controls"))
+        {
+            if (motor_data.is_loading())
+            {
+                const auto loaded = motor_data.get_loaded_files();
+                const auto total = motor_data.get_total_files();
+                ImGui::Text("Loading data files %ld / %ld", loaded, total);
+                ImGui::ProgressBar(static_cast<float>(loaded) / static_cast<float>(total), ImVec2(-1, 0));
+            }
+            else
+                ImGui::Text("No data files could be loaded");
+        }
+        ImGui::End();
+        draw_calls();
+    }
+
     void renderer_t::draw_calls()
     {
         br2d.render(0, 0);
@@ -368,13 +592,20 @@ namespace assign3
                 auto& selected_neuron_ref = som->get_array().get_map()[selected_neuron];
                 static std::vector<Scalar> distances_2d;
                 static std::vector<Scalar> distances_nd;
-                distances_2d.clear();
-                distances_nd.clear();
-
-                for (const auto& n : som->get_array().get_map())
+                // only recomputed when the selection or the codebook changes rather than every frame
+                static std::tuple<blt::size_t, blt::size_t, int> computed_for{0, 0, -1};
+                const std::tuple<blt::size_t, blt::size_t, int> current{network_generation, som->get_codebook_version(), selected_neuron};
+                if (computed_for != current)
                 {
-                    distances_2d.push_back(neuron_t::distance(distance_function.get(), selected_neuron_ref, n));
-                    distances_nd.push_back(selected_neuron_ref.dist(n.get_data()));
+                    computed_for = current;
+                    distances_2d.clear();
+                    distances_nd.clear();
+
+                    for (const auto& n : som->get_array().get_map())
+                    {
+                        distances_2d.push_back(neuron_t::distance(distance_function.get(), selected_neuron_ref, n));
+                        distances_nd.push_back(selected_neuron_ref.dist(n.get_data()));
+                    }
                 }
 
                 draw_som(neuron_render_info_t{}.set_base_pos({370, 145}).set_neuron_scale(120).set_neuron_padding({0, 0}),
@@ -393,6 +624,31 @@ namespace assign3
                          });
             }
             break;
+        case debug_t::U_MATRIX:
+            draw_values(som->get_u_matrix());
+            break;
+        case debug_t::COMPONENT_PLANE:
+            draw_values(som->get_component_plane(static_cast<blt::size_t>(selected_bin)));
+            break;
         }
     }
+
+    void renderer_t::draw_values(const std::vector<Scalar>& values)
+    {
+        if (values.empty())
+            return;
+        const auto [min, max] = std::minmax_element(values.begin(), values.end());
+        const auto range = *max - *min;
+        draw_som(neuron_render_info_t{}.set_base_pos({370, 145}).set_neuron_scale(120).set_neuron_padding({0, 0}),
+                 [this, &values, low = *min, range](render_data_t context)
+                 {
+                     auto& text = fr2d.render_text(std::to_string(values[context.index]), 18).setColor(0.2, 0.2, 0.8);
+                     auto text_width = text.getAssociatedText().getTextWidth();
+                     auto text_height = text.getAssociatedText().getTextHeight();
+                     text.setPosition(context.neuron_padded - blt::vec2{text_width / 2.0f, text_height / 2.0f}).setZIndex(1);
+
+                     const auto shade = range > 0 ? (values[context.index] - low) / range : 0;
+                     return blt::make_color(shade, shade, shade);
+                 });
+    }
 }
@@ -18,6 +18,7 @@
 #include <assign3/neuron.h>
 #include <blt/std/random.h>
 #include <blt/iterator/iterator.h>
+#include <algorithm>
 #include <cmath>
 #include "blt/std/logging.h"
 
@@ -61,7 +62,7 @@ namespace assign3
                 break;
             case init_t::SAMPLED_DATA:
             {
-                auto selected = rand.select(file.data_points);
+                const auto selected = file.data_points[rand.get_u64(0, file.data_points.size())];
                 std::memcpy(data.data(), selected.bins.data(), data.size() * sizeof(Scalar));
             }
                 break;
@@ -81,7 +82,7 @@ namespace assign3
     }
     
     // apply the distance based on the update neuron function
-    neuron_t& neuron_t::update(const std::vector<Scalar>& new_data, Scalar dist, Scalar eta)
+    neuron_t& neuron_t::update(const blt::span<const Scalar> new_data, Scalar dist, Scalar eta)
     {
 //        static thread_local std::vector<Scalar> diff;
 //        diff.clear();
@@ -96,12 +97,202 @@ namespace assign3
     }
     
     // distance between an input vector and the neuron, in the n-space
-    Scalar neuron_t::dist(const std::vector<Scalar>& X) const
+    Scalar neuron_t::dist(const blt::span<const Scalar> X) const
     {
         euclidean_distance_function_t dist_func;
         return dist_func.distance(data, X);
     }
     
+    void neuron_t::begin_padded(const std::vector<blt::size_t>& cuts)
+    {
+        segments.clear();
+        blt::size_t begin = 0;
+        for (const auto cut : cuts)
+        {
+            const auto end = std::min(cut, data.size());
+            if (end <= begin)
+                continue;
+            segments.push_back({begin, end});
+            begin = end;
+        }
+        if (begin < data.size())
+            segments.push_back({begin, data.size()});
+        for (auto& segment : segments)
+            apply(segment);
+    }
+
+    void neuron_t::end_padded()
+    {
+        for (auto& segment : segments)
+            apply(segment);
+        segments.clear();
+    }
+
+    void neuron_t::apply(segment_t& segment)
+    {
+        segment.sum = 0;
+        segment.squares = 0;
+        for (blt::size_t i = segment.begin; i < segment.end; i++)
+        {
+            auto& v = data[i];
+            v = v * segment.scale + segment.offset;
+            segment.sum += v;
+            segment.squares += static_cast<double>(v) * v;
+        }
+        segment.scale = 1;
+        segment.offset = 0;
+    }
+
+    neuron_t& neuron_t::update(const padded_view_t& new_data, const Scalar dist, const Scalar eta)
+    {
+        const auto rate = eta * dist;
+        if (segments.empty())
+        {
+            for (blt::size_t i = 0; i < data.size(); i++)
+                data[i] += rate * (new_data[i] - data[i]);
+            return *this;
+        }
+        const auto stored = new_data.bins.size();
+        const double p = new_data.padding;
+        for (auto& segment : segments)
+        {
+            if (segment.begin >= stored)
+            {
+                // every bin moves towards p: v' = (1 - rate) v + rate p, which composes with the pending map and has closed form sums
+                const double keep = 1 - rate;
+                const auto length = static_cast<double>(segment.end - segment.begin);
+                segment.squares = keep * keep * segment.squares + 2 * rate * keep * p * segment.sum + rate * rate * p * p * length;
+                segment.sum = keep * segment.sum + rate * p * length;
+                segment.scale = static_cast<Scalar>(segment.scale * keep);
+                segment.offset = static_cast<Scalar>(segment.offset * keep + rate * p);
+                continue;
+            }
+            apply(segment);
+            segment.sum = 0;
+            segment.squares = 0;
+            for (blt::size_t i = segment.begin; i < segment.end; i++)
+            {
+                auto& v = data[i];
+                v += rate * (new_data[i] - v);
+                segment.sum += v;
+                segment.squares += static_cast<double>(v) * v;
+            }
+        }
+        return *this;
+    }
+
+    Scalar neuron_t::dist(const padded_view_t& X) const
+    {
+        const auto stored = X.bins.size();
+        const double p = X.padding;
+        double total = 0;
+        if (segments.empty())
+        {
+            for (blt::size_t i = 0; i < data.size(); i++)
+            {
+                const auto d = X[i] - data[i];
+                total += d * d;
+            }
+        }
+        for (const auto& segment : segments)
+        {
+            if (segment.begin >= stored)
+            {
+                // sum of (p - v)^2 over the segment
+                total += static_cast<double>(segment.end - segment.begin) * p * p - 2 * p * segment.sum + segment.squares;
+                continue;
+            }
+            for (blt::size_t i = segment.begin; i < segment.end; i++)
+            {
+                const auto d = X[i] - (data[i] * segment.scale + segment.offset);
+                total += d * d;
+            }
+        }
+        return static_cast<Scalar>(std::sqrt(std::max(total, 0.0)));
+    }
+
+    void neuron_t::begin_sparse()
+    {
+        sparse = true;
+        sparse_scale = 1;
+        norm_squared = 0;
+        for (const auto v : data)
+            norm_squared += static_cast<double>(v) * v;
+    }
+
+    void neuron_t::end_sparse()
+    {
+        if (!sparse)
+            return;
+        for (auto& v : data)
+            v *= sparse_scale;
+        sparse_scale = 1;
+        sparse = false;
+    }
+
+    neuron_t& neuron_t::update(const sparse_view_t& new_data, const Scalar dist, const Scalar eta)
+    {
+        const auto rate = eta * dist;
+        if (!sparse)
+        {
+            for (auto& v : data)
+                v -= rate * v;
+            for (const auto& [j, bin] : blt::enumerate(new_data.indices))
+                data[bin] += rate * new_data.values[j];
+            return *this;
+        }
+
+        // w' = (1 - rate) w + rate x, whose norm follows from the old norm and the dot product over the kept bins
+        const double keep = 1 - rate;
+        double dot = 0;
+        double kept = 0;
+        for (const auto& [j, bin] : blt::enumerate(new_data.indices))
+        {
+            dot += static_cast<double>(new_data.values[j]) * data[bin];
+            kept += static_cast<double>(new_data.values[j]) * new_data.values[j];
+        }
+        dot *= sparse_scale;
+        norm_squared = keep * keep * norm_squared + 2 * rate * keep * dot + static_cast<double>(rate) * rate * kept;
+
+        // once the scale gets small the stored values would have to grow to match, so it is folded into them (and the norm recomputed)
+        auto scale = static_cast<Scalar>(sparse_scale * keep);
+        const auto refold = scale < 1e-4f;
+        if (refold)
+        {
+            for (auto& v : data)
+                v *= scale;
+            scale = 1;
+        }
+        sparse_scale = scale;
+        for (const auto& [j, bin] : blt::enumerate(new_data.indices))
+            data[bin] += rate * new_data.values[j] / sparse_scale;
+        if (refold)
+        {
+            norm_squared = 0;
+            for (const auto v : data)
+                norm_squared += static_cast<double>(v) * v;
+        }
+        return *this;
+    }
+
+    Scalar neuron_t::dist(const sparse_view_t& X) const
+    {
+        double dot = 0;
+        for (const auto& [j, bin] : blt::enumerate(X.indices))
+            dot += static_cast<double>(X.values[j]) * data[bin];
+        double norm = norm_squared;
+        if (sparse)
+            dot *= sparse_scale;
+        else
+        {
+            norm = 0;
+            for (const auto v : data)
+                norm += static_cast<double>(v) * v;
+        }
+        // |x - w|^2 = |x|^2 - 2 x.w + |w|^2, the dropped bins of x only count towards |x|^2
+        return static_cast<Scalar>(std::sqrt(std::max(X.norm_squared - 2 * dot + norm, 0.0)));
+    }
+
     // distance between two neurons, in 2d
     Scalar neuron_t::distance(distance_function_t* dist_func, const neuron_t& n1, const neuron_t& n2)
     {
@@ -0,0 +1,80 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/progressive.h>
+#include <blt/iterator/enumerate.h>
+#include <algorithm>
+
+namespace assign3
+{
+    progressive_trainer_t::progressive_trainer_t(const data_file_t& file, const blt::size_t width, const blt::size_t height,
+                                                 const blt::size_t max_epochs, topology_function_t* topology_function, const shape_t shape,
+                                                 const init_t init, const bool normalize, const blt::size_t min_size,
+                                                 const Scalar coarse_fraction): shape(shape)
+    {
+        // halve down from the requested size until the next stage would be smaller than min_size
+        std::vector<std::pair<blt::size_t, blt::size_t>> sizes{{width, height}};
+        while (true)
+        {
+            const auto [w, h] = sizes.back();
+            const auto next_w = (w + 1) / 2;
+            const auto next_h = (h + 1) / 2;
+            if (next_w < min_size || next_h < min_size)
+                break;
+            sizes.emplace_back(next_w, next_h);
+        }
+        std::reverse(sizes.begin(), sizes.end());
+
+        const auto coarse_stages = sizes.size() - 1;
+        const auto coarse_epochs = coarse_stages == 0
+                                       ? 0
+                                       : static_cast<blt::size_t>(static_cast<Scalar>(max_epochs) * coarse_fraction) / coarse_stages;
+        for (const auto& [i, size] : blt::enumerate(sizes))
+        {
+            const auto end = i == coarse_stages ? max_epochs : (i + 1) * coarse_epochs;
+            stages.push_back({size.first, size.second, end});
+        }
+
+        const auto& first = stages.front();
+        dist_func = distance_function_t::from_shape(shape, first.width, first.height);
+        som = std::make_unique<som_t>(file, first.width, first.height, max_epochs, dist_func.get(), topology_function, shape, init, normalize);
+        apply_radius_scale();
+    }
+
+    Scalar progressive_trainer_t::train_epoch(const Scalar initial_learn_rate, const Scalar user_scale)
+    {
+        const auto r = som->train_epoch(initial_learn_rate, user_scale);
+        if (current_stage + 1 < stages.size() && som->get_current_epoch() >= stages[current_stage].end_epoch)
+        {
+            const auto& next = stages[++current_stage];
+            auto next_dist_func = distance_function_t::from_shape(shape, next.width, next.height);
+            som->resize(next.width, next.height, next_dist_func.get());
+            dist_func = std::move(next_dist_func);
+            apply_radius_scale();
+        }
+        return r;
+    }
+
+    void progressive_trainer_t::apply_radius_scale()
+    {
+        // the kernel falls off with squared lattice distance, so the neighbourhood covers the same fraction of a smaller map
+        // when the falloff is scaled by the ratio of the areas
+        const auto& current = stages[current_stage];
+        const auto& last = stages.back();
+        som->set_radius_scale(static_cast<Scalar>(last.width * last.height) / static_cast<Scalar>(current.width * current.height));
+    }
+}
@@ -0,0 +1,336 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/projection.h>
+#include <blt/std/random.h>
+#include <blt/std/assert.h>
+#include <blt/iterator/enumerate.h>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+namespace assign3
+{
+    // cyclic jacobi eigenvalue solver for the small (l x l) symmetric matrix produced by the rayleigh-ritz step
+    // matrix is destroyed, eigenvectors are stored column wise
+    static void symmetric_eigen(std::vector<double>& matrix, blt::size_t n, std::vector<double>& values, std::vector<double>& vectors)
+    {
+        vectors.assign(n * n, 0);
+        for (blt::size_t i = 0; i < n; i++)
+            vectors[i * n + i] = 1;
+
+        for (blt::size_t sweep = 0; sweep < 64; sweep++)
+        {
+            double off = 0;
+            for (blt::size_t i = 0; i < n; i++)
+                for (blt::size_t j = i + 1; j < n; j++)
+                    off += matrix[i * n + j] * matrix[i * n + j];
+            if (off < 1e-20)
+                break;
+
+            for (blt::size_t p = 0; p < n; p++)
+            {
+                for (blt::size_t q = p + 1; q < n; q++)
+                {
+                    const auto apq = matrix[p * n + q];
+                    if (std::abs(apq) < 1e-30)
+                        continue;
+                    const auto theta = (matrix[q * n + q] - matrix[p * n + p]) / (2 * apq);
+                    const auto t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                    const auto c = 1 / std::sqrt(t * t + 1);
+                    const auto s = t * c;
+
+                    for (blt::size_t k = 0; k < n; k++)
+                    {
+                        const auto akp = matrix[k * n + p];
+                        const auto akq = matrix[k * n + q];
+                        matrix[k * n + p] = c * akp - s * akq;
+                        matrix[k * n + q] = s * akp + c * akq;
+                    }
+                    for (blt::size_t k = 0; k < n; k++)
+                    {
+                        const auto apk = matrix[p * n + k];
+                        const auto aqk = matrix[q * n + k];
+                        matrix[p * n + k] = c * apk - s * aqk;
+                        matrix[q * n + k] = s * apk + c * aqk;
+                    }
+                    for (blt::size_t k = 0; k < n; k++)
+                    {
+                        const auto vkp = vectors[k * n + p];
+                        const auto vkq = vectors[k * n + q];
+                        vectors[k * n + p] = c * vkp - s * vkq;
+                        vectors[k * n + q] = s * vkp + c * vkq;
+                    }
+                }
+            }
+        }
+
+        values.resize(n);
+        for (blt::size_t i = 0; i < n; i++)
+            values[i] = matrix[i * n + i];
+    }
+
+    // modified gram-schmidt over the columns of a (rows x cols) row major matrix
+    static void orthonormalize_columns(std::vector<double>& matrix, blt::size_t rows, blt::size_t cols)
+    {
+        for (blt::size_t j = 0; j < cols; j++)
+        {
+            for (blt::size_t i = 0; i < j; i++)
+            {
+                double dot = 0;
+                for (blt::size_t r = 0; r < rows; r++)
+                    dot += matrix[r * cols + i] * matrix[r * cols + j];
+                for (blt::size_t r = 0; r < rows; r++)
+                    matrix[r * cols + j] -= dot * matrix[r * cols + i];
+            }
+            double norm = 0;
+            for (blt::size_t r = 0; r < rows; r++)
+                norm += matrix[r * cols + j] * matrix[r * cols + j];
+            norm = std::sqrt(norm);
+            // rank deficient data (more requested dimensions than samples) leaves a zero column, which projects everything to 0
+            const auto inv = norm > 1e-12 ? 1 / norm : 0.0;
+            for (blt::size_t r = 0; r < rows; r++)
+                matrix[r * cols + j] *= inv;
+        }
+    }
+
+    void projection_t::compute_reconstruction()
+    {
+        // minimum norm inverse, R^T (R R^T)^+. this is just R^T for the orthonormal PCA basis
+        // but makes the random projection's reconstruction the closest point in the row space rather than a noisy estimate
+        const auto k = output_dimensions;
+        std::vector<double> gram(k * k);
+        for (blt::size_t a = 0; a < k; a++)
+            for (blt::size_t b = a; b < k; b++)
+            {
+                double total = 0;
+                for (blt::size_t i = 0; i < input_dimensions; i++)
+                    total += static_cast<double>(basis[a * input_dimensions + i]) * basis[b * input_dimensions + i];
+                gram[a * k + b] = total;
+                gram[b * k + a] = total;
+            }
+
+        std::vector<double> values, vectors;
+        symmetric_eigen(gram, k, values, vectors);
+        const auto largest = values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+
+        std::vector<double> inverse(k * k);
+        for (blt::size_t e = 0; e < k; e++)
+        {
+            if (values[e] <= largest * 1e-9)
+                continue;
+            for (blt::size_t a = 0; a < k; a++)
+                for (blt::size_t b = 0; b < k; b++)
+                    inverse[a * k + b] += vectors[a * k + e] * vectors[b * k + e] / values[e];
+        }
+
+        reconstruction.assign(k * input_dimensions, 0);
+        for (blt::size_t a = 0; a < k; a++)
+            for (blt::size_t b = 0; b < k; b++)
+            {
+                const auto w = static_cast<Scalar>(inverse[a * k + b]);
+                for (blt::size_t i = 0; i < input_dimensions; i++)
+                    reconstruction[a * input_dimensions + i] += w * basis[b * input_dimensions + i];
+            }
+    }
+
+    projection_t projection_t::sparse_random(const blt::size_t input_dimensions, blt::size_t output_dimensions, const blt::size_t seed)
+    {
+        output_dimensions = std::min(output_dimensions, input_dimensions);
+        projection_t projection{input_dimensions, output_dimensions};
+        blt::random::random_t rand{seed};
+
+        const auto s = std::sqrt(static_cast<double>(input_dimensions));
+        const auto probability = 1 / (2 * s);
+        const auto value = static_cast<Scalar>(std::sqrt(s / static_cast<double>(output_dimensions)));
+
+        for (auto& v : projection.basis)
+        {
+            const auto r = rand.get_double(0, 1);
+            if (r < probability)
+                v = value;
+            else if (r < 2 * probability)
+                v = -value;
+            else
+                v = 0;
+        }
+
+        projection.compute_reconstruction();
+        return projection;
+    }
+
+    projection_t projection_t::randomized_pca(const data_file_t& file, blt::size_t output_dimensions, const blt::size_t seed,
+                                              const blt::size_t oversampling, const blt::size_t power_iterations)
+    {
+        const auto rows = file.data_points.size();
+        const auto dims = file.data_points.begin()->bins.size();
+        output_dimensions = std::min(output_dimensions, dims);
+        const auto cols = std::min(output_dimensions + oversampling, dims);
+
+        projection_t projection{dims, output_dimensions};
+
+        for (const auto& point : file.data_points)
+            for (auto [i, v] : blt::enumerate(point.bins))
+                projection.mean[i] += v;
+        for (auto& v : projection.mean)
+            v /= static_cast<Scalar>(rows);
+
+        std::vector<double> centered(rows * dims);
+        for (auto [r, point] : blt::enumerate(file.data_points))
+            for (auto [i, v] : blt::enumerate(point.bins))
+                centered[r * dims + i] = v - projection.mean[i];
+
+        blt::random::random_t rand{seed};
+        std::normal_distribution<double> normal{0, 1};
+        std::vector<double> subspace(dims * cols);
+        for (auto& v : subspace)
+            v = normal(rand);
+        orthonormalize_columns(subspace, dims, cols);
+
+        // sample space image of the subspace, W = X * Z
+        std::vector<double> image(rows * cols);
+        const auto compute_image = [&]() {
+            std::fill(image.begin(), image.end(), 0);
+            for (blt::size_t r = 0; r < rows; r++)
+                for (blt::size_t i = 0; i < dims; i++)
+                {
+                    const auto x = centered[r * dims + i];
+                    for (blt::size_t c = 0; c < cols; c++)
+                        image[r * cols + c] += x * subspace[i * cols + c];
+                }
+        };
+
+        for (blt::size_t iter = 0; iter < power_iterations; iter++)
+        {
+            compute_image();
+            // Z = X^T * W
+            std::fill(subspace.begin(), subspace.end(), 0);
+            for (blt::size_t r = 0; r < rows; r++)
+                for (blt::size_t i = 0; i < dims; i++)
+                {
+                    const auto x = centered[r * dims + i];
+                    for (blt::size_t c = 0; c < cols; c++)
+                        subspace[i * cols + c] += x * image[r * cols + c];
+                }
+            orthonormalize_columns(subspace, dims, cols);
+        }
+
+        // rayleigh-ritz, T = (X * Z)^T (X * Z)
+        compute_image();
+        std::vector<double> small(cols * cols);
+        for (blt::size_t a = 0; a < cols; a++)
+            for (blt::size_t b = 0; b < cols; b++)
+            {
+                double total = 0;
+                for (blt::size_t r = 0; r < rows; r++)
+                    total += image[r * cols + a] * image[r * cols + b];
+                small[a * cols + b] = total;
+            }
+
+        std::vector<double> values, vectors;
+        symmetric_eigen(small, cols, values, vectors);
+
+        std::vector<blt::size_t> order(cols);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&values](const blt::size_t a, const blt::size_t b) {
+            return values[a] > values[b];
+        });
+
+        for (blt::size_t k = 0; k < output_dimensions; k++)
+        {
+            const auto e = order[k];
+            for (blt::size_t i = 0; i < dims; i++)
+            {
+                double total = 0;
+                for (blt::size_t c = 0; c < cols; c++)
+                    total += subspace[i * cols + c] * vectors[c * cols + e];
+                projection.basis[k * dims + i] = static_cast<Scalar>(total);
+            }
+        }
+
+        projection.compute_reconstruction();
+        return projection;
+    }
+
+    projection_t projection_t::make(const projection_type_t type, const data_file_t& file, const blt::size_t output_dimensions,
+                                    const blt::size_t seed)
+    {
+        switch (type)
+        {
+            case projection_type_t::NONE:
+                return {};
+            case projection_type_t::SPARSE_RANDOM:
+                return sparse_random(file.data_points.begin()->bins.size(), output_dimensions, seed);
+            case projection_type_t::RANDOMIZED_PCA:
+                return randomized_pca(file, output_dimensions, seed);
+        }
+        return {};
+    }
+
+    void projection_t::project(const blt::span<const Scalar> in, const blt::span<Scalar> out) const
+    {
+        BLT_ASSERT(in.size() == input_dimensions);
+        BLT_ASSERT(out.size() == output_dimensions);
+        for (blt::size_t k = 0; k < output_dimensions; k++)
+        {
+            const auto* row = &basis[k * input_dimensions];
+            Scalar total = 0;
+            for (blt::size_t i = 0; i < input_dimensions; i++)
+                total += row[i] * (in[i] - mean[i]);
+            out[k] = total;
+        }
+    }
+
+    data_file_t projection_t::project(const data_file_t& file) const
+    {
+        data_file_t projected;
+        projected.data_points.reserve(file.data_points.size(), output_dimensions);
+        for (const auto point : file.data_points)
+            project(point.bins, projected.data_points.emplace_back(output_dimensions, point.is_bad));
+        return projected;
+    }
+
+    void projection_t::reconstruct(const std::vector<Scalar>& in, std::vector<Scalar>& out) const
+    {
+        BLT_ASSERT(in.size() == output_dimensions);
+        out = mean;
+        for (blt::size_t k = 0; k < output_dimensions; k++)
+        {
+            const auto* row = &reconstruction[k * input_dimensions];
+            for (blt::size_t i = 0; i < input_dimensions; i++)
+                out[i] += row[i] * in[k];
+        }
+    }
+
+    void projection_t::write_reconstructed_codebook(std::ostream& out, const array_t& array) const
+    {
+        std::vector<Scalar> full;
+        out << "x,y";
+        for (blt::size_t i = 0; i < input_dimensions; i++)
+            out << ",bin" << i;
+        out << '\n';
+        for (const auto& n : array.get_map())
+        {
+            reconstruct(n.get_data(), full);
+            out << n.get_x() << ',' << n.get_y();
+            for (auto v : full)
+                out << ',' << v;
+            out << '\n';
+        }
+    }
+}
@@ -16,12 +16,15 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <assign3/som.h>
+#include <assign3/spectrum.h>
 #include <random>
 #include <algorithm>
 #include <blt/std/random.h>
 #include <blt/iterator/enumerate.h>
 #include <blt/std/logging.h>
 #include <cstring>
+#include <cmath>
+#include <numeric>
 #include "blt/iterator/zip.h"
 
 namespace assign3
@@ -33,48 +36,370 @@ namespace assign3
     {
         for (auto& v : array.get_map())
             v.randomize(std::random_device{}(), init, normalize, file);
+        evaluator.set_lattice(array, dist_func);
+        async_evaluator.set_lattice(array, dist_func);
         compute_errors();
     }
 
+    som_t::som_t(data_stream_t* stream, blt::size_t width, blt::size_t height, blt::size_t max_epochs, distance_function_t* dist_func,
+                 topology_function_t* topology_function, shape_t shape, init_t init, bool normalize, blt::size_t resident_samples):
+        array(stream->get_bins(), width, height, shape), file(stream->sample(resident_samples, std::random_device{}())), stream(stream),
+        max_epochs(max_epochs), dist_func(dist_func), topology_function(topology_function)
+    {
+        for (auto& v : array.get_map())
+            v.randomize(std::random_device{}(), init, normalize, file);
+        evaluator.set_lattice(array, dist_func);
+        async_evaluator.set_lattice(array, dist_func);
+        compute_errors();
+    }
+
+    som_t::som_t(const padded_dataset_t* data, blt::size_t width, blt::size_t height, blt::size_t max_epochs, distance_function_t* dist_func,
+                 topology_function_t* topology_function, shape_t shape, init_t init, bool normalize, blt::size_t resident_samples):
+        array(data->bin_count(), width, height, shape), file(data->sample(resident_samples, std::random_device{}())), padded(data),
+        max_epochs(max_epochs), dist_func(dist_func), topology_function(topology_function)
+    {
+        for (auto& v : array.get_map())
+            v.randomize(std::random_device{}(), init, normalize, file);
+        evaluator.set_lattice(array, dist_func);
+        async_evaluator.set_lattice(array, dist_func);
+        compute_errors();
+    }
+
+    som_t::som_t(const data_file_t& file, const som_t& trained, blt::size_t max_epochs, distance_function_t* dist_func,
+                 topology_function_t* topology_function, Scalar schedule_start):
+        array(file.data_points.begin()->bins.size(), trained.array.get_width(), trained.array.get_height(), trained.array.get_shape()),
+        file(file), max_epochs(max_epochs), dist_func(dist_func), topology_function(topology_function), schedule_start(schedule_start)
+    {
+        const auto bins = file.data_points.begin()->bins.size();
+        for (auto [i, n] : blt::enumerate(array.get_map()))
+            n.set_data(resample_spectrum(trained.array.get_map()[i].get_data(), bins));
+        evaluator.set_lattice(array, dist_func);
+        async_evaluator.set_lattice(array, dist_func);
+        compute_errors();
+    }
+
+    som_t::~som_t()
+    {
+        finish_evaluations();
+    }
+
     Scalar som_t::train_epoch(const Scalar initial_learn_rate, const Scalar user_scale)
     {
-        blt::random::random_t rand{std::random_device{}()};
-        std::shuffle(file.data_points.begin(), file.data_points.end(), rand);
+        collect_evaluations();
 
-        const auto time_ratio = static_cast<Scalar>(current_epoch) / static_cast<Scalar>(max_epochs);
-        const auto eta = initial_learn_rate * std::exp(-2 * time_ratio);
+        previous_codebook.clear();
+        for (const auto& n : array.get_map())
+            previous_codebook.insert(previous_codebook.end(), n.get_data().begin(), n.get_data().end());
 
-        for (auto& [is_bad, bins] : file.data_points)
-        {
-            const auto v0_idx = get_closest_neuron(bins);
-            auto& v0 = array.get_map()[v0_idx];
-            // v0.update(bins, v0.dist(bins), eta);
+        const auto time_ratio = schedule_start + (1 - schedule_start) * static_cast<Scalar>(current_epoch) / static_cast<Scalar>(max_epochs);
+        const auto eta = initial_learn_rate * std::exp(-2 * time_ratio);
 
-            // find the closest neighbour neuron to v0
-            const auto distance_min = find_closest_neighbour_distance(v0_idx);
-            // this will find the required scaling factor to make a point in the middle between v0 and its closest neighbour activate 50%
-            // from the perspective of the gaussian function
-            const auto scale = topology_function->scale(distance_min * 0.5f, 0.5);
+        // weights are taken relative to the mean weight, so a coreset keeps the same overall learning rate as unweighted data
+        // while heavier samples pull proportionally harder
+        const auto sample_eta = [eta](const bool weighted, const Scalar weight, const Scalar weight_normalizer) {
+            return weighted ? std::min(eta * weight * weight_normalizer, static_cast<Scalar>(1)) : eta;
+        };
+        // shuffle the presentation order rather than the data itself so per sample state (weights) stays lined up
+        const auto shuffle_order = [this](const blt::size_t samples) {
+            if (order.size() != samples)
+            {
+                order.resize(samples);
+                std::iota(order.begin(), order.end(), 0);
+            }
+            blt::random::random_t rand{std::random_device{}()};
+            std::shuffle(order.begin(), order.end(), rand);
+        };
 
-            for (auto [i, n] : blt::enumerate(array.get_map()))
+        if (stream != nullptr)
+        {
+            // chunks come back already shuffled, within and across chunks
+            const auto weight_normalizer = static_cast<Scalar>(stream->get_samples()) / stream->total_weight();
+            stream->begin_pass(true, std::random_device{}());
+            while (const auto* chunk = stream->next())
             {
-                if (i == v0_idx)
-                    continue;
-                const auto dist = topology_function->call(neuron_t::distance(dist_func, v0, n), time_ratio * scale);
-                n.update(bins, dist, eta);
+                for (const auto& [sample, point] : blt::enumerate(chunk->data_points))
+                    train_sample(point.bins, sample_eta(!chunk->weights.empty(), chunk->weight(sample), weight_normalizer), time_ratio);
             }
+        } else if (padded != nullptr)
+        {
+            shuffle_order(padded->size());
+            bool weighted = false;
+            for (const auto& f : padded->get_files())
+                weighted |= !f.weights.empty();
+            const auto weight_normalizer = static_cast<Scalar>(padded->size()) / padded->total_weight();
+
+            for (auto& n : array.get_map())
+                n.begin_padded(padded->get_cuts());
+            for (const auto sample : order)
+                train_sample((*padded)[sample], sample_eta(weighted, weighted ? padded->weight(sample) : 1, weight_normalizer), time_ratio);
+            for (auto& n : array.get_map())
+                n.end_padded();
+        } else if (sparse_file)
+        {
+            shuffle_order(sparse_file->size());
+            const auto weight_normalizer = static_cast<Scalar>(file.data_points.size()) / file.total_weight();
+            for (auto& n : array.get_map())
+                n.begin_sparse();
+            for (const auto sample : order)
+                train_sample((*sparse_file)[sample], sample_eta(!file.weights.empty(), file.weight(sample), weight_normalizer), time_ratio);
+            for (auto& n : array.get_map())
+                n.end_sparse();
+        } else
+        {
+            shuffle_order(file.data_points.size());
+            const auto weight_normalizer = static_cast<Scalar>(file.data_points.size()) / file.total_weight();
+            for (const auto sample : order)
+                train_sample(file.data_points[sample].bins, sample_eta(!file.weights.empty(), file.weight(sample), weight_normalizer), time_ratio);
         }
         current_epoch++;
-        return compute_errors(user_scale);
+        codebook_version++;
+
+        Scalar movement = 0;
+        auto previous = previous_codebook.begin();
+        for (const auto& n : array.get_map())
+        {
+            for (const auto v : n.get_data())
+            {
+                const auto d = v - *previous++;
+                movement += d * d;
+            }
+        }
+        codebook_movements.push_back(std::sqrt(movement / static_cast<Scalar>(array.get_map().size())));
+
+        if (schedule.should_evaluate(current_epoch, max_epochs))
+        {
+            // the stream only runs one pass at a time, which training needs next epoch
+            if (async_evaluation && stream == nullptr && padded == nullptr)
+                submit_evaluation(user_scale);
+            else
+                compute_errors(user_scale);
+        }
+
+        if (current_epoch >= max_epochs)
+            finish_evaluations();
+
+        if (history != nullptr)
+            history->record(current_epoch, evaluator_t::snapshot(array), get_activations());
+
+        check_convergence();
+
+        return last_scale;
     }
 
-    blt::size_t som_t::get_closest_neuron(const std::vector<Scalar>& data)
+    template <typename Sample>
+    void som_t::train_sample(const Sample& bins, const Scalar eta, const Scalar time_ratio)
+    {
+        const auto v0_idx = get_closest_neuron(bins);
+        auto& v0 = array.get_map()[v0_idx];
+        // v0.update(bins, v0.dist(bins), eta);
+
+        // find the closest neighbour neuron to v0
+        const auto distance_min = find_closest_neighbour_distance(v0_idx);
+        // this will find the required scaling factor to make a point in the middle between v0 and its closest neighbour activate 50%
+        // from the perspective of the gaussian function
+        const auto scale = topology_function->scale(distance_min * 0.5f, 0.5);
+
+        for (auto [i, n] : blt::enumerate(array.get_map()))
+        {
+            if (i == v0_idx)
+                continue;
+            const auto dist = topology_function->call(neuron_t::distance(dist_func, v0, n), time_ratio * scale * radius_scale);
+            n.update(bins, dist, eta);
+        }
+    }
+
+    void som_t::check_convergence()
+    {
+        if (convergence_monitor == nullptr || converged)
+            return;
+        if (auto reason = convergence_monitor->should_stop(*this))
+        {
+            converged = true;
+            stop_reason = "Stopped at epoch " + std::to_string(current_epoch) + ": " + *reason;
+            finish_evaluations();
+        }
+    }
+
+    void som_t::submit_evaluation(const Scalar user_scale)
+    {
+        finish_evaluations();
+
+        // the snapshot is immutable and owned by the task, training can keep changing the map as soon as it is taken
+        auto snapshot = std::make_shared<const std::vector<Scalar>>(evaluator_t::snapshot(array));
+        std::shared_ptr<const sample_plan_t> plan;
+        if (sampler)
+            plan = std::make_shared<const sample_plan_t>(sampler->draw(file, std::random_device{}()));
+        const auto confidence = sampler ? sampler->get_confidence() : 0;
+
+        pending_result = std::make_shared<evaluation_t>();
+        pending_snapshot = snapshot;
+        pending_epoch = current_epoch;
+        std::function<void()> task = [this, snapshot, plan, confidence, result = pending_result, user_scale,
+                quantization_distance = quantization_distance]() {
+            if (plan)
+                *result = async_evaluator.estimate(*snapshot, *plan, *topology_function, user_scale, 2, 0.5, quantization_distance, confidence);
+            else
+                *result = async_evaluator.evaluate(*snapshot, file, *topology_function, user_scale, 2, 0.5, quantization_distance);
+        };
+        pending_task = thread_pool_t::shared().try_submit(task);
+        if (pending_task == nullptr)
+        {
+            // every worker is busy (say training other maps), queued the evaluation would only run once the next one waits for it.
+            // Evaluating now at least doesn't hold the results back
+            pending_task = std::make_shared<pending_task_t>(std::move(task));
+            finish_evaluations();
+        }
+    }
+
+    void som_t::collect_evaluations()
+    {
+        if (pending_task != nullptr && pending_task->is_done())
+            finish_evaluations();
+    }
+
+    void som_t::finish_evaluations()
+    {
+        if (pending_task == nullptr)
+            return;
+        pending_task->wait();
+        record_evaluation(pending_epoch, *pending_result, *pending_snapshot);
+        pending_task = nullptr;
+        pending_result = nullptr;
+        pending_snapshot = nullptr;
+    }
+
+    void som_t::record_evaluation(const blt::size_t epoch, const evaluation_t& evaluation, const std::vector<Scalar>& codebook)
+    {
+        if (trace != nullptr && evaluation.first_bmus.size() == file.data_points.size())
+            trace->record(epoch, evaluation.first_bmus, evaluation.second_bmus, codebook, evaluation.activations);
+
+        apply_activations(evaluation.activations);
+        topological_errors.push_back(evaluation.topological_error);
+        quantization_errors.push_back(evaluation.quantization_error);
+        error_epochs.push_back(epoch);
+        topological_intervals.push_back(evaluation.topological_interval);
+        quantization_intervals.push_back(evaluation.quantization_interval);
+        last_scale = evaluation.scale_average;
+        if (sampler)
+            sampler->update(evaluation);
+    }
+
+    void som_t::set_trace(bmu_trace_t* new_trace)
+    {
+        finish_evaluations();
+        trace = new_trace;
+        evaluator.set_keep_matches(trace != nullptr);
+        async_evaluator.set_keep_matches(trace != nullptr);
+        if (trace != nullptr)
+            trace->begin(file, array, evaluator);
+    }
+
+    void som_t::set_history(codebook_history_t* new_history)
+    {
+        history = new_history;
+        if (history == nullptr)
+            return;
+        history->begin(array.get_map().size(), file.data_points.front().bins.size());
+        history->record(current_epoch, evaluator_t::snapshot(array), get_activations());
+    }
+
+    void som_t::set_drift_tolerance(const Scalar tolerance)
+    {
+        // the evaluation in flight may be using the async evaluator's rows
+        finish_evaluations();
+        evaluator.set_incremental(&file, tolerance);
+        async_evaluator.set_incremental(&file, tolerance);
+    }
+
+    void som_t::set_activation_mode(const activation_mode_t mode)
+    {
+        finish_evaluations();
+        evaluator.set_activation_mode(mode);
+        async_evaluator.set_activation_mode(mode);
+    }
+
+    Scalar som_t::activation_agreement(const Scalar user_scale)
+    {
+        const auto codebook = evaluator_t::snapshot(array);
+        const auto mode = evaluator.get_activation_mode();
+        std::vector<Scalar> exact, lattice;
+        evaluator.set_activation_mode(activation_mode_t::EXACT);
+        evaluator.compute_activations(codebook, file, *topology_function, user_scale, 2, 0.5, exact);
+        evaluator.set_activation_mode(activation_mode_t::LATTICE);
+        evaluator.compute_activations(codebook, file, *topology_function, user_scale, 2, 0.5, lattice);
+        evaluator.set_activation_mode(mode);
+        return evaluator_t::classification_agreement(exact, lattice, quantization_distance);
+    }
+
+    Scalar som_t::evaluated_weight() const
+    {
+        if (stream != nullptr)
+            return stream->total_weight();
+        if (padded != nullptr)
+            return padded->total_weight();
+        return file.total_weight();
+    }
+
+    void som_t::set_sparse_training(const blt::size_t k)
+    {
+        // streamed and padded maps have no file of their own, checking k against it would quietly train dense instead
+        if (stream != nullptr || padded != nullptr)
+        {
+            if (k != 0)
+                BLT_WARN("Sparse training only applies to SOMs training from their file, ignoring it");
+            return;
+        }
+        if (k == 0 || k >= file.data_points.bin_count())
+        {
+            sparse_file.reset();
+            return;
+        }
+        sparse_file = sparse_file_t::encode(file, k);
+    }
+
+    Scalar som_t::sparse_bmu_agreement()
+    {
+        if (!sparse_file)
+            return 1;
+        Scalar agreeing = 0;
+        for (blt::size_t i = 0; i < sparse_file->size(); i++)
+        {
+            if (get_closest_neuron((*sparse_file)[i]) == get_closest_neuron(file.data_points[i].bins))
+                agreeing += file.weight(i);
+        }
+        return agreeing / file.total_weight();
+    }
+
+    void som_t::set_error_estimation(const Scalar interval_width, const Scalar confidence)
+    {
+        if (interval_width <= 0)
+            sampler.reset();
+        else
+            sampler.emplace(interval_width, confidence);
+    }
+
+    void som_t::resize(const blt::size_t width, const blt::size_t height, distance_function_t* new_dist_func)
+    {
+        // the evaluation in flight still belongs to the old lattice
+        finish_evaluations();
+        set_trace(nullptr);
+        set_history(nullptr);
+        array = array.resized(width, height);
+        codebook_version++;
+        dist_func = new_dist_func;
+        evaluator.set_lattice(array, dist_func);
+        async_evaluator.set_lattice(array, dist_func);
+        compute_neuron_activations();
+    }
+
+    template <typename Sample>
+    blt::size_t som_t::find_closest_neuron(const Sample& sample)
     {
         blt::size_t index = 0;
         Scalar distance = std::numeric_limits<Scalar>::max();
         for (auto [i, d] : blt::enumerate(array.get_map()))
         {
-            auto dist = d.dist(data);
+            auto dist = d.dist(sample);
             if (dist < distance)
             {
                 index = i;
@@ -84,15 +409,24 @@ namespace assign3
         return index;
     }
 
+    blt::size_t som_t::get_closest_neuron(const blt::span<const Scalar> data)
+    {
+        return find_closest_neuron(data);
+    }
+
+    blt::size_t som_t::get_closest_neuron(const padded_view_t& data)
+    {
+        return find_closest_neuron(data);
+    }
+
+    blt::size_t som_t::get_closest_neuron(const sparse_view_t& data)
+    {
+        return find_closest_neuron(data);
+    }
+
     Scalar som_t::find_closest_neighbour_distance(blt::size_t v0)
     {
-        Scalar distance_min = std::numeric_limits<Scalar>::max();
-        for (const auto& [i, n] : blt::enumerate(array.get_map()))
-        {
-            if (i != v0)
-                distance_min = std::min(distance_min, neuron_t::distance(dist_func, array.get_map()[v0], n));
-        }
-        return distance_min;
+        return evaluator.get_neighbour_distance(v0);
     }
 
     struct distance_data_t
@@ -115,7 +449,7 @@ namespace assign3
         }
     };
 
-    blt::vec2 som_t::get_topological_position(const std::vector<Scalar>& data)
+    blt::vec2 som_t::get_topological_position(const blt::span<const Scalar> data)
     {
         std::vector<distance_data_t> distances;
         for (auto [i, d] : blt::enumerate(get_array().get_map()))
@@ -144,96 +478,119 @@ namespace assign3
 
     Scalar som_t::topological_error()
     {
-        Scalar total = 0;
-        std::vector<std::pair<blt::size_t, Scalar>> distances;
+        return topological_error(file);
+    }
 
-        for (const auto& [is_bad, bins] : file.data_points)
-        {
-            distances.clear();
-            for (const auto& [i, n] : blt::enumerate(array.get_map()))
-                distances.emplace_back(i, n.dist(bins));
+    Scalar som_t::topological_error(const data_file_t& data)
+    {
+        return evaluator.topological_error(evaluator_t::snapshot(array), data);
+    }
 
-            std::pair<blt::size_t, Scalar> min1 = {0, std::numeric_limits<Scalar>::max()};
-            std::pair<blt::size_t, Scalar> min2 = {0, std::numeric_limits<Scalar>::max()};
+    Scalar som_t::compute_neuron_activations(const Scalar user_scale, const Scalar distance, const Scalar activation)
+    {
+        std::vector<Scalar> activations;
+        const auto r = evaluator.compute_activations(evaluator_t::snapshot(array), file, *topology_function, user_scale, distance, activation,
+                                                     activations);
+        apply_activations(activations);
+        return r;
+    }
 
-            for (const auto& elem : distances)
-            {
-                if (elem.second < min1.second)
-                {
-                    min2 = min1;
-                    min1 = elem;
-                }
-                else if (elem.second < min2.second)
-                    min2 = elem;
-            }
+    void som_t::apply_activations(const std::vector<Scalar>& activations)
+    {
+        for (auto [n, a] : blt::in_pairs(array.get_map(), activations))
+            n.set_activation(a);
+    }
 
-            // we can assert the neurons are neighbours if the distance between the BMUs and the nearest neighbour are equal.
-            const auto min_distances = neuron_t::distance(dist_func, array.get_map()[min1.first], array.get_map()[min2.first]);
-            auto neighbour_distances = find_closest_neighbour_distance(min1.first);
+    std::vector<Scalar> som_t::get_activations() const
+    {
+        std::vector<Scalar> activations;
+        for (const auto& n : array.get_map())
+            activations.push_back(n.get_activation());
+        return activations;
+    }
 
-            if (!blt::f_equal(min_distances, neighbour_distances))
-                total += 1;
-        }
+    void som_t::validate_analysis()
+    {
+        if (analysis_version == codebook_version)
+            return;
+        analysis_version = codebook_version;
+        u_matrix.clear();
+        component_planes.clear();
+    }
 
-        return total / static_cast<Scalar>(file.data_points.size());
+    const std::vector<Scalar>& som_t::get_u_matrix()
+    {
+        validate_analysis();
+        if (u_matrix.empty())
+            u_matrix = evaluator.u_matrix(evaluator_t::snapshot(array));
+        return u_matrix;
     }
 
-    Scalar som_t::compute_neuron_activations(const Scalar user_scale, const Scalar distance, const Scalar activation)
+    const std::vector<Scalar>& som_t::get_component_plane(const blt::size_t bin)
     {
-        for (auto& n : array.get_map())
-            n.set_activation(0);
+        static const std::vector<Scalar> empty;
+        if (bin >= array.get_map().front().get_data().size())
+            return empty;
+        compute_component_planes({bin});
+        return component_planes[bin];
+    }
 
-        Scalar min = std::numeric_limits<Scalar>::max();
-        Scalar max = std::numeric_limits<Scalar>::min();
-        Scalar global_scale_avg = 0;
+    void som_t::compute_component_planes(const std::vector<blt::size_t>& bins)
+    {
+        validate_analysis();
+        component_planes.resize(array.get_map().front().get_data().size());
 
-        for (auto [i, v] : blt::enumerate(array.get_map()))
+        std::vector<blt::size_t> missing;
+        for (const auto bin : bins)
         {
-            const auto half = find_closest_neighbour_distance(i) / distance;
-            const auto scale = user_scale * topology_function->scale(half, activation);
-            global_scale_avg+=scale;
-            for (const auto& [is_bad, bins] : file.data_points)
+            if (bin < component_planes.size() && component_planes[bin].empty() &&
+                std::find(missing.begin(), missing.end(), bin) == missing.end())
+                missing.push_back(bin);
+        }
+
+        // every plane is written by exactly one task, the outer vector isn't resized while they run
+        thread_pool_t::shared().parallel_for(missing.size(), 1, [this, &missing](const blt::size_t begin, const blt::size_t end) {
+            for (blt::size_t i = begin; i < end; i++)
             {
-                const auto ds = topology_function->call(v.dist(bins), scale);
-                if (is_bad)
-                    v.activate(-ds);
-                else
-                    v.activate(ds);
+                auto& plane = component_planes[missing[i]];
+                plane.reserve(array.get_map().size());
+                for (const auto& n : array.get_map())
+                    plane.push_back(n.get_data()[missing[i]]);
             }
+        });
+    }
+
+    void som_t::write_u_matrix(std::ostream& out)
+    {
+        const auto& heights = get_u_matrix();
+        out << "x,y,distance\n";
+        for (const auto& [i, v] : blt::enumerate(array.get_map()))
+            out << v.get_x() << ',' << v.get_y() << ',' << heights[i] << '\n';
+    }
 
-            min = std::min(min, v.get_activation());
-            max = std::max(max, v.get_activation());
+    void som_t::write_component_planes(std::ostream& out, const std::vector<blt::size_t>& bins)
+    {
+        compute_component_planes(bins);
+        std::vector<blt::size_t> valid;
+        for (const auto bin : bins)
+        {
+            if (bin < component_planes.size())
+                valid.push_back(bin);
+            else
+                BLT_WARN("Bin %ld is out of range for a map of %ld bins, skipping its component plane", bin, component_planes.size());
         }
 
-        // for (auto [i, v] : blt::enumerate(array.get_map()))
-        // {
-        //     Scalar half = std::numeric_limits<Scalar>::max();
-        //     for (auto [j, d] : blt::enumerate(array.get_map()))
-        //     {
-        //         if (i == j)
-        //             continue;
-        //         const auto dist = d.dist(v.get_data());
-        //         if (dist < half)
-        //             half = dist;
-        //     }
-        //     const auto scale = topology_function->scale(half / distance, activation);
-        //
-        //     for (const auto& [is_bad, bins] : file.data_points)
-        //     {
-        //         const auto ds = topology_function->call(v.dist(bins), scale);
-        //         if (is_bad)
-        //             v.activate(-ds);
-        //         else
-        //             v.activate(ds);
-        //     }
-        //     min = std::min(min, v.get_activation());
-        //     max = std::max(max, v.get_activation());
-        // }
-
-        for (auto& n : array.get_map())
-            n.set_activation(2 * (n.get_activation() - min) / (max - min) - 1);
-
-        return global_scale_avg / static_cast<Scalar>(array.get_map().size());
+        out << "x,y";
+        for (const auto bin : valid)
+            out << ",bin " << bin;
+        out << '\n';
+        for (const auto& [i, v] : blt::enumerate(array.get_map()))
+        {
+            out << v.get_x() << ',' << v.get_y();
+            for (const auto bin : valid)
+                out << ',' << component_planes[bin][i];
+            out << '\n';
+        }
     }
 
     void som_t::write_activations(std::ostream& out)
@@ -247,14 +604,14 @@ namespace assign3
     {
         out << "epoch,error\n";
         for (auto [i, v] : blt::enumerate(topological_errors))
-            out << i << ',' << v << '\n';
+            out << error_epochs[i] << ',' << v << '\n';
     }
 
     void som_t::write_quantization_errors(std::ostream& out)
     {
         out << "epoch,error\n";
         for (auto [i, v] : blt::enumerate(quantization_errors))
-            out << i << ',' << v << '\n';
+            out << error_epochs[i] << ',' << v << '\n';
     }
 
     void som_t::write_all_errors(std::ostream& out)
@@ -263,42 +620,41 @@ namespace assign3
         for (auto [i, v] : blt::in_pairs(topological_errors, quantization_errors).enumerate())
         {
             auto [t, q] = v;
-            out << i << ',' << t << ',' << q << '\n';
+            out << error_epochs[i] << ',' << t << ',' << q << '\n';
         }
     }
 
     Scalar som_t::quantization_error()
     {
-        Scalar incorrect = 0;
-
-        for (const auto& point : file.data_points)
-        {
-            const auto& nearest = array.get_map()[get_closest_neuron(point.bins)];
-
-            const bool is_neural = nearest.get_activation() > -quantization_distance && nearest.get_activation() < quantization_distance;
-
-            if (is_neural)
-            {
-                incorrect++;
-                continue;
-            }
-
-            const bool is_bad = nearest.get_activation() <= -quantization_distance;
-            const bool is_good = nearest.get_activation() >= quantization_distance;
-
-            if ((is_bad && point.is_bad) || (is_good && !point.is_bad))
-                continue;
-            incorrect++;
-        }
+        return quantization_error(file);
+    }
 
-        return incorrect;
+    Scalar som_t::quantization_error(const data_file_t& data)
+    {
+        return evaluator.quantization_error(evaluator_t::snapshot(array), data, get_activations(), quantization_distance);
     }
 
     Scalar som_t::compute_errors(const Scalar user_scale)
     {
-        const auto r = compute_neuron_activations(user_scale);
-        topological_errors.push_back(topological_error());
-        quantization_errors.push_back(quantization_error());
-        return r;
+        // keep the errors in epoch order
+        finish_evaluations();
+        // activations and both errors share one distance block
+        const auto codebook = evaluator_t::snapshot(array);
+        if (stream != nullptr)
+            record_evaluation(current_epoch, evaluator.evaluate(codebook, *stream, *topology_function, user_scale, 2, 0.5, quantization_distance),
+                              codebook);
+        else if (padded != nullptr)
+            record_evaluation(current_epoch, evaluator.evaluate(codebook, *padded, *topology_function, user_scale, 2, 0.5, quantization_distance),
+                              codebook);
+        else if (sampler)
+        {
+            const auto plan = sampler->draw(file, std::random_device{}());
+            record_evaluation(current_epoch, evaluator.estimate(codebook, plan, *topology_function, user_scale, 2, 0.5, quantization_distance,
+                                                                sampler->get_confidence()), codebook);
+        }
+        else
+            record_evaluation(current_epoch, evaluator.evaluate(codebook, file, *topology_function, user_scale, 2, 0.5, quantization_distance),
+                              codebook);
+        return last_scale;
     }
 }
@@ -0,0 +1,109 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/sparse.h>
+#include <assign3/thread_pool.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace assign3
+{
+    sparse_file_t sparse_file_t::encode(const data_file_t& file, const blt::size_t k)
+    {
+        sparse_file_t sparse;
+        sparse.bins = file.data_points.bin_count();
+        sparse.k = std::min(k, sparse.bins);
+        const auto samples = file.data_points.size();
+        sparse.indices.resize(samples * sparse.k);
+        sparse.values.resize(samples * sparse.k);
+        sparse.norms_squared.resize(samples);
+        sparse.residuals_squared.resize(samples);
+        sparse.labels.resize(samples);
+        sparse.weights = file.weights;
+
+        thread_pool_t::shared().parallel_for(samples, 256, [&](const blt::size_t begin, const blt::size_t end) {
+            std::vector<blt::u32> order(sparse.bins);
+            for (blt::size_t i = begin; i < end; i++)
+            {
+                const auto point = file.data_points[i];
+                std::iota(order.begin(), order.end(), 0);
+                std::nth_element(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(sparse.k), order.end(),
+                                 [&point](const blt::u32 a, const blt::u32 b) {
+                                     return std::abs(point.bins[a]) > std::abs(point.bins[b]);
+                                 });
+                // ascending bins keep the codebook reads in order
+                std::sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(sparse.k));
+
+                double total = 0;
+                for (const auto v : point.bins)
+                    total += static_cast<double>(v) * v;
+                double kept = 0;
+                for (blt::size_t j = 0; j < sparse.k; j++)
+                {
+                    const auto bin = order[j];
+                    sparse.indices[i * sparse.k + j] = bin;
+                    sparse.values[i * sparse.k + j] = point.bins[bin];
+                    kept += static_cast<double>(point.bins[bin]) * point.bins[bin];
+                }
+                sparse.norms_squared[i] = static_cast<Scalar>(total);
+                sparse.residuals_squared[i] = static_cast<Scalar>(std::max(total - kept, 0.0));
+                sparse.labels[i] = point.is_bad;
+            }
+        });
+        return sparse;
+    }
+
+    sparse_view_t sparse_file_t::operator[](const blt::size_t index) const
+    {
+        return {labels[index] != 0, blt::span<const blt::u32>{indices.data() + index * k, k}, blt::span<const Scalar>{values.data() + index * k, k},
+                norms_squared[index]};
+    }
+
+    data_t sparse_file_t::decode(const blt::size_t index) const
+    {
+        data_t data{labels[index] != 0, std::vector<Scalar>(bins)};
+        for (blt::size_t j = 0; j < k; j++)
+            data.bins[indices[index * k + j]] = values[index * k + j];
+        return data;
+    }
+
+    Scalar sparse_file_t::residual_ratio(const blt::size_t index) const
+    {
+        return norms_squared[index] > 0 ? residuals_squared[index] / norms_squared[index] : 0;
+    }
+
+    Scalar sparse_file_t::mean_residual_ratio() const
+    {
+        Scalar total = 0;
+        Scalar total_weight = 0;
+        for (blt::size_t i = 0; i < size(); i++)
+        {
+            total += residual_ratio(i) * weight(i);
+            total_weight += weight(i);
+        }
+        return total_weight > 0 ? total / total_weight : 0;
+    }
+
+    Scalar sparse_file_t::max_residual_ratio() const
+    {
+        Scalar max = 0;
+        for (blt::size_t i = 0; i < size(); i++)
+            max = std::max(max, residual_ratio(i));
+        return max;
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/spectrum.h>
+#include <algorithm>
+#include <cmath>
+
+namespace assign3
+{
+    std::vector<Scalar> resample_spectrum(const std::vector<Scalar>& bins, const blt::size_t new_size)
+    {
+        std::vector<Scalar> resampled(new_size);
+        if (bins.empty() || new_size == 0)
+            return resampled;
+
+        // work in units of 1 / (old * new) so both sets of band edges land on integers
+        const auto old_size = bins.size();
+        for (blt::size_t j = 0; j < new_size; j++)
+        {
+            const auto begin = j * old_size;
+            const auto end = begin + old_size;
+            double power = 0;
+            for (blt::size_t i = begin / new_size; i < old_size && i * new_size < end; i++)
+            {
+                const auto overlap = std::min(end, (i + 1) * new_size) - std::max(begin, i * new_size);
+                power += static_cast<double>(bins[i]) * static_cast<double>(bins[i]) * static_cast<double>(overlap) / static_cast<double>(new_size);
+            }
+            resampled[j] = static_cast<Scalar>(std::sqrt(power));
+        }
+        return resampled;
+    }
+}
@@ -0,0 +1,263 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/stream.h>
+#include <blt/std/random.h>
+#include <blt/std/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+namespace assign3
+{
+    std::unique_ptr<data_stream_t> data_stream_t::open(const std::string& path, const blt::size_t chunk_samples)
+    {
+        std::ifstream stream{path, std::ios::binary | std::ios::ate};
+        if (!stream)
+        {
+            BLT_WARN("Unable to open binary data file '%s'", path.c_str());
+            return nullptr;
+        }
+        const auto size = static_cast<blt::size_t>(stream.tellg());
+        std::array<char, binary_header_size> header{};
+        stream.seekg(0);
+        if (size < binary_header_size || !stream.read(header.data(), header.size()))
+        {
+            BLT_WARN("Binary data file '%s' is too small to hold a header", path.c_str());
+            return nullptr;
+        }
+        const auto layout = read_binary_layout(header.data(), size, path);
+        if (!layout)
+            return nullptr;
+        // a SOM needs samples to initialise from and a non zero weight to turn its error counts into rates
+        if (layout->samples == 0 || layout->bins == 0)
+        {
+            BLT_WARN("Binary data file '%s' has no data to train on", path.c_str());
+            return nullptr;
+        }
+
+        std::unique_ptr<data_stream_t> data_stream{new data_stream_t()};
+        data_stream->path = path;
+        data_stream->layout = *layout;
+        data_stream->chunk_samples = std::max(chunk_samples, static_cast<blt::size_t>(1));
+        data_stream->weight_total = static_cast<Scalar>(layout->samples);
+        if (layout->weighted)
+        {
+            // one float per sample is small next to the bins, the total is taken up front so passes don't need it
+            data_stream->weight_total = 0;
+            std::vector<float> weights(std::min(layout->samples, static_cast<blt::size_t>(65536)));
+            stream.seekg(static_cast<std::streamoff>(layout->weights_offset));
+            for (blt::size_t first = 0; first < layout->samples; first += weights.size())
+            {
+                const auto count = std::min(weights.size(), layout->samples - first);
+                if (!stream.read(reinterpret_cast<char*>(weights.data()), static_cast<std::streamsize>(count * sizeof(float))))
+                {
+                    BLT_WARN("Unable to read the weights of '%s'", path.c_str());
+                    return nullptr;
+                }
+                for (blt::size_t i = 0; i < count; i++)
+                    data_stream->weight_total += weights[i];
+            }
+            if (data_stream->weight_total <= 0)
+            {
+                BLT_WARN("Binary data file '%s' has no data to train on, every sample weighs nothing", path.c_str());
+                return nullptr;
+            }
+        }
+        return data_stream;
+    }
+
+    data_stream_t::~data_stream_t()
+    {
+        end_pass();
+    }
+
+    void data_stream_t::begin_pass(const bool shuffle, const blt::size_t seed)
+    {
+        end_pass();
+
+        chunks.clear();
+        blt::random::random_t rand{seed};
+        // shuffled passes move the boundaries, the samples in front of the first full chunk make a chunk of their own
+        const auto offset = shuffle && layout.samples > chunk_samples
+                                ? std::uniform_int_distribution<blt::size_t>{0, chunk_samples - 1}(rand)
+                                : 0;
+        if (offset > 0)
+            chunks.emplace_back(0, offset);
+        for (auto first = offset; first < layout.samples; first += chunk_samples)
+            chunks.emplace_back(first, std::min(chunk_samples, layout.samples - first));
+        if (shuffle)
+            std::shuffle(chunks.begin(), chunks.end(), rand);
+
+        this->shuffle = shuffle;
+        this->seed = seed;
+        handed_out = 0;
+        loaded = 0;
+        stopping = false;
+        failed = false;
+        reader = std::thread([this]() { read_pass(); });
+    }
+
+    const data_file_t* data_stream_t::next()
+    {
+        std::unique_lock lock(mutex);
+        if (!reader.joinable() || handed_out >= chunks.size())
+            return nullptr;
+        // handing out chunk i frees the buffer of chunk i - 1 for the reader
+        const auto i = handed_out++;
+        cv.notify_all();
+        cv.wait(lock, [this, i]() { return failed || loaded > i; });
+        if (loaded <= i)
+            return nullptr;
+        return &buffers[i % 2];
+    }
+
+    void data_stream_t::end_pass()
+    {
+        if (!reader.joinable())
+            return;
+        {
+            std::scoped_lock lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        reader.join();
+    }
+
+    void data_stream_t::read_pass()
+    {
+        std::ifstream stream{path, std::ios::binary};
+        std::vector<char> staging;
+        for (blt::size_t i = 0; i < chunks.size(); i++)
+        {
+            {
+                std::unique_lock lock(mutex);
+                // buffers[i % 2] holds chunk i - 2 until the consumer has been handed chunk i - 1
+                cv.wait(lock, [this, i]() { return stopping || handed_out >= i; });
+                if (stopping)
+                    return;
+            }
+
+            const auto [first, count] = chunks[i];
+            // every chunk gets its own shuffle, the pass seed alone would shuffle same sized chunks the same way
+            const auto chunk_seed = seed + i + 1;
+            const auto read = stream && read_chunk(stream, first, count, shuffle ? &chunk_seed : nullptr, staging, buffers[i % 2]);
+            {
+                std::scoped_lock lock(mutex);
+                if (read)
+                    loaded = i + 1;
+                else
+                    failed = true;
+            }
+            cv.notify_all();
+            if (!read)
+            {
+                BLT_WARN("Unable to read samples %ld to %ld of '%s', ending the pass early", first, first + count, path.c_str());
+                return;
+            }
+        }
+    }
+
+    bool data_stream_t::read_chunk(std::ifstream& stream, const blt::size_t first, const blt::size_t count, const blt::size_t* shuffle_seed,
+                                   std::vector<char>& staging, data_file_t& out) const
+    {
+        const auto first_word = first / 64;
+        std::vector<blt::u64> labels((first + count + 63) / 64 - first_word);
+        stream.seekg(static_cast<std::streamoff>(layout.labels_offset + first_word * sizeof(blt::u64)));
+        if (!stream.read(reinterpret_cast<char*>(labels.data()), static_cast<std::streamsize>(labels.size() * sizeof(blt::u64))))
+            return false;
+
+        std::vector<float> weights;
+        if (layout.weighted)
+        {
+            weights.resize(count);
+            stream.seekg(static_cast<std::streamoff>(layout.weights_offset + first * sizeof(float)));
+            if (!stream.read(reinterpret_cast<char*>(weights.data()), static_cast<std::streamsize>(count * sizeof(float))))
+                return false;
+        }
+
+        // the rows of a chunk are next to each other in the file, so the bins come in with one read
+        staging.resize(count * layout.row_stride);
+        stream.seekg(static_cast<std::streamoff>(layout.matrix_offset + first * layout.row_stride));
+        if (!stream.read(staging.data(), static_cast<std::streamsize>(staging.size())))
+            return false;
+
+        std::vector<blt::size_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        if (shuffle_seed != nullptr)
+        {
+            blt::random::random_t rand{*shuffle_seed};
+            std::shuffle(order.begin(), order.end(), rand);
+        }
+
+        out.data_points.clear();
+        out.weights.clear();
+        out.data_points.reserve(count, layout.bins);
+        for (const auto i : order)
+        {
+            const auto bit = first + i - first_word * 64;
+            auto row = out.data_points.emplace_back(layout.bins, ((labels[bit / 64] >> (bit % 64)) & 1) != 0);
+            const auto* source = staging.data() + i * layout.row_stride;
+            if (layout.precision == sizeof(Scalar))
+                std::memcpy(row.data(), source, layout.bins * sizeof(Scalar));
+            else
+            {
+                for (blt::size_t b = 0; b < layout.bins; b++)
+                {
+                    double value;
+                    std::memcpy(&value, source + b * sizeof(double), sizeof(double));
+                    row[b] = static_cast<Scalar>(value);
+                }
+            }
+            if (layout.weighted)
+                out.weights.push_back(weights[i]);
+        }
+        return true;
+    }
+
+    data_file_t data_stream_t::sample(const blt::size_t count, const blt::size_t seed) const
+    {
+        data_file_t sampled;
+        std::ifstream stream{path, std::ios::binary};
+        if (!stream || layout.samples == 0)
+            return sampled;
+
+        // drawn with replacement and read in file order, every draw is a single row so there's no point keeping the whole index around
+        blt::random::random_t rand{seed};
+        std::uniform_int_distribution<blt::size_t> dist{0, layout.samples - 1};
+        std::vector<blt::size_t> picked(std::min(count, layout.samples));
+        for (auto& index : picked)
+            index = dist(rand);
+        std::sort(picked.begin(), picked.end());
+
+        std::vector<char> staging;
+        data_file_t row;
+        for (const auto index : picked)
+        {
+            if (!read_chunk(stream, index, 1, nullptr, staging, row))
+            {
+                BLT_WARN("Unable to read sample %ld of '%s'", index, path.c_str());
+                break;
+            }
+            sampled.data_points.push_back(row.data_points.front());
+            if (layout.weighted)
+                sampled.weights.push_back(row.weights.front());
+        }
+        return sampled;
+    }
+}
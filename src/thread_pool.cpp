@@ -0,0 +1,186 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/thread_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace assign3
+{
+    void pending_task_t::try_run()
+    {
+        if (claimed.exchange(true))
+            return;
+        task();
+        {
+            std::scoped_lock lock(mutex);
+            done = true;
+        }
+        cv.notify_all();
+    }
+
+    void pending_task_t::wait()
+    {
+        try_run();
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this]() { return done.load(); });
+    }
+
+    thread_pool_t::thread_pool_t(const blt::size_t workers)
+    {
+        for (blt::size_t i = 0; i < workers; i++)
+            this->workers.emplace_back([this]() { worker_loop(); });
+    }
+
+    thread_pool_t::~thread_pool_t()
+    {
+        {
+            std::scoped_lock lock(queue_mutex);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        for (auto& worker : workers)
+        {
+            if (worker.joinable())
+                worker.join();
+        }
+    }
+
+    void thread_pool_t::worker_loop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(queue_mutex);
+                idle++;
+                queue_cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+                idle--;
+                if (queue.empty())
+                    return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::shared_ptr<pending_task_t> thread_pool_t::submit(std::function<void()> task)
+    {
+        auto pending = std::make_shared<pending_task_t>(std::move(task));
+        if (workers.empty())
+            return pending;
+        {
+            std::scoped_lock lock(queue_mutex);
+            queue.emplace_back([pending]() { pending->try_run(); });
+        }
+        queue_cv.notify_one();
+        return pending;
+    }
+
+    std::shared_ptr<pending_task_t> thread_pool_t::try_submit(std::function<void()> task)
+    {
+        std::shared_ptr<pending_task_t> pending;
+        {
+            std::scoped_lock lock(queue_mutex);
+            if (idle <= queue.size())
+                return nullptr;
+            pending = std::make_shared<pending_task_t>(std::move(task));
+            queue.emplace_back([pending]() { pending->try_run(); });
+        }
+        queue_cv.notify_one();
+        return pending;
+    }
+
+    void thread_pool_t::run(const blt::size_t count, const std::function<void(blt::size_t)>& task)
+    {
+        if (count == 0)
+            return;
+
+        // helpers can be picked up after run has returned (once every index was taken by someone else), so the state they touch is shared
+        // and they only call task after claiming an index, which can't happen once everything is finished
+        struct state_t
+        {
+            std::atomic<blt::size_t> next{0};
+            blt::size_t finished = 0;
+            std::mutex mutex;
+            std::condition_variable cv;
+            const std::function<void(blt::size_t)>* task = nullptr;
+            blt::size_t count = 0;
+
+            void work()
+            {
+                blt::size_t done = 0;
+                for (auto i = next++; i < count; i = next++)
+                {
+                    (*task)(i);
+                    done++;
+                }
+                if (done == 0)
+                    return;
+                std::scoped_lock lock(mutex);
+                finished += done;
+                if (finished == count)
+                    cv.notify_all();
+            }
+        };
+
+        const auto state = std::make_shared<state_t>();
+        state->task = &task;
+        state->count = count;
+
+        blt::size_t helpers = 0;
+        {
+            // jobs already queued will take some of the idle workers first
+            std::scoped_lock lock(queue_mutex);
+            const auto available = idle > queue.size() ? idle - queue.size() : 0;
+            helpers = std::min(available, count - 1);
+            for (blt::size_t i = 0; i < helpers; i++)
+                queue.emplace_back([state]() { state->work(); });
+        }
+        if (helpers > 0)
+            queue_cv.notify_all();
+
+        state->work();
+
+        std::unique_lock lock(state->mutex);
+        state->cv.wait(lock, [&state]() { return state->finished == state->count; });
+    }
+
+    void thread_pool_t::parallel_for(const blt::size_t count, const blt::size_t grain, const std::function<void(blt::size_t, blt::size_t)>& func)
+    {
+        const auto chunk = std::max(grain, static_cast<blt::size_t>(1));
+        const auto chunks = (count + chunk - 1) / chunk;
+        if (chunks <= 1)
+        {
+            if (count > 0)
+                func(0, count);
+            return;
+        }
+        run(chunks, [&func, chunk, count](const blt::size_t i) {
+            func(i * chunk, std::min((i + 1) * chunk, count));
+        });
+    }
+
+    thread_pool_t& thread_pool_t::shared()
+    {
+        // the calling thread always helps, so one less worker than there are cores
+        static thread_pool_t pool{std::max(std::thread::hardware_concurrency(), 1u) - 1};
+        return pool;
+    }
+}
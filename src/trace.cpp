@@ -0,0 +1,428 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/trace.h>
+#include <blt/iterator/enumerate.h>
+#include <blt/std/logging.h>
+#include <algorithm>
+#include <string_view>
+
+namespace assign3
+{
+    struct bit_writer_t
+    {
+        std::vector<blt::u64>& words;
+        blt::size_t position = 0;
+
+        void write(const blt::u64 value, const blt::size_t bits)
+        {
+            for (blt::size_t i = 0; i < bits; i++, position++)
+            {
+                if (position % 64 == 0)
+                    words.push_back(0);
+                words.back() |= ((value >> i) & 1) << (position % 64);
+            }
+        }
+    };
+
+    struct bit_reader_t
+    {
+        const std::vector<blt::u64>& words;
+        blt::size_t position = 0;
+
+        blt::u64 read(const blt::size_t bits)
+        {
+            blt::u64 value = 0;
+            for (blt::size_t i = 0; i < bits; i++, position++)
+                value |= ((words[position / 64] >> (position % 64)) & 1) << i;
+            return value;
+        }
+    };
+
+    template <typename T>
+    static void write_value(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static T read_value(std::istream& in)
+    {
+        T value{};
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    static void write_vector(std::ostream& out, const std::vector<T>& values)
+    {
+        write_value<blt::u64>(out, values.size());
+        out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+    }
+
+    // bytes left in the stream, 0 if it can't tell
+    static blt::u64 remaining(std::istream& in)
+    {
+        if (!in)
+            return 0;
+        const auto position = in.tellg();
+        in.seekg(0, std::ios::end);
+        const auto end = in.tellg();
+        in.seekg(position);
+        if (position < 0 || end < position)
+            return 0;
+        return static_cast<blt::u64>(end - position);
+    }
+
+    // a count read from the file is only trusted if that many items of at least item_size bytes can still follow it
+    static bool read_count(std::istream& in, blt::u64& count, const blt::size_t item_size)
+    {
+        count = read_value<blt::u64>(in);
+        if (in && count <= remaining(in) / item_size)
+            return true;
+        in.setstate(std::ios::failbit);
+        count = 0;
+        return false;
+    }
+
+    template <typename T>
+    static std::vector<T> read_vector(std::istream& in)
+    {
+        blt::u64 size;
+        if (!read_count(in, size, sizeof(T)))
+            return {};
+        std::vector<T> values(size);
+        in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+        return values;
+    }
+
+    static blt::size_t bits_to_words(const blt::size_t bits)
+    {
+        return (bits + 63) / 64;
+    }
+
+    bmu_trace_t::bmu_trace_t(const blt::size_t checkpoint_interval, const blt::size_t keyframe_interval):
+        checkpoint_interval(std::max(checkpoint_interval, static_cast<blt::size_t>(1))),
+        keyframe_interval(std::max(keyframe_interval, static_cast<blt::size_t>(1)))
+    {}
+
+    void bmu_trace_t::begin(const data_file_t& file, const array_t& array, const evaluator_t& evaluator)
+    {
+        width = array.get_width();
+        height = array.get_height();
+        neurons = array.get_map().size();
+        index_bits = 1;
+        while ((static_cast<blt::size_t>(1) << index_bits) < neurons)
+            index_bits++;
+
+        adjacency.assign((neurons * neurons + 63) / 64, 0);
+        for (blt::size_t a = 0; a < neurons; a++)
+        {
+            for (blt::size_t b = 0; b < neurons; b++)
+            {
+                if (a != b && evaluator.are_neighbours(a, b))
+                    adjacency[(a * neurons + b) / 64] |= static_cast<blt::u64>(1) << ((a * neurons + b) % 64);
+            }
+        }
+
+        labels.clear();
+        weights.clear();
+        for (const auto& [i, point] : blt::enumerate(file.data_points))
+        {
+            labels.push_back(point.is_bad);
+            weights.push_back(file.weight(i));
+        }
+
+        frames.clear();
+        checkpoints.clear();
+        last_first.clear();
+        last_second.clear();
+    }
+
+    void bmu_trace_t::record(const blt::size_t epoch, const std::vector<blt::size_t>& first, const std::vector<blt::size_t>& second,
+                             const std::vector<Scalar>& codebook, const std::vector<Scalar>& activations)
+    {
+        frame_t frame;
+        frame.epoch = epoch;
+        frame.keyframe = frames.size() % keyframe_interval == 0;
+        bit_writer_t writer{frame.bits};
+
+        if (frame.keyframe)
+        {
+            for (blt::size_t i = 0; i < labels.size(); i++)
+            {
+                writer.write(first[i], index_bits);
+                writer.write(second[i], index_bits);
+            }
+        }
+        else
+        {
+            // change mask first so the reader knows which samples follow
+            for (blt::size_t i = 0; i < labels.size(); i++)
+                writer.write(first[i] != last_first[i] || second[i] != last_second[i], 1);
+            for (blt::size_t i = 0; i < labels.size(); i++)
+            {
+                if (first[i] == last_first[i] && second[i] == last_second[i])
+                    continue;
+                writer.write(first[i], index_bits);
+                writer.write(second[i], index_bits);
+            }
+        }
+        frame.bits.shrink_to_fit();
+        frames.push_back(std::move(frame));
+        last_first = first;
+        last_second = second;
+
+        if (checkpoints.empty() || epoch >= checkpoints.back().epoch + checkpoint_interval)
+            checkpoints.push_back({epoch, codebook, activations});
+    }
+
+    void bmu_trace_t::decode(const blt::size_t frame, std::vector<blt::size_t>& first, std::vector<blt::size_t>& second) const
+    {
+        const auto samples = labels.size();
+        first.resize(samples);
+        second.resize(samples);
+
+        auto start = frame;
+        while (!frames[start].keyframe)
+            start--;
+
+        for (auto f = start; f <= frame; f++)
+        {
+            bit_reader_t reader{frames[f].bits};
+            if (frames[f].keyframe)
+            {
+                for (blt::size_t i = 0; i < samples; i++)
+                {
+                    first[i] = reader.read(index_bits);
+                    second[i] = reader.read(index_bits);
+                }
+                continue;
+            }
+
+            bit_reader_t values{frames[f].bits, samples};
+            for (blt::size_t i = 0; i < samples; i++)
+            {
+                if (!reader.read(1))
+                    continue;
+                first[i] = values.read(index_bits);
+                second[i] = values.read(index_bits);
+            }
+        }
+    }
+
+    Scalar bmu_trace_t::topological_error(const blt::size_t frame) const
+    {
+        std::vector<blt::size_t> first, second;
+        decode(frame, first, second);
+        Scalar total = 0, errors = 0;
+        for (blt::size_t i = 0; i < labels.size(); i++)
+        {
+            total += weights[i];
+            if (!are_neighbours(first[i], second[i]))
+                errors += weights[i];
+        }
+        return errors / total;
+    }
+
+    std::vector<Scalar> bmu_trace_t::hit_map(const blt::size_t frame) const
+    {
+        std::vector<blt::size_t> first, second;
+        decode(frame, first, second);
+        std::vector<Scalar> hits(neurons);
+        for (blt::size_t i = 0; i < labels.size(); i++)
+            hits[first[i]] += weights[i];
+        return hits;
+    }
+
+    Scalar bmu_trace_t::class_purity(const blt::size_t frame) const
+    {
+        std::vector<blt::size_t> first, second;
+        decode(frame, first, second);
+        std::vector<Scalar> good(neurons), bad(neurons);
+        Scalar total = 0;
+        for (blt::size_t i = 0; i < labels.size(); i++)
+        {
+            (labels[i] ? bad : good)[first[i]] += weights[i];
+            total += weights[i];
+        }
+        Scalar majority = 0;
+        for (blt::size_t n = 0; n < neurons; n++)
+            majority += std::max(good[n], bad[n]);
+        return majority / total;
+    }
+
+    const bmu_trace_t::checkpoint_t* bmu_trace_t::checkpoint_at(const blt::size_t epoch) const
+    {
+        const checkpoint_t* found = nullptr;
+        for (const auto& checkpoint : checkpoints)
+        {
+            if (checkpoint.epoch > epoch)
+                break;
+            found = &checkpoint;
+        }
+        return found;
+    }
+
+    blt::size_t bmu_trace_t::memory_usage() const
+    {
+        blt::size_t bytes = 0;
+        for (const auto& frame : frames)
+            bytes += frame.bits.size() * sizeof(blt::u64);
+        for (const auto& checkpoint : checkpoints)
+            bytes += (checkpoint.codebook.size() + checkpoint.activations.size()) * sizeof(Scalar);
+        return bytes;
+    }
+
+    void bmu_trace_t::write(std::ostream& out) const
+    {
+        out.write("BMUT", 4);
+        write_value<blt::u64>(out, checkpoint_interval);
+        write_value<blt::u64>(out, keyframe_interval);
+        write_value<blt::u64>(out, width);
+        write_value<blt::u64>(out, height);
+        write_value<blt::u64>(out, neurons);
+        write_value<blt::u64>(out, index_bits);
+        write_vector(out, adjacency);
+        std::vector<blt::u8> packed_labels(labels.begin(), labels.end());
+        write_vector(out, packed_labels);
+        write_vector(out, weights);
+
+        write_value<blt::u64>(out, frames.size());
+        for (const auto& frame : frames)
+        {
+            write_value<blt::u64>(out, frame.epoch);
+            write_value<blt::u8>(out, frame.keyframe);
+            write_vector(out, frame.bits);
+        }
+
+        write_value<blt::u64>(out, checkpoints.size());
+        for (const auto& checkpoint : checkpoints)
+        {
+            write_value<blt::u64>(out, checkpoint.epoch);
+            write_vector(out, checkpoint.codebook);
+            write_vector(out, checkpoint.activations);
+        }
+    }
+
+    bool bmu_trace_t::is_consistent() const
+    {
+        const auto samples = labels.size();
+        if (index_bits == 0 || index_bits > 32 || neurons == 0 || neurons > (static_cast<blt::size_t>(1) << index_bits) ||
+            weights.size() != samples)
+            return false;
+        // neurons^2 <= adjacency bits, without overflowing on a nonsense neuron count
+        if (neurons > adjacency.size() * 64 / neurons || adjacency.size() != bits_to_words(neurons * neurons))
+            return false;
+        // decoding walks back to the last keyframe
+        if (!frames.empty() && !frames.front().keyframe)
+            return false;
+        // index_bits usually covers more than neurons, every index has to name a neuron or the hit map and adjacency lookups run off
+        const auto valid_indices = [this](bit_reader_t& reader, const blt::size_t count) {
+            for (blt::size_t i = 0; i < count; i++)
+            {
+                if (reader.read(index_bits) >= neurons)
+                    return false;
+            }
+            return true;
+        };
+        for (const auto& frame : frames)
+        {
+            if (frame.keyframe)
+            {
+                if (frame.bits.size() < bits_to_words(samples * 2 * index_bits))
+                    return false;
+                bit_reader_t reader{frame.bits};
+                if (!valid_indices(reader, samples * 2))
+                    return false;
+                continue;
+            }
+            // change mask, then a pair of indices per changed sample
+            if (frame.bits.size() < bits_to_words(samples))
+                return false;
+            blt::size_t changed = 0;
+            for (blt::size_t i = 0; i < samples; i++)
+                changed += (frame.bits[i / 64] >> (i % 64)) & 1;
+            if (frame.bits.size() < bits_to_words(samples + changed * 2 * index_bits))
+                return false;
+            bit_reader_t reader{frame.bits, samples};
+            if (!valid_indices(reader, changed * 2))
+                return false;
+        }
+        return true;
+    }
+
+    std::optional<bmu_trace_t> bmu_trace_t::read(std::istream& in)
+    {
+        char magic[4];
+        in.read(magic, 4);
+        if (!in || std::string_view{magic, 4} != "BMUT")
+        {
+            BLT_WARN("Not a BMU trace file");
+            return {};
+        }
+
+        const auto checkpoint_interval = read_value<blt::u64>(in);
+        const auto keyframe_interval = read_value<blt::u64>(in);
+        bmu_trace_t trace{checkpoint_interval, keyframe_interval};
+        trace.width = read_value<blt::u64>(in);
+        trace.height = read_value<blt::u64>(in);
+        trace.neurons = read_value<blt::u64>(in);
+        trace.index_bits = read_value<blt::u64>(in);
+        trace.adjacency = read_vector<blt::u64>(in);
+        const auto packed_labels = read_vector<blt::u8>(in);
+        trace.labels.assign(packed_labels.begin(), packed_labels.end());
+        trace.weights = read_vector<Scalar>(in);
+
+        // epoch, keyframe flag and bit count
+        constexpr blt::size_t frame_size = sizeof(blt::u64) + sizeof(blt::u8) + sizeof(blt::u64);
+        blt::u64 frame_count;
+        read_count(in, frame_count, frame_size);
+        for (blt::u64 i = 0; i < frame_count && in; i++)
+        {
+            frame_t frame;
+            frame.epoch = read_value<blt::u64>(in);
+            frame.keyframe = read_value<blt::u8>(in) != 0;
+            frame.bits = read_vector<blt::u64>(in);
+            trace.frames.push_back(std::move(frame));
+        }
+
+        // epoch and the sizes of both vectors
+        constexpr blt::size_t checkpoint_size = 3 * sizeof(blt::u64);
+        blt::u64 checkpoint_count;
+        read_count(in, checkpoint_count, checkpoint_size);
+        for (blt::u64 i = 0; i < checkpoint_count && in; i++)
+        {
+            checkpoint_t checkpoint;
+            checkpoint.epoch = read_value<blt::u64>(in);
+            checkpoint.codebook = read_vector<Scalar>(in);
+            checkpoint.activations = read_vector<Scalar>(in);
+            trace.checkpoints.push_back(std::move(checkpoint));
+        }
+        if (!in)
+        {
+            BLT_WARN("BMU trace file is truncated or corrupt");
+            return {};
+        }
+        if (!trace.is_consistent())
+        {
+            BLT_WARN("BMU trace file is corrupt");
+            return {};
+        }
+        return trace;
+    }
+}
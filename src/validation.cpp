@@ -0,0 +1,66 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <assign3/validation.h>
+#include <assign3/som.h>
+#include <assign3/functions.h>
+#include <assign3/thread_pool.h>
+#include <blt/std/logging.h>
+#include <chrono>
+
+namespace assign3
+{
+    std::vector<fold_result_t> cross_validate(const data_file_t& file, const blt::size_t folds, const blt::size_t seed, const blt::size_t width,
+                                              const blt::size_t height, const blt::size_t epochs, const shape_t shape, const init_t init,
+                                              const Scalar initial_learn_rate)
+    {
+        if (folds < 2 || file.data_points.size() < folds)
+        {
+            BLT_WARN("Cross validation needs at least two folds and a sample per fold, got %ld folds for %ld samples", folds,
+                     file.data_points.size());
+            return {};
+        }
+
+        const auto partitioned = dataset_partitioner{file}.partition(folds, seed);
+        const auto& groups = partitioned.getGroups();
+
+        // every fold only reads the shared groups, everything it writes is its own
+        std::vector<fold_result_t> results(folds);
+        thread_pool_t::shared().run(folds, [&](const blt::size_t fold) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto training = partitioned.without(fold);
+            const auto& held_out = groups[fold];
+
+            gaussian_function_t topology_func{};
+            auto dist = distance_function_t::from_shape(shape, width, height);
+            som_t som{training, width, height, epochs, dist.get(), &topology_func, shape, init, false};
+            som.set_evaluation_schedule(evaluation_schedule_t::final_only());
+            while (!som.is_finished())
+                som.train_epoch(initial_learn_rate);
+            som.finish_evaluations();
+
+            auto& result = results[fold];
+            result.training_samples = training.data_points.size();
+            result.held_out_samples = held_out.data_points.size();
+            result.quantization_error = som.quantization_error(held_out);
+            result.quantization_rate = result.quantization_error / held_out.total_weight();
+            result.topological_error = som.topological_error(held_out);
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        });
+        return results;
+    }
+}